@@ -59,8 +59,22 @@ DECLARE_double(cartesian_deviation_weight);
 
 DECLARE_bool(enable_simple_boundary_decision);
 
+DECLARE_int32(distance_layer_bits);
+
+DECLARE_double(quantized_max_distance);
+
+DECLARE_string(distance_layer_layout);
+
+DECLARE_int32(distance_pyramid_levels);
+
 DECLARE_string(optimization_method);
 
+DECLARE_string(solver_portfolio);
+
+DECLARE_double(portfolio_wait_ms);
+
+DECLARE_string(qp_horizon_buckets);
+
 DECLARE_double(K_curvature_weight);
 
 DECLARE_double(K_curvature_rate_weight);
@@ -87,6 +101,8 @@ DECLARE_double(output_spacing);
 
 DECLARE_bool(enable_computation_time_output);
 
+DECLARE_bool(enable_debug_output);
+
 DECLARE_bool(enable_collision_check);
 
 DECLARE_double(search_obstacle_cost);
@@ -96,4 +112,20 @@ DECLARE_double(search_deviation_cost);
 DECLARE_double(epsilon);
 
 DECLARE_bool(enable_dynamic_segmentation);
+
+DECLARE_bool(enable_tracing);
+
+DECLARE_string(trace_file);
+
+DECLARE_int32(trace_max_events);
+
+DECLARE_string(metrics_file);
+
+DECLARE_double(metrics_dump_interval);
+
+DECLARE_int32(planning_arena_kb);
+
+DECLARE_double(time_budget_ms);
+
+DECLARE_double(pipeline_max_start_error);
 #endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_CONFIG_PLANNING_FLAGS_HPP_
@@ -4,6 +4,7 @@
 
 #ifndef PATH_OPTIMIZER_INCLUDE_DATA_STRUCT_DATA_STRUCT_HPP_
 #define PATH_OPTIMIZER_INCLUDE_DATA_STRUCT_DATA_STRUCT_HPP_
+#include <array>
 #include <vector>
 #include <memory>
 
@@ -28,11 +29,22 @@ struct State {
   double a{};
 };
 
+// Unit tangent (cos z, sin z) of a reference state. Offsets along the left normal (-sin z, cos z)
+// then need no trigonometry.
+struct Tangent {
+    Tangent() = default;
+    Tangent(double x, double y) : x(x), y(y) {}
+    double x{1};
+    double y{};
+};
+
 struct CoveringCircleBounds {
   struct SingleCircleBounds {
-    SingleCircleBounds &operator=(std::vector<double> &bounds) {
+    // bounds = {left, right}, as returned by the clearance search.
+    SingleCircleBounds &operator=(const std::array<double, 2> &bounds) {
         ub = bounds[0];
         lb = bounds[1];
+        return *this;
     }
     double ub{}; // left
     double lb{}; // right
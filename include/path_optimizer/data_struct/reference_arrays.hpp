@@ -0,0 +1,91 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_DATA_STRUCT_REFERENCE_ARRAYS_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_DATA_STRUCT_REFERENCE_ARRAYS_HPP_
+#include <cstddef>
+#include <vector>
+#include "path_optimizer/data_struct/data_struct.hpp"
+
+namespace PathOptimizationNS {
+
+// Reference states as a structure of arrays. Most loops read two or three fields (bounds: x, y and the
+// tangent; solvers: s and k; updateLimits: v and a), which then stream through contiguous doubles
+// instead of striding over 56-byte States. states() copies them out as States, for everything else.
+class ReferenceStateArrays {
+ public:
+    void clear();
+    void reserve(std::size_t n);
+    void push_back(const State &state, const Tangent &tangent);
+    // Keep the first n states.
+    void truncate(std::size_t n);
+    std::size_t size() const {
+        return x_.size();
+    }
+    bool empty() const {
+        return x_.empty();
+    }
+    const std::vector<double> &x() const {
+        return x_;
+    }
+    const std::vector<double> &y() const {
+        return y_;
+    }
+    const std::vector<double> &heading() const {
+        return heading_;
+    }
+    const std::vector<double> &k() const {
+        return k_;
+    }
+    const std::vector<double> &s() const {
+        return s_;
+    }
+    const std::vector<double> &v() const {
+        return v_;
+    }
+    const std::vector<double> &a() const {
+        return a_;
+    }
+    const std::vector<Tangent> &tangents() const {
+        return tangents_;
+    }
+    std::vector<State> states() const;
+
+ private:
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> heading_;
+    std::vector<double> k_;
+    std::vector<double> s_;
+    std::vector<double> v_;
+    std::vector<double> a_;
+    std::vector<Tangent> tangents_;
+};
+
+// Bounds of the four covering circles, one array per circle and side: lb(c)[i] and ub(c)[i] are the
+// right and left bound of circle c at reference state i. bounds() copies them out per state.
+class CircleBoundArrays {
+ public:
+    static const int kCircles = 4;
+    void clear();
+    void reserve(std::size_t n);
+    void push_back(const CoveringCircleBounds &bounds);
+    std::size_t size() const {
+        return lb_[0].size();
+    }
+    bool empty() const {
+        return lb_[0].empty();
+    }
+    const std::vector<double> &lb(int circle) const {
+        return lb_[circle];
+    }
+    const std::vector<double> &ub(int circle) const {
+        return ub_[circle];
+    }
+    std::vector<CoveringCircleBounds> bounds() const;
+
+ private:
+    std::vector<double> lb_[kCircles];
+    std::vector<double> ub_[kCircles];
+};
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_DATA_STRUCT_REFERENCE_ARRAYS_HPP_
@@ -12,11 +12,14 @@ namespace PathOptimizationNS {
 class Map;
 class Config;
 class State;
+class Tangent;
 class CoveringCircleBounds;
 namespace tk {
 class spline;
 }
 class ReferencePathImpl;
+class ReferenceStateArrays;
+class CircleBoundArrays;
 
 class ReferencePath {
  public:
@@ -28,21 +31,29 @@ class ReferencePath {
     void setSpline(const tk::spline &x_s, const tk::spline &y_s, double max_s);
     void setOriginalSpline(const tk::spline &x_s, const tk::spline &y_s, double max_s);
     void clear();
+    // Exchange the contents, without copying.
+    void swap(ReferencePath &other);
     std::size_t getSize() const;
     double getLength() const;
     void setLength(double s);
-    const std::vector<State> &getReferenceStates() const;
-    const std::vector<CoveringCircleBounds> &getBounds() const;
+    // Copies of the states and bounds, see getReferenceArrays() and getBoundArrays().
+    std::vector<State> getReferenceStates() const;
+    // Unit tangents of the reference states, same size.
+    const std::vector<Tangent> &getTangents() const;
+    std::vector<CoveringCircleBounds> getBounds() const;
+    // The same states and bounds as arrays per field, for loops that read only a few fields.
+    const ReferenceStateArrays &getReferenceArrays() const;
+    const CircleBoundArrays &getBoundArrays() const;
     const std::vector<double> &getMaxKList() const;
     const std::vector<double> &getMaxKpList() const;
     std::vector<std::tuple<State, double, double>> display_abnormal_bounds() const;
     // Set reference_states_ directly, only used in solveWithoutSmoothing.
     void setReference(const std::vector<State> &reference);
     void setReference(const std::vector<State> &&reference);
-    // Calculate upper and lower bounds for each covering circle.
-    void updateBounds(const Map &map);
+    // Calculate upper and lower bounds for each covering circle. Returns false if the path is blocked.
+    bool updateBounds(const Map &map);
     // If the reference_states_ have speed and acceleration information, call this func to calculate
-    // curvature and curvature rate bounds.
+    // curvature and curvature rate bounds. Only the KPC solver uses them.
     void updateLimits();
     // Calculate reference_states_ from x_s_ and y_s_, given delta s.
     bool buildReferenceFromSpline(double delta_s_smaller, double delta_s_larger);
@@ -4,13 +4,16 @@
 
 #ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_DATA_STRUCT_REFERENCE_PATH_IMPL_HPP_
 #define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_DATA_STRUCT_REFERENCE_PATH_IMPL_HPP_
+#include <array>
 #include <vector>
 #include <tuple>
+#include "path_optimizer/data_struct/reference_arrays.hpp"
 
 namespace PathOptimizationNS {
 class Map;
 class Config;
 class State;
+class Tangent;
 class CoveringCircleBounds;
 namespace tk {
 class spline;
@@ -36,25 +39,39 @@ class ReferencePathImpl {
     std::size_t getSize() const;
     double getLength() const;
     void setLength(double s);
-    const std::vector<State> &getReferenceStates() const;
-    const std::vector<CoveringCircleBounds> &getBounds() const;
+    // Copies of the states and bounds, see getReferenceArrays() and getBoundArrays().
+    std::vector<State> getReferenceStates() const;
+    // Unit tangents of the reference states, same size.
+    const std::vector<Tangent> &getTangents() const;
+    std::vector<CoveringCircleBounds> getBounds() const;
+    // The same states and bounds as arrays per field.
+    const ReferenceStateArrays &getReferenceArrays() const;
+    const CircleBoundArrays &getBoundArrays() const;
     const std::vector<double> &getMaxKList() const;
     const std::vector<double> &getMaxKpList() const;
     std::vector<std::tuple<State, double, double>> display_abnormal_bounds() const;
     // Set reference_states_ directly, only used in solveWithoutSmoothing.
     void setReference(const std::vector<State> &reference);
     void setReference(const std::vector<State> &&reference);
-    // Calculate upper and lower bounds for each covering circle.
-    void updateBounds(const Map &map);
+    // Calculate upper and lower bounds for each covering circle. Returns false if the path is blocked.
+    bool updateBounds(const Map &map);
     // If the reference_states_ have speed and acceleration information, call this func to calculate
-    // curvature and curvature rate bounds.
+    // curvature and curvature rate bounds. Only the KPC solver uses them.
     void updateLimits();
     // Calculate reference_states_ from x_s_ and y_s_, given delta s.
     bool buildReferenceFromSpline(double delta_s_smaller, double delta_s_larger);
+    // Left and right free space of a circle at state, searched along the normal direction.
+    std::array<double, 2> getClearanceWithDirectionStrict(const PathOptimizationNS::State &state,
+                                                          const PathOptimizationNS::Map &map);
+    // Same, with the unit tangent of state.z already known.
+    std::array<double, 2> getClearanceWithDirectionStrict(const PathOptimizationNS::State &state,
+                                                          const PathOptimizationNS::Tangent &tangent,
+                                                          const PathOptimizationNS::Map &map);
 
  private:
-    std::vector<double> getClearanceWithDirectionStrict(const PathOptimizationNS::State &state,
-                                                        const PathOptimizationNS::Map &map);
+    // Store states given directly, with the tangents of their headings.
+    void assignStates(const std::vector<State> &reference);
+
     bool use_spline_{true};
     // Reference path spline representation.
     tk::spline *x_s_;
@@ -65,8 +82,8 @@ class ReferencePathImpl {
     double original_max_s_{};
     bool is_original_spline_set{false};
     // Divided smoothed path info.
-    std::vector<State> reference_states_;
-    std::vector<CoveringCircleBounds> bounds_;
+    ReferenceStateArrays reference_states_;
+    CircleBoundArrays bounds_;
     std::vector<double> max_k_list_;
     std::vector<double> max_kp_list_;
     // To test updateBounds function;
@@ -0,0 +1,98 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_DATA_STRUCT_SOLVE_RESULT_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_DATA_STRUCT_SOLVE_RESULT_HPP_
+#include <vector>
+#include <memory>
+#include <string>
+#include <tuple>
+#include "path_optimizer/data_struct/data_struct.hpp"
+
+namespace PathOptimizationNS {
+
+enum class SolveStatus {
+  SUCCESS,
+  EMPTY_INPUT,
+  SEARCH_FAILED, // The lattice search found no path, and smoothing the raw input failed.
+  SMOOTHING_FAILED,
+  LARGE_HEADING_ERROR,
+  EMPTY_REFERENCE,
+  PATH_BLOCKED, // A station of the reference has no free space for a covering circle.
+  QP_FAILED,
+  COLLISION,
+  DEADLINE_EXCEEDED
+};
+
+const char *toString(SolveStatus status);
+
+// Settings of a solve under FLAGS_time_budget_ms, chosen from how well the previous solves of the
+// optimizer fit into the budget. Solves without budget are FULL.
+enum class SolveQuality {
+  FULL, // Configured settings.
+  COARSE, // Lattice search spacing x2, fewer smoother and QP iterations.
+  COARSEST // Lattice search spacing x4, fewest iterations.
+};
+
+const char *toString(SolveQuality quality);
+
+// Where the path of a DEADLINE_EXCEEDED result came from.
+enum class FallbackPath {
+  NONE, // No path.
+  SMOOTHED_REFERENCE, // The smoothed reference path of this solve, cut at the first collision.
+  PREVIOUS_PATH // The last successful result of this optimizer.
+};
+
+// What OSQP reported for the last solve. Only valid if the solver got as far as osqp_solve.
+struct QpInfo {
+  bool valid{false};
+  int status{0}; // OSQP status_val, 1 means solved.
+  int iterations{0};
+  double objective{0};
+  double primal_residual{0};
+  double dual_residual{0};
+  double build_ms{0}; // Matrix setup.
+  double solve_ms{0}; // osqp_setup + osqp_solve.
+  bool workspace_reused{false}; // Same layout as the last solve: values updated, no osqp_setup.
+  int padded_stages{0}; // Added by FLAGS_qp_horizon_buckets.
+};
+
+// Wall-clock time of each stage, in ms. Stages that were not reached stay 0.
+struct StageTimings {
+  double smoothing_ms{0}; // Including the lattice search.
+  double segmentation_ms{0}; // Reference resampling and bounds. Reference setup in solveWithoutSmoothing.
+  double optimization_ms{0}; // QP build and solve, see QpInfo for the split.
+  double output_check_ms{0}; // Interpolation and collision check.
+  double total_ms{0};
+};
+
+// Visualization data, only collected with FLAGS_enable_debug_output.
+struct SolveDebugInfo {
+  std::vector<State> smoothed_path;
+  std::vector<std::vector<double>> search_result;
+  std::vector<std::tuple<State, double, double>> abnormal_bounds;
+};
+
+struct SolveResult {
+  SolveStatus status{SolveStatus::SUCCESS};
+  // The output path was cut at a collision. Still a success if the rest is long enough.
+  bool truncated{false};
+  FallbackPath fallback{FallbackPath::NONE};
+  SolveQuality quality{SolveQuality::FULL};
+  // Optimization method of the path: FLAGS_optimization_method, or the winner of FLAGS_solver_portfolio.
+  std::string optimization_method;
+  // The smoothed reference was prepared during the previous solvePipelined(); smoothing_ms is then
+  // the time spent waiting for it.
+  bool smoothing_prepared{false};
+  StageTimings timings;
+  QpInfo qp;
+  std::shared_ptr<SolveDebugInfo> debug;
+
+  bool success() const {
+      return status == SolveStatus::SUCCESS;
+  }
+  // Implicit, so results still convert to the bool that solve() used to return.
+  operator bool() const {
+      return success();
+  }
+};
+
+}
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_DATA_STRUCT_SOLVE_RESULT_HPP_
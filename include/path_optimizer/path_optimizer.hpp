@@ -9,9 +9,17 @@
 #include <vector>
 #include <memory>
 #include <tuple>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
 #include <glog/logging.h>
 #include "grid_map_core/grid_map_core.hpp"
 #include "path_optimizer/config/planning_flags.hpp"
+#include "path_optimizer/data_struct/solve_result.hpp"
+#include "path_optimizer/tools/deadline.hpp"
 
 namespace PathOptimizationNS {
 
@@ -20,6 +28,45 @@ class State;
 class Map;
 class CollisionChecker;
 class VehicleState;
+class Arena;
+class ReferencePathSmoother;
+class OsqpSolver;
+
+struct AsyncSolveResult {
+    SolveResult result;
+    std::vector<State> path;
+};
+
+// Result of PathOptimizer::solveAsync.
+class SolveHandle {
+public:
+    SolveHandle() = default;
+    SolveHandle(std::future<AsyncSolveResult> future, Deadline deadline) :
+        future_(std::move(future)), deadline_(std::move(deadline)) {}
+
+    bool valid() const {
+        return future_.valid();
+    }
+    bool ready() const {
+        return future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+    // Returns whether the result is ready.
+    bool waitFor(double ms) const {
+        return future_.wait_for(std::chrono::duration<double, std::milli>(ms)) == std::future_status::ready;
+    }
+    // Stop at the next checkpoint; the result is then DEADLINE_EXCEEDED with a fallback path.
+    void cancel() {
+        deadline_.cancel();
+    }
+    // Blocks until the result is ready. Only once per handle.
+    AsyncSolveResult get() {
+        return future_.get();
+    }
+
+private:
+    std::future<AsyncSolveResult> future_;
+    Deadline deadline_;
+};
 
 class PathOptimizer {
 public:
@@ -27,35 +74,148 @@ public:
     PathOptimizer(const State &start_state,
                   const State &end_state,
                   const grid_map::GridMap &map);
+    // For maps that are not grid maps, e.g. a TiledDistanceField.
+    PathOptimizer(const State &start_state,
+                  const State &end_state,
+                  const Map &map);
     ~PathOptimizer();
     PathOptimizer(const PathOptimizer &optimizer) = delete;
     PathOptimizer &operator=(const PathOptimizer &optimizer) = delete;
 
-    // Call this to get the optimized path.
-    bool solve(const std::vector<State> &reference_points, std::vector<State> *final_path);
-    bool solveWithoutSmoothing(const std::vector<State> &reference_points, std::vector<State> *final_path);
+    // A planner keeps one optimizer and updates it every cycle instead of constructing a new one:
+    // the reference path buffers, the smoother, the OSQP solver and the scratch arena are reused.
+    void setStartState(const State &start_state);
+    void setGoal(const State &end_state);
+    void setMap(const grid_map::GridMap &map);
+    void setMap(const Map &map);
 
-    // Only for visualization purpose.
-    const std::vector<State> &getSmoothedPath() const;
-    const std::vector<std::vector<double>> &getSearchResult() const;
-    std::vector<std::tuple<State, double, double>> display_abnormal_bounds() const;
+    // Call this to get the optimized path. The result converts to true on success; set
+    // FLAGS_enable_debug_output to get the smoothed path, search result and abnormal bounds in it.
+    // When the deadline expires, the solve stops at its next checkpoint and returns DEADLINE_EXCEEDED
+    // with the best path available, see FallbackPath.
+    // With FLAGS_time_budget_ms, the solve also ends by the budget, see SolveQuality.
+    SolveResult solve(const std::vector<State> &reference_points, std::vector<State> *final_path,
+                      const Deadline &deadline = Deadline::none());
+    // Pipelined mode for a planning loop: solve(), and as soon as this cycle's reference is smoothed,
+    // smooth the reference of the next cycle on a second thread, from the start state predicted for
+    // it, while this cycle's bounds, QP and output check run. The next solve uses that reference
+    // (SolveResult::smoothing_prepared) only if it is still valid: the same reference points, no
+    // setMap() in between, and a start state within FLAGS_pipeline_max_start_error and 10° of the
+    // prediction. Otherwise it is dropped and the reference is smoothed again.
+    SolveResult solvePipelined(const std::vector<State> &reference_points,
+                               const State &next_start_state,
+                               std::vector<State> *final_path,
+                               const Deadline &deadline = Deadline::none());
+    // solve() on the worker thread of this optimizer. Solves run one after another in call order.
+    // The optimizer must not be used otherwise (solve, setters) before the handles are ready.
+    SolveHandle solveAsync(const std::vector<State> &reference_points, const Deadline &deadline = Deadline());
+    SolveResult solveWithoutSmoothing(const std::vector<State> &reference_points, std::vector<State> *final_path);
 
 private:
+    // solve(), and with next_start_state, solvePipelined().
+    SolveResult solveCycle(const std::vector<State> &reference_points,
+                           const State *next_start_state,
+                           std::vector<State> *final_path,
+                           const Deadline &deadline);
+
+    // Smooth the reference of the next cycle on the pipeline thread.
+    void startPipeline(const std::vector<State> &reference_points, const State &next_start_state,
+                       int quality_index);
+
+    // Move the reference of the pipeline into reference_path_ if it is valid for this cycle, waiting
+    // for it until the current deadline. A stale one is cancelled.
+    bool takePreparedReference(const std::vector<State> &reference_points);
+
     // Core function.
-    bool optimizePath(std::vector<State> *final_path);
+    bool optimizePath(std::vector<State> *final_path, SolveResult *result);
+
+    // The QP with FLAGS_solver_portfolio: all solvers of the portfolio in parallel on the same
+    // reference, the first feasible solution (or the smoothest within FLAGS_portfolio_wait_ms) wins
+    // and the others are cancelled: they do not start OSQP, or run it to the deadline's time limit
+    // and drop the result.
+    bool solvePortfolio(std::vector<State> *final_path, SolveResult *result);
 
     // Divide smoothed path into segments.
-    bool segmentSmoothedPath();
+    bool segmentSmoothedPath(SolveResult *result);
+
+    // Install the deadline of the stage that has to be done by budget_share of the time budget.
+    void beginStage(double budget_share);
 
-    const Map *grid_map_;
+    // Set the status to DEADLINE_EXCEEDED if the current deadline has expired.
+    bool deadlineExceeded(SolveResult *result) const;
+
+    // Put the best available path into final_path after the deadline expired.
+    void useFallback(SolveResult *result, std::vector<State> *final_path) const;
+
+    // Set the total time and the abnormal bounds, keep a successful path for fallbacks, and update
+    // metrics.
+    const SolveResult &finishSolve(const std::chrono::steady_clock::time_point &begin,
+                                   SolveResult *result,
+                                   std::vector<State> *final_path);
+
+    void runWorker();
+
+    Map *grid_map_;
     CollisionChecker *collision_checker_;
     ReferencePath *reference_path_;
     VehicleState *vehicle_state_;
+    // Scratch memory of one solve, reset at the start of the next.
+    Arena *arena_;
+    // Kept across solves while FLAGS_smoothing_method and FLAGS_optimization_method stay the same.
+    std::unique_ptr<ReferencePathSmoother> smoother_;
+    std::string smoother_type_;
+    std::unique_ptr<OsqpSolver> solver_;
+    std::string solver_type_;
     size_t size_{};
+    // Last successful output, the fallback when a later solve runs out of time.
+    std::vector<State> last_path_;
+    // True while the current solve has a smoothed reference path.
+    bool reference_smoothed_{false};
+    // FLAGS_enable_raw_output, off under a time budget.
+    bool raw_output_{true};
+    // Time budget of the running solve, 0 without.
+    double budget_ms_{0};
+    std::chrono::steady_clock::time_point solve_begin_;
+    // Deadline passed to the running solve, and that of its current stage, which also ends by the
+    // stage's share of the budget. stage_deadline_ is Deadline::current() during solve().
+    Deadline solve_deadline_;
+    Deadline stage_deadline_;
+    // Settings of the next budgeted solve.
+    SolveQuality quality_{SolveQuality::FULL};
+    // FLAGS_solver_portfolio solvers and their paths, rebuilt when the flag changes.
+    std::string portfolio_flag_;
+    std::vector<std::string> portfolio_types_;
+    std::vector<std::unique_ptr<OsqpSolver>> portfolio_solvers_;
+    std::vector<std::vector<State>> portfolio_paths_;
+    // Incremented by setMap(), so a reference prepared on another map is not used.
+    size_t map_version_{0};
+
+    // solvePipelined: smoothing of the next cycle, with its own smoother, reference path and arena.
+    // The inputs are copies. Never runs at the same time as smoother_: CppAD, which the IPOPT
+    // smoothers use, is not set up for parallel use.
+    std::future<bool> pipeline_;
+    std::unique_ptr<ReferencePathSmoother> pipeline_smoother_;
+    std::string pipeline_smoother_type_;
+    std::unique_ptr<ReferencePath> pipeline_reference_;
+    std::unique_ptr<Arena> pipeline_arena_;
+    std::vector<State> pipeline_points_;
+    State pipeline_start_state_;
+    size_t pipeline_map_version_{0};
+    // Cancelled by takePreparedReference() and setMap() when the reference will not be used.
+    Deadline pipeline_deadline_;
 
-    // For visualization purpose.
-    std::vector<State> smoothed_path_;
-    std::vector<std::vector<double>> reference_searching_display_;
+    // solveAsync worker, started by the first call.
+    struct AsyncJob {
+        std::packaged_task<AsyncSolveResult()> task;
+        Deadline deadline;
+    };
+    std::thread worker_;
+    std::mutex worker_mutex_;
+    std::condition_variable worker_cv_;
+    std::deque<AsyncJob> jobs_;
+    // Deadline of the job the worker is running, none() between jobs.
+    Deadline running_deadline_{Deadline::none()};
+    bool stop_worker_{false};
 };
 }
 
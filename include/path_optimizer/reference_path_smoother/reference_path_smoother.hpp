@@ -11,9 +11,11 @@
 #include <string>
 #include <queue>
 #include <ctime>
+#include <cmath>
 #include <tinyspline_ros/tinysplinecpp.h>
 #include <path_optimizer/tools/spline.h>
 #include "../data_struct/data_struct.hpp"
+#include "../tools/arena.hpp"
 
 namespace PathOptimizationNS {
 
@@ -36,34 +38,68 @@ class ReferencePathSmoother {
                                                          const Map &grid_map);
 
     bool solve(ReferencePath *reference_path, std::vector<State> *smoothed_path_display = nullptr);
+    // Smooth other input points with the next solve(). The start state and the map are the ones
+    // given at construction, they are held by reference.
+    void setInputPoints(const std::vector<State> &input_points);
+    // Cheaper settings for a solve under a time budget: the lateral spacing of the lattice search, and
+    // the iteration cap of the smoothing solver (0 for the solver default).
+    void setSearchLateralSpacing(double spacing);
+    void setMaxIterations(int max_iterations);
     std::vector<std::vector<double>> display() const;
+    // The lattice search of the last solve() found no path, so the raw input points were smoothed.
+    bool searchFailed() const;
 
  protected:
+    // Points every meter along the raw path, with their headings and / or unit tangents (either may be
+    // nullptr).
     bool segmentRawReference(std::vector<double> *x_list,
                              std::vector<double> *y_list,
                              std::vector<double> *s_list,
-                             std::vector<double> *angle_list) const;
+                             std::vector<double> *angle_list,
+                             std::vector<Tangent> *tangent_list = nullptr) const;
     double getClosestPointOnSpline(const tk::spline &x_s, const tk::spline &y_s, const double max_s) const;
+    // IPOPT options for a time limit of limit seconds, less if the current deadline is closer. The
+    // deadline is wall-clock time; max_cpu_time is also set for IPOPT before 3.14.
+    static std::string ipoptTimeLimit(double limit);
+    // Whether an IPOPT result can be used. Without an iteration cap only success counts; with one, a
+    // run stopped by the cap or the time limit keeps its last iterate. CppAD reports IPOPT's time
+    // limit exits as unknown.
+    template <class SolveResult>
+    bool ipoptResultUsable(const SolveResult &solution) const {
+        if (solution.status == SolveResult::success) return true;
+        if (max_iterations_ <= 0) return false;
+        if (solution.status != SolveResult::maxiter_exceeded && solution.status != SolveResult::unknown) {
+            return false;
+        }
+        for (size_t i = 0; i != solution.x.size(); ++i) {
+            if (!std::isfinite(solution.x[i])) return false;
+        }
+        return true;
+    }
     const State &start_state_;
     const Map &grid_map_;
     // Data to be passed into solvers.
     std::vector<double> x_list_, y_list_, s_list_;
+    int max_iterations_{0};
+    // Fit the input points with a B spline, result in x_list_, y_list_ and s_list_.
+    void bSpline();
+    // A* search. Replaces x_list_, y_list_ and s_list_ with the search result.
+    bool modifyInputPoints();
 
  private:
     virtual bool smooth(PathOptimizationNS::ReferencePath *reference_path,
                         std::vector<State> *smoothed_path_display) = 0;
-    void bSpline();
-    // A* search.
-    bool modifyInputPoints();
     bool checkExistenceInClosedSet(const APoint &point) const;
     double getG(const APoint &point, const APoint &parent) const;
     inline double getH(const APoint &p) const;
-    const std::vector<State> &input_points_;
-    // Sampled points in searching process.
-    std::vector<std::vector<APoint>> sampled_points_;
+    const std::vector<State> *input_points_;
+    double search_lateral_spacing_;
+    // Sampled points in searching process. The search containers live in the arena of the solve.
+    ArenaVector<ArenaVector<APoint>> sampled_points_;
     double target_s_{};
-    std::priority_queue<APoint *, std::vector<APoint *>, PointComparator> open_set_;
-    std::set<const APoint *> closed_set_;
+    bool search_failed_{false};
+    std::priority_queue<APoint *, ArenaVector<APoint *>, PointComparator> open_set_;
+    ArenaSet<const APoint *> closed_set_;
 
 };
 }
@@ -21,11 +21,11 @@ class FgEvalReferenceSmoothing {
     FgEvalReferenceSmoothing(const std::vector<double> &seg_x_list,
                              const std::vector<double> &seg_y_list,
                              const std::vector<double> &seg_s_list,
-                             const std::vector<double> &seg_angle_list) :
+                             const std::vector<Tangent> &seg_tangent_list) :
         seg_s_list_(seg_s_list),
         seg_x_list_(seg_x_list),
         seg_y_list_(seg_y_list),
-        seg_angle_list_(seg_angle_list) {}
+        seg_tangent_list_(seg_tangent_list) {}
     typedef CPPAD_TESTVECTOR(AD<double>) ADvector;
     typedef AD<double> ad;
     void operator()(ADvector &fg, const ADvector &vars);
@@ -33,7 +33,7 @@ class FgEvalReferenceSmoothing {
     const std::vector<double> &seg_s_list_;
     const std::vector<double> &seg_x_list_;
     const std::vector<double> &seg_y_list_;
-    const std::vector<double> &seg_angle_list_;
+    const std::vector<Tangent> &seg_tangent_list_;
 };
 
 class TensionSmoother final : public ReferencePathSmoother {
@@ -49,14 +49,14 @@ class TensionSmoother final : public ReferencePathSmoother {
                 std::vector<State> *smoothed_path_display) override;
     bool ipoptSmooth(const std::vector<double> &x_list,
                      const std::vector<double> &y_list,
-                     const std::vector<double> &angle_list,
+                     const std::vector<Tangent> &tangent_list,
                      const std::vector<double> &s_list,
                      std::vector<double> *result_x_list,
                      std::vector<double> *result_y_list,
                      std::vector<double> *result_s_list);
     bool osqpSmooth(const std::vector<double> &x_list,
                     const std::vector<double> &y_list,
-                    const std::vector<double> &angle_list,
+                    const std::vector<Tangent> &tangent_list,
                     const std::vector<double> &s_list,
                     std::vector<double> *result_x_list,
                     std::vector<double> *result_y_list,
@@ -64,11 +64,15 @@ class TensionSmoother final : public ReferencePathSmoother {
     void setHessianMatrix(size_t size, Eigen::SparseMatrix<double> *matrix_h) const;
     void setConstraintMatrix(const std::vector<double> &x_list,
                              const std::vector<double> &y_list,
-                             const std::vector<double> &angle_list,
+                             const std::vector<Tangent> &tangent_list,
                              const std::vector<double> &s_list,
                              Eigen::SparseMatrix<double> *matrix_constraints,
                              Eigen::VectorXd *lower_bound,
                              Eigen::VectorXd *upper_bound) const;
+    // Offset bound of a point without clearance with unit tangent tangent: far enough to leave the
+    // obstacle along the normal, estimated from the signed distance field. default_clearance if the map
+    // has no signed distance layer or the point is outside the map.
+    double collisionClearance(double x, double y, const Tangent &tangent, double default_clearance) const;
 };
 
 }
@@ -6,9 +6,12 @@
 #define PATH_OPTIMIZER_SOLVER_HPP
 
 #include <Eigen/Dense>
+#include <atomic>
 #include <memory>
 #include <OsqpEigen/OsqpEigen.h>
 #include "glog/logging.h"
+#include "path_optimizer/data_struct/solve_result.hpp"
+#include "sparsity_pattern.hpp"
 
 namespace PathOptimizationNS {
 
@@ -35,20 +38,106 @@ class OsqpSolver {
 
   virtual bool solve(std::vector<State> *optimized_path) = 0;
 
- private:
-  // Set Matrices for osqp solver.
-  virtual void setHessianMatrix(Eigen::SparseMatrix<double> *matrix_h) const = 0;
+  // Reuse this solver after the reference path changed, for its first horizon states. The OSQP
+  // settings and the matrix and bound buffers of the last solve are kept.
+  void reset(const size_t &horizon);
+
+  // The QP horizon for horizon reference states: the smallest of FLAGS_qp_horizon_buckets that holds
+  // them, or horizon itself.
+  static size_t bucketHorizon(size_t horizon);
+
+  // OSQP max_iter of the next solves, 0 for the OSQP default.
+  void setMaxIterations(int max_iterations);
+
+  // Make the solve running on another thread fail: OSQP does not start, or its result is dropped.
+  // OSQP itself is not interrupted, it stops at the time limit of the deadline it was started with.
+  // Holds until the next reset().
+  void cancel();
+
+  // Iterations, residuals, objective and timings of the last solve().
+  const QpInfo &getQpInfo() const;
 
-  virtual void setConstraintMatrix(Eigen::SparseMatrix<double> *matrix_constraints,
-                                   Eigen::VectorXd *lower_bound,
-                                   Eigen::VectorXd *upper_bound) const = 0;
+  // Build the matrices of the problem from scratch, for the kernel benchmarks. solve() refills the
+  // ones of the last solve instead when the size did not change.
+  void setHessianMatrix(Eigen::SparseMatrix<double> *matrix_h) const;
+
+  void setConstraintMatrix(Eigen::SparseMatrix<double> *matrix_constraints,
+                           Eigen::VectorXd *lower_bound,
+                           Eigen::VectorXd *upper_bound) const;
 
  protected:
-  const size_t horizon_{};
+  // Entries of the matrices for osqp solver. For a given horizon_ and controlSteps(), the same
+  // entries must be emitted in the same order, explicit zeros included (see SparsityPattern).
+  virtual void setHessianTriplets(Triplets *triplets) const = 0;
+
+  virtual void setConstraintTriplets(Triplets *triplets,
+                                     Eigen::VectorXd *lower_bound,
+                                     Eigen::VectorXd *upper_bound) const = 0;
+
+  virtual size_t numVariables() const = 0;
+
+  virtual size_t numConstraints() const = 0;
+
+  // States per control variable, the other parameter of the matrix layout besides horizon_.
+  virtual int controlSteps() const { return 1; }
+
+  // Copy the OSQP info of the last solve into qp_info_.
+  void updateQpInfo();
+
+  // Sizes derived from horizon_ and reference_interval_. Called by the constructors and reset().
+  virtual void updateSizes() {}
+
+  // osqp_setup and osqp_solve of the loaded problem, false if cancelled before or during.
+  bool runOsqp();
+
+  // Build the matrices and bounds of this problem into the member buffers and pass them to OSQP.
+  // If the last problem had the same layout, only the values are written, in place, and OSQP updates
+  // its workspace (osqp_update_P_A, no new setup and symbolic factorization). Otherwise the problem
+  // of the last solve is dropped and the patterns are recorded for the next one.
+  bool loadProblem();
+
+  // (*vector)(begin + stride * i) = bounds[i] + shift for the first active_horizon_ states, e.g. one
+  // covering circle of CircleBoundArrays interleaved with the others, and padding for the padded
+  // ones (-OsqpEigen::INFTY or OsqpEigen::INFTY, so that they constrain nothing).
+  void copyBounds(const std::vector<double> &bounds, double shift, size_t begin, size_t stride,
+                  double padding, Eigen::VectorXd *vector) const;
+
+  // Stages of the QP, which fix the matrix layout: active_horizon_ rounded up by bucketHorizon().
+  size_t horizon_{};
+  // Reference states in the QP. The stages after them are padding: the transitions hold the last
+  // state (ds = 0), their costs are 0 and their bounds inactive, so the solution is the one of the
+  // unpadded problem.
+  size_t active_horizon_{};
   const ReferencePath &reference_path_;
   const VehicleState &vehicle_state_;
   OsqpEigen::Solver solver_;
   double reference_interval_;
+  QpInfo qp_info_;
+  int max_iterations_{0};
+  // Set by cancel() from another thread.
+  std::atomic<bool> cancelled_{false};
+  Triplets hessian_triplets_;
+  Triplets constraint_triplets_;
+  // Layout of hessian_ (upper triangle) and linear_matrix_ in the OSQP workspace, if there is one.
+  SparsityPattern hessian_pattern_;
+  SparsityPattern constraint_pattern_;
+  size_t pattern_horizon_{0};
+  int pattern_control_steps_{0};
+  Eigen::SparseMatrix<double> hessian_;
+  Eigen::SparseMatrix<double> linear_matrix_;
+  Eigen::VectorXd gradient_;
+  Eigen::VectorXd lower_bound_;
+  Eigen::VectorXd upper_bound_;
+
+ private:
+  // Largest station interval among the first reference states.
+  void updateReferenceInterval();
+
+  // max_iter and time limit of the next solve, in settings or in the workspace of an earlier one.
+  void updateSettings();
+
+  // Refill the matrices and bounds of the OSQP workspace. False if the problem needs a new setup.
+  bool updateProblem();
 
 };
 
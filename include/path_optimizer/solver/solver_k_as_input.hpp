@@ -24,15 +24,15 @@ public:
 
  private:
     // Set Matrices for osqp solver.
-    void setHessianMatrix(Eigen::SparseMatrix<double> *matrix_h) const override ;
+    void setHessianTriplets(Triplets *triplets) const override;
 
-    void setDynamicMatrix(size_t i,
-                          Eigen::Matrix<double, 2, 2> *matrix_a,
-                          Eigen::Matrix<double, 2, 1> *matrix_b) const;
+    void setConstraintTriplets(Triplets *triplets,
+                               Eigen::VectorXd *lower_bound,
+                               Eigen::VectorXd *upper_bound) const override;
 
-    void setConstraintMatrix(Eigen::SparseMatrix<double> *matrix_constraints,
-                             Eigen::VectorXd *lower_bound,
-                             Eigen::VectorXd *upper_bound) const override ;
+    size_t numVariables() const override;
+
+    size_t numConstraints() const override;
 };
 } // namespace
 #endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_SOLVER_K_AS_INPUT_HPP_
@@ -22,17 +22,25 @@ class SolverKpAsInputConstrained : public OsqpSolver {
   bool solve(std::vector<State> *optimized_path) override;
 
  private:
-  void setHessianMatrix(Eigen::SparseMatrix<double> *matrix_h) const override;
+  void setHessianTriplets(Triplets *triplets) const override;
 
-  void setConstraintMatrix(Eigen::SparseMatrix<double> *matrix_constraints,
-                           Eigen::VectorXd *lower_bound,
-                           Eigen::VectorXd *upper_bound) const override;
+  void setConstraintTriplets(Triplets *triplets,
+                             Eigen::VectorXd *lower_bound,
+                             Eigen::VectorXd *upper_bound) const override;
 
-  const int keep_control_steps_{};
-  const size_t control_horizon_{};
-  const size_t state_size_{};
-  const size_t control_size_{};
-  const size_t slack_size_{};
+  size_t numVariables() const override;
+
+  size_t numConstraints() const override;
+
+  int controlSteps() const override;
+
+  void updateSizes() override;
+
+  int keep_control_steps_{};
+  size_t control_horizon_{};
+  size_t state_size_{};
+  size_t control_size_{};
+  size_t slack_size_{};
 };
 }
 
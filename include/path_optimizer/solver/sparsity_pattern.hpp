@@ -0,0 +1,42 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_SOLVER_SPARSITY_PATTERN_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_SOLVER_SPARSITY_PATTERN_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <Eigen/Sparse>
+#include "stage_kernels.hpp"
+
+namespace PathOptimizationNS {
+
+// CSC layout of a QP matrix built from triplets, kept to refill the matrix in place. The builders
+// emit the same entries in the same order for a given problem size, explicit zeros included, so
+// the next matrix of that size only needs its value array written: no sort and no reallocation,
+// and OSQP can take the values as they are.
+class SparsityPattern {
+ public:
+  // Build *matrix from triplets and remember where the value of each triplet went. With
+  // upper_triangular, the entries below the diagonal are dropped, as OSQP stores P.
+  void build(std::size_t rows, std::size_t cols, const Triplets &triplets, bool upper_triangular,
+             Eigen::SparseMatrix<double> *matrix);
+
+  // Overwrite the values of *matrix, built by build(), with the ones of triplets. False, and
+  // *matrix untouched, if triplets cannot have been emitted in the same order.
+  bool fillValues(const Triplets &triplets, Eigen::SparseMatrix<double> *matrix) const;
+
+  void clear() {
+    positions_.clear();
+  }
+
+  bool empty() const {
+    return positions_.empty();
+  }
+
+ private:
+  // Index into the value array for every triplet, -1 for the dropped ones.
+  std::vector<int> positions_;
+  std::size_t non_zeros_{0};
+};
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_SOLVER_SPARSITY_PATTERN_HPP_
@@ -0,0 +1,97 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_SOLVER_STAGE_KERNELS_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_SOLVER_STAGE_KERNELS_HPP_
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+
+namespace PathOptimizationNS {
+
+// Entries of a sparse matrix, turned into the matrix by buildSparse(). Unlike sparseView(), explicit
+// zeros are kept, so the sparsity pattern of a QP matrix depends only on its size.
+typedef std::vector<Eigen::Triplet<double>> Triplets;
+
+inline void addTriplet(std::size_t row, std::size_t col, double value, Triplets *triplets) {
+  triplets->emplace_back(static_cast<int>(row), static_cast<int>(col), value);
+}
+
+// Replace *matrix by the rows x cols matrix of triplets, duplicates summed.
+inline void buildSparse(std::size_t rows, std::size_t cols, const Triplets &triplets,
+                        Eigen::SparseMatrix<double> *matrix) {
+  matrix->resize(static_cast<Eigen::Index>(rows), static_cast<Eigen::Index>(cols));
+  matrix->setFromTriplets(triplets.begin(), triplets.end());
+}
+
+// One stage of the model linearized along the reference, x[i + 1] = A x[i] + B u + c, as the
+// constraint rows A x[i] + B u - x[i + 1] = rhs. The states are the first variables of the QP and
+// the transition rows the first constraints, both StateDim per step, so the rows of step i are the
+// columns of x[i + 1]. Only the structurally non-zero entries of the fixed-size blocks are emitted.
+template <int StateDim>
+class StageKernel;
+
+// Front wheel angle as input, state (e_phi, e_y).
+template <>
+class StageKernel<2> {
+ public:
+  typedef Eigen::Matrix<double, 2, 1> StateVector;
+  static constexpr int kNonZeros = 7;
+
+  explicit StageKernel(double wheel_base) : wheel_base_(wheel_base) {}
+
+  void emit(std::size_t step, std::size_t control_col, double ref_k, double ds,
+            Triplets *triplets, StateVector *rhs) const {
+    const std::size_t col = 2 * step;
+    const std::size_t row = col + 2;
+    const double ref_delta = atan(ref_k * wheel_base_);
+    // A = [1, -ds * k^2; ds, 1].
+    addTriplet(row, col, 1, triplets);
+    addTriplet(row, col + 1, -ds * pow(ref_k, 2), triplets);
+    addTriplet(row + 1, col, ds, triplets);
+    addTriplet(row + 1, col + 1, 1, triplets);
+    // B = [ds / L / cos(delta)^2; 0].
+    addTriplet(row, control_col, ds / wheel_base_ / pow(cos(ref_delta), 2), triplets);
+    addTriplet(row, row, -1, triplets);
+    addTriplet(row + 1, row + 1, -1, triplets);
+    (*rhs)(0) = ds * ref_delta / wheel_base_ / pow(cos(ref_delta), 2);
+    (*rhs)(1) = 0;
+  }
+
+ private:
+  double wheel_base_;
+};
+
+// Curvature rate as input, state (e_y, e_phi, k).
+template <>
+class StageKernel<3> {
+ public:
+  typedef Eigen::Matrix<double, 3, 1> StateVector;
+  static constexpr int kNonZeros = 10;
+
+  void emit(std::size_t step, std::size_t control_col, double ref_k, double ds,
+            Triplets *triplets, StateVector *rhs) const {
+    const std::size_t col = 3 * step;
+    const std::size_t row = col + 3;
+    // A = I + ds * [0, 1, 0; -k^2, 0, 1; 0, 0, 0].
+    addTriplet(row, col, 1, triplets);
+    addTriplet(row, col + 1, ds, triplets);
+    addTriplet(row + 1, col, -pow(ref_k, 2) * ds, triplets);
+    addTriplet(row + 1, col + 1, 1, triplets);
+    addTriplet(row + 1, col + 2, ds, triplets);
+    addTriplet(row + 2, col + 2, 1, triplets);
+    // B = [0; 0; ds].
+    addTriplet(row + 2, control_col, ds, triplets);
+    addTriplet(row, row, -1, triplets);
+    addTriplet(row + 1, row + 1, -1, triplets);
+    addTriplet(row + 2, row + 2, -1, triplets);
+    // -c of the linearization around (0, 0, k) with input (k[i + 1] - k) / ds.
+    (*rhs)(0) = 0;
+    (*rhs)(1) = ds * ref_k;
+    (*rhs)(2) = 0;
+  }
+};
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_SOLVER_STAGE_KERNELS_HPP_
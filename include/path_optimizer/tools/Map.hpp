@@ -8,20 +8,66 @@
 #include <iostream>
 #include <cassert>
 #include <stdexcept>
+#include <string>
+#include <memory>
 #include "Eigen/Core"
 #include <grid_map_core/grid_map_core.hpp>
+#include "path_optimizer/tools/map_backend.hpp"
+#include "path_optimizer/tools/distance_pyramid.hpp"
 
 namespace PathOptimizationNS {
 
 class Map {
  public:
     Map() = delete;
+    // The grid map must outlive the Map and its copies. With FLAGS_distance_layer_bits set, the distance
+    // layers are converted to fixed point here, so build the Map once and reuse it for large maps.
+    // The same holds for the FLAGS_distance_pyramid_levels levels of the distance pyramid.
     explicit Map(const grid_map::GridMap &grid_map);
+    // Any other storage, e.g. TiledDistanceField or a MapWindow of the corridor around the route.
+    // Copies share the backend and the pyramid.
+    explicit Map(std::shared_ptr<const MapBackend> backend,
+                 std::shared_ptr<const DistancePyramid> pyramid = nullptr);
     double getObstacleDistance(const Eigen::Vector2d &pos) const;
     bool isInside(const Eigen::Vector2d &pos) const;
+    // Coarse levels available to isClear(), 0 without a pyramid.
+    int getPyramidLevels() const;
+    // getObstacleDistance(pos) where it is below limit, otherwise any value >= limit. Tries the pyramid
+    // level (clamped to the available ones, 0 for none) first: one lookup there proves the limit away
+    // from obstacles, and only queries near them read the full resolution. A level-k cell bounds the
+    // distance anywhere within about 1.5 cell sizes (4^k grid cells), so use coarser levels only for
+    // limits well above that.
+    double getObstacleDistanceUpTo(const Eigen::Vector2d &pos, double limit, int level = 1) const;
+    // getObstacleDistance(pos) >= clearance, see getObstacleDistanceUpTo().
+    bool isClear(const Eigen::Vector2d &pos, double clearance, int level = 1) const;
+    // True if the backend has signed distances, e.g. a "signed_distance" layer, see buildSignedDistanceField().
+    bool hasSignedDistance() const;
+    // Distance to the closest obstacle, negative inside obstacles (minus the distance to free space).
+    // Same as getObstacleDistance() if there is no signed distance layer, 0 outside the map.
+    double getSignedDistance(const Eigen::Vector2d &pos) const;
+    // Gradient of getSignedDistance() by central differences over one cell. Points away from the
+    // closest obstacle boundary, so inside an obstacle it is the direction out of it. Zero outside the map.
+    Eigen::Vector2d getDistanceGradient(const Eigen::Vector2d &pos) const;
+    // Exact Euclidean distance in meters from every cell to the closest cell of obstacle_layer whose
+    // value is 0 (the image convention), written straight into distance_layer, which is added if missing.
+    // Same result as cv::distanceTransform with DIST_MASK_PRECISE times the resolution.
+    // Separable Felzenszwalb-Huttenlocher transform, columns then rows, on threads threads (0: all cores).
+    // Returns false if obstacle_layer does not exist.
+    static bool buildDistanceField(grid_map::GridMap *grid_map,
+                                   const std::string &obstacle_layer = "obstacle",
+                                   const std::string &distance_layer = "distance",
+                                   unsigned int threads = 0);
+    // buildDistanceField() plus signed_distance_layer: the distance layer inside free space, minus the
+    // distance to the closest free cell inside obstacles. Costs a second transform.
+    static bool buildSignedDistanceField(grid_map::GridMap *grid_map,
+                                         const std::string &obstacle_layer = "obstacle",
+                                         const std::string &distance_layer = "distance",
+                                         const std::string &signed_distance_layer = "signed_distance",
+                                         unsigned int threads = 0);
 
  private:
-    const grid_map::GridMap &maps;
+    std::shared_ptr<const MapBackend> backend_;
+    std::shared_ptr<const DistancePyramid> pyramid_;
 };
 }
 
@@ -0,0 +1,28 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_ALLOCATION_COUNTER_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_ALLOCATION_COUNTER_HPP_
+
+#include <cstdint>
+
+namespace PathOptimizationNS {
+
+// Heap allocations made by the whole process since it started. The counts come from the global
+// operator new replaced in src/tools/allocation_counter.cpp, which is not part of the library: only
+// executables that compile that file in (the benchmarks) can use this.
+struct AllocationCount {
+    uint64_t allocations{0};
+    uint64_t bytes{0};
+};
+
+AllocationCount allocationCount();
+
+// Difference of two counts, e.g. around one solve.
+inline AllocationCount operator-(const AllocationCount &after, const AllocationCount &before) {
+    AllocationCount count;
+    count.allocations = after.allocations - before.allocations;
+    count.bytes = after.bytes - before.bytes;
+    return count;
+}
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_ALLOCATION_COUNTER_HPP_
@@ -0,0 +1,118 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_ARENA_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_ARENA_HPP_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <set>
+#include <type_traits>
+#include <vector>
+
+namespace PathOptimizationNS {
+
+// Monotonic scratch memory for one planning cycle. Allocation bumps a pointer, deallocation does
+// nothing, and reset() makes all memory reusable at once. When a cycle needed more than the first
+// block, reset() replaces the blocks by one block of the total size, so a steady stream of similar
+// cycles allocates from the heap only in the first one.
+//
+// Not thread-safe; every planner thread needs its own arena.
+class Arena {
+ public:
+    explicit Arena(std::size_t initial_bytes = 64 * 1024);
+    ~Arena();
+    Arena(const Arena &arena) = delete;
+    Arena &operator=(const Arena &arena) = delete;
+
+    void *allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+    // Everything allocated before is invalid afterwards.
+    void reset();
+    // Bytes handed out since the last reset, including alignment padding.
+    std::size_t bytesUsed() const;
+    // Bytes held in blocks.
+    std::size_t capacity() const;
+    std::size_t blockCount() const {
+        return blocks_.size();
+    }
+
+    // The arena installed on the calling thread by ScopedArena, or nullptr.
+    static Arena *current();
+
+ private:
+    struct Block {
+        char *data;
+        std::size_t size;
+    };
+    void addBlock(std::size_t min_bytes);
+
+    std::vector<Block> blocks_;
+    // Offset into the last block.
+    std::size_t offset_{0};
+    // Bytes used in all blocks but the last.
+    std::size_t used_before_{0};
+};
+
+// Installs an arena as Arena::current() on this thread for the lifetime of the scope, restoring the
+// previous one afterwards. nullptr makes arena allocators fall back to the heap.
+class ScopedArena {
+ public:
+    explicit ScopedArena(Arena *arena);
+    ~ScopedArena();
+    ScopedArena(const ScopedArena &scoped_arena) = delete;
+    ScopedArena &operator=(const ScopedArena &scoped_arena) = delete;
+
+ private:
+    Arena *previous_;
+};
+
+// Standard allocator on an arena. A default-constructed allocator binds to Arena::current(), so
+// containers created inside a planning cycle draw from that cycle's arena and containers created
+// outside of one use the heap. The containers must not outlive the cycle they were created in.
+template <typename T>
+class ArenaAllocator {
+ public:
+    typedef T value_type;
+    // Assigning a new container (e.g. an empty one) also moves a long-lived container to the arena
+    // of the current cycle.
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator() : arena_(Arena::current()) {}
+    explicit ArenaAllocator(Arena *arena) : arena_(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena()) {}
+
+    T *allocate(std::size_t n) {
+        if (arena_) return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T)));
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T *p, std::size_t) {
+        if (!arena_) ::operator delete(p);
+    }
+    Arena *arena() const {
+        return arena_;
+    }
+
+ private:
+    Arena *arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena() != b.arena();
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+template <typename T, typename Compare = std::less<T>>
+using ArenaSet = std::set<T, Compare, ArenaAllocator<T>>;
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_ARENA_HPP_
@@ -0,0 +1,35 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_BLOCKED_DISTANCE_FIELD_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_BLOCKED_DISTANCE_FIELD_HPP_
+
+#include <vector>
+#include <grid_map_core/grid_map_core.hpp>
+#include "path_optimizer/tools/map_backend.hpp"
+
+namespace PathOptimizationNS {
+
+// Float copy of the "distance" (and "signed_distance", if present) layer in a cache-blocked CellLayout.
+// Same values and interpolation as GridMapBackend, only the memory order differs.
+class BlockedDistanceField final : public MapBackend {
+ public:
+    BlockedDistanceField() = delete;
+    // Copies the layers once; the grid map is not referenced afterwards.
+    BlockedDistanceField(const grid_map::GridMap &grid_map, CellLayout layout);
+
+    bool isInside(const Eigen::Vector2d &pos) const override;
+    double getObstacleDistance(const Eigen::Vector2d &pos) const override;
+    bool hasSignedDistance() const override;
+    double getSignedDistance(const Eigen::Vector2d &pos) const override;
+    double getResolution() const override;
+
+ private:
+    void copyLayer(const grid_map::GridMap &grid_map, const std::string &layer, std::vector<float> *cells) const;
+
+    GridGeometry geometry_;
+    CellIndexer indexer_;
+    std::vector<float> distance_;
+    std::vector<float> signed_distance_;
+};
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_BLOCKED_DISTANCE_FIELD_HPP_
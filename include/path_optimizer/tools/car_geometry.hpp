@@ -19,6 +19,8 @@ public:
     CarGeometry(double width, double back_length, double front_length);
     void init(double width, double back_length, double front_length);
     std::vector<Circle> getCircles(const State &pos) const;
+    // Same, into circles, reusing its capacity.
+    void getCircles(const State &pos, std::vector<Circle> *circles) const;
     Circle getBoundingCircle(const State &pos) const;
 
 private:
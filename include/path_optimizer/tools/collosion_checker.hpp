@@ -17,6 +17,9 @@ class CollisionChecker {
 public:
     CollisionChecker() = delete;
     CollisionChecker(const grid_map::GridMap &in_gm);
+    explicit CollisionChecker(const Map &map);
+
+    void setMap(const Map &map);
 
     bool isSingleStateCollisionFreeImproved(const State &current);
 
@@ -24,8 +27,10 @@ public:
 
 
 private:
-    const Map map_;
+    Map map_;
     CarGeometry car_;
+    // Footprint of the last exact check, kept to reuse its memory.
+    std::vector<Circle> footprint_;
 };
 
 }
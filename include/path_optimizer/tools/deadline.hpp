@@ -0,0 +1,74 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_DEADLINE_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_DEADLINE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace PathOptimizationNS {
+
+// Time budget of one solve, which can also be cancelled from another thread. Copies share the
+// cancellation, so the caller keeps a copy to cancel the solve it handed the deadline to.
+//
+// Cancellation is cooperative: PathOptimizer installs the deadline of the running solve with
+// ScopedDeadline, the stages test Deadline::currentExpired() at their checkpoints (between stages,
+// in the lattice search, the bound search and the output check), and IPOPT and OSQP get the time
+// that is left as their own time limit.
+class Deadline {
+ public:
+    typedef std::chrono::steady_clock Clock;
+    // No time limit, only cancellation.
+    Deadline();
+    explicit Deadline(Clock::time_point time);
+    // ms from now.
+    static Deadline after(double ms);
+    // No time limit and never cancelled: it has no cancellation to share, cancel() does nothing.
+    // Unlike Deadline(), does not allocate.
+    static const Deadline &none();
+    // Same cancellation, with the time limit moved to time if that is earlier.
+    Deadline earlier(Clock::time_point time) const;
+
+    // Thread-safe.
+    void cancel();
+    // False for none() and its copies.
+    bool isCancellable() const;
+    bool isCancelled() const;
+    bool hasTimeLimit() const;
+    // The time limit, Clock::time_point::max() without.
+    Clock::time_point time() const;
+    // Cancelled or past the time limit.
+    bool expired() const;
+    // Seconds left, at most limit. 0 once expired.
+    double remainingSeconds(double limit) const;
+
+    // The deadline installed on the calling thread by ScopedDeadline, or nullptr.
+    static const Deadline *current();
+    // Checkpoint: false if there is no current deadline.
+    static bool currentExpired();
+    // A solver time limit in seconds, shortened to the time left of the current deadline. Never
+    // returns 0, which IPOPT rejects and OSQP reads as no limit.
+    static double currentTimeLimit(double limit);
+
+ private:
+    Deadline(Clock::time_point time, std::shared_ptr<std::atomic<bool>> cancelled);
+
+    Clock::time_point time_;
+    // nullptr if not cancellable.
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+// Installs a deadline as Deadline::current() on this thread for the lifetime of the scope.
+class ScopedDeadline {
+ public:
+    explicit ScopedDeadline(const Deadline *deadline);
+    ~ScopedDeadline();
+    ScopedDeadline(const ScopedDeadline &scoped_deadline) = delete;
+    ScopedDeadline &operator=(const ScopedDeadline &scoped_deadline) = delete;
+
+ private:
+    const Deadline *previous_;
+};
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_DEADLINE_HPP_
@@ -0,0 +1,45 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_DISTANCE_PYRAMID_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_DISTANCE_PYRAMID_HPP_
+
+#include <vector>
+#include <grid_map_core/grid_map_core.hpp>
+#include "path_optimizer/tools/map_backend.hpp"
+
+namespace PathOptimizationNS {
+
+// Coarse copies of the distances of a map backend for queries that only need to prove clearance.
+// Level k has cells factor^k times larger than the grid (0.2 / 0.8 / 3.2 m for factor 4).
+// A coarse cell holds the minimum over its fine cells plus a ring of one fine cell around them: the
+// bilinear distance anywhere in the coarse cell only mixes those cells, so the value is a lower
+// bound of Map::getObstacleDistance() there, without any margin. The fine cells are read from the
+// backend at their centers, so a quantized backend gets the bounds of its own rounded values.
+class DistancePyramid {
+ public:
+    DistancePyramid() = delete;
+    // geometry is that of the backend's cells.
+    DistancePyramid(const GridGeometry &geometry, const MapBackend &backend, int levels, int factor = 4);
+    // Number of coarse levels, not counting the grid map itself.
+    int levels() const {
+        return static_cast<int>(levels_.size());
+    }
+    double getResolution(int level) const;
+    // Lower bound of the distance in the level cell containing pos, 1 <= level <= levels().
+    // pos must be inside the map.
+    double lowerBound(const Eigen::Vector2d &pos, int level) const;
+
+ private:
+    struct Level {
+        int rows;
+        int cols;
+        // Fine cells per cell of this level along each axis.
+        int scale;
+        // Column-major.
+        std::vector<float> cells;
+    };
+    GridGeometry geometry_;
+    std::vector<Level> levels_;
+};
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_DISTANCE_PYRAMID_HPP_
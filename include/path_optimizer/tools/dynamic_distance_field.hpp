@@ -0,0 +1,85 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_DYNAMIC_DISTANCE_FIELD_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_DYNAMIC_DISTANCE_FIELD_HPP_
+
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+#include <grid_map_core/grid_map_core.hpp>
+
+namespace PathOptimizationNS {
+
+// Keeps the "distance" layer of a grid map up to date while obstacles are inserted and removed,
+// with the dynamic brushfire algorithm of Lau et al., "Improved updating of Euclidean distance
+// maps and Voronoi diagrams" (IROS 2010).
+// Only cells whose nearest obstacle changes are visited, and distances are capped at
+// max_distance, so an update costs O(changed area * max_distance^2) instead of O(map size).
+// The obstacle layer uses the convention of the image-based maps: 0 is occupied.
+class DynamicDistanceField {
+ public:
+    DynamicDistanceField() = delete;
+    // Builds the distance layer once from the obstacle layer, O(map size).
+    // The map is converted to the default start index if needed.
+    explicit DynamicDistanceField(grid_map::GridMap *grid_map,
+                                  const std::string &obstacle_layer = "obstacle",
+                                  const std::string &distance_layer = "distance",
+                                  double max_distance = 10.0);
+    DynamicDistanceField(const DynamicDistanceField &field) = delete;
+    DynamicDistanceField &operator=(const DynamicDistanceField &field) = delete;
+
+    // Queue a change. The obstacle layer is changed at once, the distance layer by update().
+    // Return false if the position is outside the map.
+    bool setObstacle(const grid_map::Position &position);
+    bool removeObstacle(const grid_map::Position &position);
+    void setObstacle(const grid_map::Index &index);
+    void removeObstacle(const grid_map::Index &index);
+
+    // Propagate all queued changes into the distance layer. Returns the number of cells processed.
+    std::size_t update();
+
+ private:
+    enum class QueueState : uint8_t { NONE, QUEUED, PROCESSED, RAISE_QUEUED, RAISE_PROCESSED };
+    struct Cell {
+        // Linear index of the closest obstacle cell, -1 if none within max_distance.
+        int obstacle{-1};
+        int squared_distance{};
+        bool raise{false};
+        QueueState state{QueueState::NONE};
+    };
+    // Linear indices are column-major, like the layer matrices.
+    int toLinear(const grid_map::Index &index) const {
+        return index(1) * rows_ + index(0);
+    }
+    bool isOccupied(int linear) const {
+        return cells_[linear].obstacle == linear;
+    }
+    int squaredDistance(int a, int b) const;
+    void setObstacle(int linear);
+    void removeObstacle(int linear);
+    void lower(int linear);
+    void raise(int linear);
+    void push(int squared_distance, int linear);
+    void writeDistance(int linear);
+    // Layers are looked up by name once per public call, not per cell.
+    void bindLayers();
+
+    grid_map::GridMap *grid_map_;
+    const std::string obstacle_layer_;
+    const std::string distance_layer_;
+    int rows_{};
+    int cols_{};
+    double resolution_{};
+    // Distances are clamped to this many cells; cells further away keep max_squared_distance_ + 1.
+    int max_squared_distance_{};
+    float max_distance_{};
+    std::vector<Cell> cells_;
+    float *obstacle_data_{nullptr};
+    float *distance_data_{nullptr};
+    typedef std::pair<int, int> QueueEntry;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> open_;
+};
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_DYNAMIC_DISTANCE_FIELD_HPP_
@@ -0,0 +1,141 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_MAP_BACKEND_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_MAP_BACKEND_HPP_
+
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include "Eigen/Core"
+#include <grid_map_core/grid_map_core.hpp>
+
+namespace PathOptimizationNS {
+
+// Cells of a grid map with the default start index: cell (0, 0) is at the +x +y corner, rows go along -x
+// and columns along -y.
+struct GridGeometry {
+    GridGeometry() = default;
+    explicit GridGeometry(const grid_map::GridMap &grid_map);
+    GridGeometry(int rows, int cols, double resolution, double center_x, double center_y);
+    // Cell containing pos, and the offsets of pos from its center in cells, towards increasing indices.
+    // Returns false outside the map.
+    bool locate(const Eigen::Vector2d &pos, int *row, int *col, double *row_offset, double *col_offset) const;
+    bool isInside(const Eigen::Vector2d &pos) const;
+    int rows{};
+    int cols{};
+    double resolution{};
+    // Position of the outer corner of cell (0, 0).
+    double top_x{};
+    double top_y{};
+};
+
+// Bilinear interpolation between the four closest cell centers, nearest cell at the border, like
+// grid_map INTER_LINEAR. cell(row, col) returns the value of a cell. pos must be inside the map.
+template <typename CellFunction>
+double interpolateBilinear(const GridGeometry &geometry, const Eigen::Vector2d &pos, const CellFunction &cell) {
+    int row, col;
+    double dr, dc;
+    geometry.locate(pos, &row, &col, &dr, &dc);
+    const int other_row = dr < 0 ? row - 1 : row + 1;
+    const int other_col = dc < 0 ? col - 1 : col + 1;
+    if (other_row < 0 || other_row >= geometry.rows || other_col < 0 || other_col >= geometry.cols) {
+        return cell(row, col);
+    }
+    const double tr = std::fabs(dr), tc = std::fabs(dc);
+    return (1 - tr) * ((1 - tc) * cell(row, col) + tc * cell(row, other_col))
+        + tr * ((1 - tc) * cell(other_row, col) + tc * cell(other_row, other_col));
+}
+
+// Order of the cells in memory. Bound search scans across the route and footprint checks touch
+// neighboring cells in both directions, so blocked layouts keep a query in fewer cache lines than the
+// column-major layer matrices.
+enum class CellLayout {
+    COLUMN_MAJOR,
+    // 8 x 8 cell tiles, row-major, tiles row-major. A float tile is four cache lines.
+    TILED,
+    // Z-order inside 64 x 64 cell tiles, tiles row-major. Neighbors in both directions stay close at
+    // every scale up to the tile.
+    MORTON
+};
+
+// Offsets of cells in an array of rows x cols cells in a layout. Edge tiles are padded.
+class CellIndexer {
+ public:
+    CellIndexer() = default;
+    CellIndexer(CellLayout layout, int rows, int cols);
+    // Number of cells to allocate, including padding.
+    std::size_t size() const {
+        return size_;
+    }
+    std::size_t offset(int row, int col) const {
+        switch (layout_) {
+            case CellLayout::TILED:
+                return (static_cast<std::size_t>(row >> 3) * tile_cols_ + (col >> 3)) << 6
+                    | (row & 7) << 3 | (col & 7);
+            case CellLayout::MORTON:
+                return (static_cast<std::size_t>(row >> 6) * tile_cols_ + (col >> 6)) << 12
+                    | spreadBits(row & 63) << 1 | spreadBits(col & 63);
+            default:
+                return static_cast<std::size_t>(col) * rows_ + row;
+        }
+    }
+
+ private:
+    // abcdef -> 0a0b0c0d0e0f
+    static std::size_t spreadBits(int value) {
+        std::size_t bits = static_cast<std::size_t>(value);
+        bits = (bits | bits << 4) & 0x0f0f;
+        bits = (bits | bits << 2) & 0x3333;
+        bits = (bits | bits << 1) & 0x5555;
+        return bits;
+    }
+
+    CellLayout layout_{CellLayout::COLUMN_MAJOR};
+    int rows_{};
+    int tile_cols_{};
+    std::size_t size_{};
+};
+
+// Parse "column_major", "tiled" or "morton". Returns false for anything else.
+bool parseCellLayout(const std::string &name, CellLayout *layout);
+
+// Storage behind Map. Positions are in the map frame, distances in meters.
+class MapBackend {
+ public:
+    virtual ~MapBackend() = default;
+    virtual bool isInside(const Eigen::Vector2d &pos) const = 0;
+    // Bilinear distance to the closest obstacle. Only called with positions inside the map.
+    virtual double getObstacleDistance(const Eigen::Vector2d &pos) const = 0;
+    virtual bool hasSignedDistance() const {
+        return false;
+    }
+    // Only called with positions inside the map, and if hasSignedDistance() is true.
+    virtual double getSignedDistance(const Eigen::Vector2d &pos) const {
+        return getObstacleDistance(pos);
+    }
+    virtual double getResolution() const = 0;
+};
+
+// The "distance" and, if present, "signed_distance" layers of a grid map, which must outlive the backend.
+class GridMapBackend final : public MapBackend {
+ public:
+    GridMapBackend() = delete;
+    explicit GridMapBackend(const grid_map::GridMap &grid_map);
+    bool isInside(const Eigen::Vector2d &pos) const override;
+    double getObstacleDistance(const Eigen::Vector2d &pos) const override;
+    bool hasSignedDistance() const override;
+    double getSignedDistance(const Eigen::Vector2d &pos) const override;
+    double getResolution() const override;
+
+ private:
+    const grid_map::GridMap &maps;
+    const bool has_signed_distance_;
+};
+
+// GridMapBackend, or a copy of the grid map in another format: a QuantizedDistanceField if
+// FLAGS_distance_layer_bits is 8 or 16, a BlockedDistanceField if FLAGS_distance_layer_layout is not
+// column_major. The quantized layer uses the layout too.
+std::shared_ptr<const MapBackend> createMapBackend(const grid_map::GridMap &grid_map);
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_MAP_BACKEND_HPP_
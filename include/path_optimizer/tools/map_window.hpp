@@ -0,0 +1,72 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_MAP_WINDOW_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_MAP_WINDOW_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <grid_map_core/grid_map_core.hpp>
+#include "path_optimizer/tools/map_backend.hpp"
+
+namespace PathOptimizationNS {
+class State;
+
+// Part of a grid map, read in place: nothing is copied, so building a window around the route of every
+// cycle is cheap even on a large rolling map. Positions outside the window are outside the map, which
+// bounds what the planner can read to the corridor; isInside() is a rectangle test, then a lookup in the
+// column span of the row. Distances inside the window are the same as GridMapBackend's.
+// The grid map must outlive the window, and its layers must not be added, removed or resized meanwhile
+// (writing cells, e.g. with DynamicDistanceField, is fine).
+class MapWindow final : public MapBackend {
+ public:
+    MapWindow() = delete;
+    // Cells overlapping the box between the two corners, clipped to the map. May be empty.
+    MapWindow(const grid_map::GridMap &grid_map, const Eigen::Vector2d &min_corner, const Eigen::Vector2d &max_corner);
+    // Cells within margin of the route polyline, by default the corridor the planner reads:
+    // FLAGS_search_lateral_range plus the 5 m of the bound search. Each row keeps one span of columns,
+    // from the first to the last corridor cell in it, so a route crossing a row twice (e.g. a U-turn)
+    // also keeps the cells between the crossings.
+    static std::shared_ptr<MapWindow> aroundRoute(const grid_map::GridMap &grid_map,
+                                                  const std::vector<State> &route,
+                                                  double margin = -1);
+
+    bool isInside(const Eigen::Vector2d &pos) const override;
+    double getObstacleDistance(const Eigen::Vector2d &pos) const override;
+    bool hasSignedDistance() const override;
+    double getSignedDistance(const Eigen::Vector2d &pos) const override;
+    double getResolution() const override;
+    int getRows() const {
+        return row_end_ - row_begin_;
+    }
+    int getCols() const {
+        return col_end_ - col_begin_;
+    }
+    // Bytes of layer data queries can read: the window plus the ring of cells interpolation reaches, for
+    // every layer in use. The rest of the grid map is never touched.
+    std::size_t touchedBytes() const;
+
+ private:
+    float cell(const float *data, int row, int col) const;
+    // Narrow every row to the columns within margin of the route.
+    void keepCorridor(const std::vector<State> &route, double margin);
+
+    // The whole grid map; interpolation uses its cells, so values match at the window border too.
+    GridGeometry geometry_;
+    // Window in map indices with the default start index, [begin, end).
+    int row_begin_{};
+    int row_end_{};
+    int col_begin_{};
+    int col_end_{};
+    // Columns [span_begin_[i], span_end_[i]) of row row_begin_ + i are inside; empty for the whole
+    // rectangle.
+    std::vector<int> span_begin_;
+    std::vector<int> span_end_;
+    // Circular buffer start of the grid map.
+    int start_row_{};
+    int start_col_{};
+    const float *distance_{nullptr};
+    const float *signed_distance_{nullptr};
+};
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_MAP_WINDOW_HPP_
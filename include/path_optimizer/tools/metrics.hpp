@@ -0,0 +1,166 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_METRICS_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_METRICS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace PathOptimizationNS {
+
+// Monotonic event counter.
+class Counter {
+ public:
+    void increment(uint64_t n = 1) {
+        value_.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t value() const {
+        return value_.load(std::memory_order_relaxed);
+    }
+    void reset() {
+        value_.store(0, std::memory_order_relaxed);
+    }
+
+ private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// HDR-style histogram of non-negative integer values (e.g. microseconds).
+// Each power of two is split into kSubBuckets linear buckets, so any reported quantile is
+// within 1 / kSubBuckets (~3%) of the true value. Recording is lock-free.
+class Histogram {
+ public:
+    static constexpr int kSubBucketBits = 5;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    Histogram();
+    void record(uint64_t value);
+    uint64_t count() const;
+    uint64_t sum() const;
+    uint64_t max() const;
+    // q in [0, 1]. Returns 0 if nothing is recorded.
+    double quantile(double q) const;
+    void reset();
+
+ private:
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketLowest(int index);
+    static uint64_t bucketHighest(int index);
+    std::atomic<uint64_t> buckets_[kBucketCount];
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Records the wall-clock duration of a scope into a histogram, in microseconds.
+class ScopedLatency {
+ public:
+    explicit ScopedLatency(Histogram *histogram) :
+        histogram_(histogram),
+        begin_(std::chrono::steady_clock::now()) {}
+    ~ScopedLatency() {
+        stop();
+    }
+    // Record now instead of at the end of the scope. Returns the elapsed time in ms.
+    double stop();
+    ScopedLatency(const ScopedLatency &latency) = delete;
+    ScopedLatency &operator=(const ScopedLatency &latency) = delete;
+
+ private:
+    Histogram *histogram_;
+    std::chrono::steady_clock::time_point begin_;
+    double elapsed_ms_{0};
+};
+
+// Named metrics, exportable as Prometheus text. A metric is identified by its family name and a
+// label set such as stage="bounds". Returned pointers stay valid for the lifetime of the process,
+// so callers are expected to look them up once and keep them.
+class MetricsRegistry {
+ public:
+    static MetricsRegistry &instance();
+    MetricsRegistry(const MetricsRegistry &registry) = delete;
+    MetricsRegistry &operator=(const MetricsRegistry &registry) = delete;
+
+    Counter *counter(const std::string &family, const std::string &labels = "");
+    Histogram *histogram(const std::string &family, const std::string &labels = "");
+    // Lookup without registering; nullptr if the metric does not exist.
+    const Counter *findCounter(const std::string &family, const std::string &labels = "") const;
+    const Histogram *findHistogram(const std::string &family, const std::string &labels = "") const;
+
+    // Counters are exported as counters; histograms as summaries (p50, p90, p99, p999, _sum,
+    // _count) plus a <family>_max gauge.
+    std::string toPrometheusText() const;
+    // Write atomically (temp file + rename), as the node exporter textfile collector expects.
+    bool dumpPrometheus(const std::string &file) const;
+    // Dump to FLAGS_metrics_file, at most once every FLAGS_metrics_dump_interval seconds.
+    void maybeDump();
+    // Zero every metric, keeping registrations.
+    void reset();
+
+ private:
+    MetricsRegistry() = default;
+    mutable std::mutex mutex_;
+    std::map<std::string, std::map<std::string, std::unique_ptr<Counter>>> counters_;
+    std::map<std::string, std::map<std::string, std::unique_ptr<Histogram>>> histograms_;
+    std::atomic<int64_t> last_dump_ns_{0};
+};
+
+// Planning stages with a latency histogram path_optimizer_stage_latency_us{stage="..."}.
+enum class PlanningStage {
+    SOLVE,
+    SOLVE_WITHOUT_SMOOTHING,
+    SMOOTHING,
+    SEARCH,
+    SEGMENTATION,
+    BOUNDS,
+    QP_BUILD,
+    QP_SOLVE,
+    OUTPUT_CHECK,
+    NUM_STAGES
+};
+
+// Failure reasons counted in path_optimizer_failures_total{reason="..."}, once per failed solve and
+// reason. A failed lattice search only counts if smoothing the raw input then failed too, which also
+// counts as smoothing_failed.
+enum class FailureReason {
+    EMPTY_INPUT,
+    SMOOTHING_FAILED,
+    SEARCH_FAILED,
+    LARGE_HEADING_ERROR,
+    EMPTY_REFERENCE,
+    PATH_BLOCKED,
+    QP_FAILED,
+    COLLISION,
+    DEADLINE,
+    NUM_REASONS
+};
+
+const char *toString(PlanningStage stage);
+const char *toString(FailureReason reason);
+Histogram *stageLatency(PlanningStage stage);
+void countFailure(FailureReason reason);
+// Station of a failed output collision check, in cm.
+Histogram *collisionStation();
+// Scratch arena bytes used by one solve.
+Histogram *arenaBytes();
+// path_optimizer_solves_total{result="success"|"failure"}
+void countSolve(bool success);
+// path_optimizer_portfolio_results_total{solver="K"|"KP"|"KPC",result=...}: won, feasible but not
+// taken, failed (including cancelled), for the win rate of each solver of FLAGS_solver_portfolio.
+enum class PortfolioResult {
+    WON,
+    FEASIBLE,
+    FAILED
+};
+void countPortfolioResult(const std::string &solver, PortfolioResult result);
+// path_optimizer_qp_setups_total{result="reused"|"setup"}: QP solves that updated the OSQP workspace
+// of the last solve vs. set up a new one, for the hit rate of FLAGS_qp_horizon_buckets.
+void countQpSetup(bool reused);
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_METRICS_HPP_
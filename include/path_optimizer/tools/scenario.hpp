@@ -0,0 +1,50 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_SCENARIO_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_SCENARIO_HPP_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <opencv2/core/core.hpp>
+#include <grid_map_core/grid_map_core.hpp>
+#include "path_optimizer/data_struct/data_struct.hpp"
+
+namespace PathOptimizationNS {
+
+// A planning problem for benchmarks: map, reference points, start/goal and flag overrides.
+//
+// Scenario files are plain text with one "key values..." entry per line, '#' starts a comment.
+// Relative file names are resolved against the directory of the scenario file.
+//   map <image>                           obstacle image, black (0) is occupied
+//   distance_field <file> <rows> <cols>   raw row-major float32 distance in meters, instead of map
+//   resolution <m>                        default 0.2
+//   origin <x> <y>                        position of the map center, default 0 0
+//   start <x> <y> <heading>
+//   goal <x> <y> <heading>
+//   point <x> <y>                         reference point, in order
+//   flag <name> <value>                   gflags override, e.g. "flag car_width 2.2"
+//   synthetic <field> <value>             a SyntheticScenarioConfig field, e.g. "synthetic route_length 800";
+//                                         the map and route are then generated, instead of map, start,
+//                                         goal and point entries
+struct Scenario {
+    std::string name;
+    grid_map::GridMap map;
+    std::vector<State> reference_points;
+    State start;
+    State goal;
+    std::vector<std::pair<std::string, std::string>> flags;
+};
+
+// Fill "obstacle", "distance" and "signed_distance" layers from an 8-bit image where 0 is occupied.
+void gridMapFromImage(const cv::Mat &image,
+                      double resolution,
+                      const grid_map::Position &origin,
+                      grid_map::GridMap *grid_map);
+
+bool loadScenario(const std::string &file, Scenario *scenario);
+
+// All *.scenario files in a directory, sorted by name.
+std::vector<std::string> listScenarioFiles(const std::string &dir);
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_SCENARIO_HPP_
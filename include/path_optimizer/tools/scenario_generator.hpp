@@ -0,0 +1,32 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_SCENARIO_GENERATOR_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_SCENARIO_GENERATOR_HPP_
+
+#include <cstdint>
+#include "path_optimizer/tools/scenario.hpp"
+
+namespace PathOptimizationNS {
+
+struct SyntheticScenarioConfig {
+    uint32_t seed{0};
+    // Square map covering [0, map_size] x [0, map_size].
+    double map_size{200};
+    double resolution{0.2};
+    // Fraction of the map covered by random circles and boxes, before the corridor is cleared.
+    double obstacle_density{0.05};
+    // Obstacle-free band centered on the reference line.
+    double corridor_width{8};
+    double route_length{150};
+    double max_curvature{0.05};
+    // Interval of the reference points.
+    double point_spacing{1.0};
+};
+
+// Build a map and a matching reference line. The same config always gives the same scenario
+// (only std::mt19937 is used, no implementation-defined distributions).
+// The route turns back towards the map center near the border, so it may be shorter than
+// route_length on small maps.
+bool generateScenario(const SyntheticScenarioConfig &config, Scenario *scenario);
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_SCENARIO_GENERATOR_HPP_
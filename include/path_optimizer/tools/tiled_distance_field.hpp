@@ -0,0 +1,72 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_TILED_DISTANCE_FIELD_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_TILED_DISTANCE_FIELD_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <grid_map_core/grid_map_core.hpp>
+#include "path_optimizer/tools/map_backend.hpp"
+
+namespace PathOptimizationNS {
+
+// Read-only distance field in a memory-mapped file, for maps too large to hold as a grid map in every
+// planner process. The file is mapped shared, so all processes on a host use the same page cache, and
+// only the tiles that queries touch are read from disk. Opening costs one mmap, not a load.
+//
+// File layout, little endian:
+//   header, padded to 4096 bytes:
+//     char[8] magic "PODTILE1", uint32 version (1), uint32 tile size (64), uint32 encoding,
+//     uint32 rows, uint32 cols, uint32 tile rows, uint32 tile cols, uint32 reserved,
+//     double resolution, double center x, double center y, double meters per unit
+//   tiles, row-major (tile (i, j) is number i * tile cols + j), each 64 x 64 cells row-major.
+// Cell (row, col) is grid map index (row, col) with the default start index, so it covers the same
+// area as in the grid map the file was written from. Edge tiles are padded.
+class TiledDistanceField final : public MapBackend {
+ public:
+    enum class Encoding : uint32_t {
+        FLOAT32 = 0,
+        // Distance / meters per unit, rounded. Meters per unit is max_distance / 65535.
+        UINT16 = 1
+    };
+    // Returns nullptr if the file cannot be mapped or is not a valid tiled distance field.
+    static std::unique_ptr<TiledDistanceField> open(const std::string &file);
+    // Write a layer of a grid map. Distances beyond max_distance are clamped (UINT16 only).
+    static bool write(const grid_map::GridMap &grid_map,
+                      const std::string &layer,
+                      const std::string &file,
+                      Encoding encoding = Encoding::FLOAT32,
+                      double max_distance = 20.0);
+
+    ~TiledDistanceField() override;
+    TiledDistanceField(const TiledDistanceField &field) = delete;
+    TiledDistanceField &operator=(const TiledDistanceField &field) = delete;
+
+    bool isInside(const Eigen::Vector2d &pos) const override;
+    // Bilinear between the four closest cell centers, nearest at the border, like grid_map INTER_LINEAR.
+    double getObstacleDistance(const Eigen::Vector2d &pos) const override;
+    double getResolution() const override;
+    int getRows() const {
+        return geometry_.rows;
+    }
+    int getCols() const {
+        return geometry_.cols;
+    }
+
+ private:
+    TiledDistanceField() = default;
+    double cell(int row, int col) const;
+
+    void *mapping_{nullptr};
+    std::size_t mapping_size_{};
+    const unsigned char *tiles_{nullptr};
+    Encoding encoding_{Encoding::FLOAT32};
+    GridGeometry geometry_;
+    int tile_cols_{};
+    std::size_t tile_bytes_{};
+    double scale_{};
+};
+
+}
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_TILED_DISTANCE_FIELD_HPP_
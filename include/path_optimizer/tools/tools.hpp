@@ -9,6 +9,7 @@
 #include <vector>
 #include <cassert>
 #include <ctime>
+#include <chrono>
 
 namespace PathOptimizationNS {
 namespace tk {
@@ -19,6 +20,7 @@ class spline;
 namespace PathOptimizationNS {
 
 class State;
+class Tangent;
 
 // Set angle to -pi ~ pi
 template<typename T>
@@ -44,6 +46,13 @@ double time_ms(const clock_t &begin, const clock_t &end);
 void time_s_out(const clock_t &begin, const clock_t &end, const std::string &text);
 void time_ms_out(const clock_t &begin, const clock_t &end, const std::string &text);
 
+// Wall-clock versions. std::clock() measures process CPU time, which is wrong once
+// anything runs in parallel.
+typedef std::chrono::steady_clock::time_point TimePoint;
+double time_s(const TimePoint &begin, const TimePoint &end);
+double time_ms(const TimePoint &begin, const TimePoint &end);
+void time_ms_out(const TimePoint &begin, const TimePoint &end, const std::string &text);
+
 // Return true if a == b.
 bool isEqual(double a, double b);
 
@@ -53,11 +62,19 @@ double getHeading(const tk::spline &xs, const tk::spline &ys, double s);
 // Calculate curvature for spline.
 double getCurvature(const tk::spline &xs, const tk::spline &ys, double tmp_s);
 
+// Unit tangent of the spline, normalized from the first derivatives, without a heading round trip.
+Tangent getTangent(const tk::spline &xs, const tk::spline &ys, double s);
+
+// Unit tangent of a heading.
+Tangent getTangent(double heading);
+
 // Calculate distance between two points.
 double distance(const State &p1, const State &p2);
 
 // Coordinate transform.
 State local2Global(const State &reference, const State &target);
+// Same, with the tangent of reference.z already known, e.g. for several targets around one reference.
+State local2Global(const State &reference, const Tangent &tangent, const State &target);
 State global2Local(const State &reference, const State &target);
 
 State findClosestPoint(const tk::spline &xs,
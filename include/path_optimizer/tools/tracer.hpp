@@ -0,0 +1,86 @@
+#ifndef PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_TRACER_HPP_
+#define PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_TRACER_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "path_optimizer/config/planning_flags.hpp"
+
+namespace PathOptimizationNS {
+
+// Collects wall-clock spans (steady_clock, per thread) and dumps them in the Chrome trace-event
+// format, which can be opened in chrome://tracing or ui.perfetto.dev.
+// Recording is controlled by FLAGS_enable_tracing; a disabled span costs one flag load.
+class Tracer {
+ public:
+    static Tracer &instance();
+    Tracer(const Tracer &tracer) = delete;
+    Tracer &operator=(const Tracer &tracer) = delete;
+
+    static bool isEnabled() {
+        return FLAGS_enable_tracing;
+    }
+    // Nanoseconds on the steady clock.
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    // Small sequential id of the calling thread, stable for the thread's lifetime.
+    static int threadId();
+
+    void record(const char *name, const char *category, int64_t begin_ns, int64_t end_ns);
+    // Write all recorded spans as Chrome trace-event JSON.
+    bool dumpChromeTrace(const std::string &file) const;
+    void clear();
+    std::size_t size() const;
+
+ private:
+    Tracer() = default;
+    struct Event {
+        const char *name;
+        const char *category;
+        int64_t begin_ns;
+        int64_t end_ns;
+        int tid;
+    };
+    mutable std::mutex mutex_;
+    std::vector<Event> events_;
+    std::size_t dropped_{0};
+};
+
+// Records the lifetime of a scope as one span. Name and category must be string literals
+// (or otherwise outlive the tracer), they are stored by pointer.
+class ScopedSpan {
+ public:
+    explicit ScopedSpan(const char *name, const char *category = "planning") :
+        name_(name),
+        category_(category),
+        begin_ns_(Tracer::isEnabled() ? Tracer::now() : -1) {}
+    ~ScopedSpan() {
+        stop();
+    }
+    // Close the span before the end of the scope. Later calls do nothing.
+    void stop() {
+        if (begin_ns_ >= 0) Tracer::instance().record(name_, category_, begin_ns_, Tracer::now());
+        begin_ns_ = -1;
+    }
+    ScopedSpan(const ScopedSpan &span) = delete;
+    ScopedSpan &operator=(const ScopedSpan &span) = delete;
+
+ private:
+    const char *name_;
+    const char *category_;
+    int64_t begin_ns_;
+};
+
+}
+
+#define PATH_OPTIMIZER_TRACE_CONCAT_INNER(a, b) a##b
+#define PATH_OPTIMIZER_TRACE_CONCAT(a, b) PATH_OPTIMIZER_TRACE_CONCAT_INNER(a, b)
+// Trace the enclosing scope, e.g. TRACE_SCOPE("updateBounds") or TRACE_SCOPE("osqp", "qp").
+#define TRACE_SCOPE(...) \
+    ::PathOptimizationNS::ScopedSpan PATH_OPTIMIZER_TRACE_CONCAT(trace_span_, __LINE__)(__VA_ARGS__)
+
+#endif //PATH_OPTIMIZER_INCLUDE_PATH_OPTIMIZER_TOOLS_TRACER_HPP_
@@ -3,6 +3,8 @@
 //
 #include <gflags/gflags.h>
 #include <cmath>
+#include <cstdlib>
+#include <sstream>
 #include "path_optimizer/config/planning_flags.hpp"
 
 void updateConfig() {
@@ -74,6 +76,35 @@ DEFINE_double(cartesian_deviation_weight, 0.0, "");
 
 DEFINE_bool(enable_simple_boundary_decision, true, "faster, but may go wrong sometimes");
 
+DEFINE_int32(distance_layer_bits, 0, "0 queries the float distance layer of the grid map, 8 or 16 a "
+                                     "fixed-point copy clamped to quantized_max_distance, made once per Map");
+bool ValidateDistanceLayerBits(const char *flagname, int32_t value)
+{
+    return value == 0 || value == 8 || value == 16;
+}
+bool isDistanceLayerBitsValid = google::RegisterFlagValidator(&FLAGS_distance_layer_bits, ValidateDistanceLayerBits);
+
+DEFINE_double(quantized_max_distance, 8.0, "larger distances are clamped in the fixed-point distance layer");
+
+DEFINE_string(distance_layer_layout, "column_major", "memory order of the distance layer queried by Map: "
+                                                     "column_major (the grid map itself), tiled (8x8 tiles) "
+                                                     "or morton (Z-order in 64x64 tiles)");
+bool ValidateDistanceLayerLayout(const char *flagname, const std::string &value)
+{
+    return value == "column_major" || value == "tiled" || value == "morton";
+}
+bool isDistanceLayerLayoutValid =
+    google::RegisterFlagValidator(&FLAGS_distance_layer_layout, ValidateDistanceLayerLayout);
+
+DEFINE_int32(distance_pyramid_levels, 0, "min-pooled levels (4x coarser each) built per Map, so clearance "
+                                         "far from obstacles is proven with one coarse lookup, 0 to disable");
+bool ValidateDistancePyramidLevels(const char *flagname, int32_t value)
+{
+    return value >= 0 && value <= 4;
+}
+bool isDistancePyramidLevelsValid =
+    google::RegisterFlagValidator(&FLAGS_distance_pyramid_levels, ValidateDistancePyramidLevels);
+
 DEFINE_double(search_obstacle_cost, 0.4, "searching cost");
 
 DEFINE_double(search_deviation_cost, 0.4, "offset from the original ref cost");
@@ -83,13 +114,52 @@ DEFINE_double(search_deviation_cost, 0.4, "offset from the original ref cost");
 /////
 DEFINE_string(optimization_method, "KP", "optimization method, named by input: "
                                          "K uses curvature as input, KP uses curvature' as input, and"
-                                         "KCP uses curvarure' and apply some constraints on it");
+                                         "KPC uses curvarure' and apply some constraints on it");
 bool ValidateOptimizationMethod(const char *flagname, const std::string &value)
 {
-    return value == "K" || value == "KP" || value == "KCP";
+    return value == "K" || value == "KP" || value == "KPC";
 }
 bool isOptimizationMethodValid = google::RegisterFlagValidator(&FLAGS_optimization_method, ValidateOptimizationMethod);
 
+DEFINE_string(solver_portfolio, "", "comma-separated optimization methods, e.g. K,KP,KPC, solved in parallel "
+                                    "instead of optimization_method; the first feasible solution wins");
+bool ValidateSolverPortfolio(const char *flagname, const std::string &value)
+{
+    std::stringstream list(value);
+    std::string method;
+    while (std::getline(list, method, ',')) {
+        if (!ValidateOptimizationMethod(flagname, method)) return false;
+    }
+    return true;
+}
+bool isSolverPortfolioValid = google::RegisterFlagValidator(&FLAGS_solver_portfolio, ValidateSolverPortfolio);
+
+DEFINE_double(portfolio_wait_ms, 0, "after the first feasible solution of the portfolio, wait this long for the "
+                                    "others and take the smoothest path, 0 takes the first");
+bool ValidatePortfolioWaitMs(const char *flagname, double value)
+{
+    return value >= 0;
+}
+bool isPortfolioWaitMsValid = google::RegisterFlagValidator(&FLAGS_portfolio_wait_ms, ValidatePortfolioWaitMs);
+
+DEFINE_string(qp_horizon_buckets, "", "comma-separated increasing QP horizons, e.g. 60,80,100,130,160,200; the "
+                                      "horizon is padded to the smallest one that holds it, so that consecutive "
+                                      "solves reuse the OSQP workspace. Empty for no padding");
+bool ValidateQpHorizonBuckets(const char *flagname, const std::string &value)
+{
+    std::stringstream list(value);
+    std::string bucket;
+    long last = 1;
+    while (std::getline(list, bucket, ',')) {
+        char *end = nullptr;
+        const long size = std::strtol(bucket.c_str(), &end, 10);
+        if (bucket.empty() || *end != '\0' || size <= last) return false;
+        last = size;
+    }
+    return true;
+}
+bool isQpHorizonBucketsValid = google::RegisterFlagValidator(&FLAGS_qp_horizon_buckets, ValidateQpHorizonBuckets);
+
 DEFINE_double(K_curvature_weight, 50, "curvature weight of solver K");
 
 DEFINE_double(K_curvature_rate_weight, 200, "curvature rate weight of solver K");
@@ -121,9 +191,48 @@ DEFINE_double(output_spacing, 0.3, "output interval");
 
 DEFINE_bool(enable_computation_time_output, true, "output details on screen");
 
+DEFINE_bool(enable_debug_output,
+            false,
+            "fill SolveResult::debug with the smoothed path, search result and abnormal bounds");
+
 DEFINE_bool(enable_collision_check, true, "perform collision check before output");
 
 DEFINE_double(epsilon, 1e-6, "use this when comparing double");
 
 DEFINE_bool(enable_dynamic_segmentation, true, "dense segmentation when the curvature is large.");
+
+DEFINE_bool(enable_tracing, false, "record wall-clock spans of each planning stage");
+
+DEFINE_string(trace_file, "", "if not empty, demos and benchmarks dump the Chrome trace here on exit");
+
+DEFINE_int32(trace_max_events, 1000000, "spans recorded after this are dropped");
+
+DEFINE_string(metrics_file, "", "if not empty, metrics are written here in Prometheus text format");
+
+DEFINE_double(metrics_dump_interval, 1.0, "min interval between two metrics dumps, in seconds");
+
+DEFINE_int32(planning_arena_kb, 256, "first block of the per-solve scratch arena; search and bound "
+                                     "containers are bump-allocated from it, 0 puts them on the heap");
+bool ValidatePlanningArenaKb(const char *flagname, int32_t value)
+{
+    return value >= 0;
+}
+bool isPlanningArenaKbValid = google::RegisterFlagValidator(&FLAGS_planning_arena_kb, ValidatePlanningArenaKb);
+
+DEFINE_double(time_budget_ms, 0, "hard time budget of one solve, split across the stages; the search spacing "
+                                 "and iteration caps adapt to it and the output is densified, 0 to disable");
+bool ValidateTimeBudgetMs(const char *flagname, double value)
+{
+    return value >= 0;
+}
+bool isTimeBudgetMsValid = google::RegisterFlagValidator(&FLAGS_time_budget_ms, ValidateTimeBudgetMs);
+
+DEFINE_double(pipeline_max_start_error, 0.5, "a reference smoothed ahead by solvePipelined is used only if the "
+                                             "start state is this close to the predicted one, in meters");
+bool ValidatePipelineMaxStartError(const char *flagname, double value)
+{
+    return value >= 0;
+}
+bool isPipelineMaxStartErrorValid =
+    google::RegisterFlagValidator(&FLAGS_pipeline_max_start_error, ValidatePipelineMaxStartError);
 /////
\ No newline at end of file
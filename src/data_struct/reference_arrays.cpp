@@ -0,0 +1,77 @@
+#include <initializer_list>
+#include "path_optimizer/data_struct/reference_arrays.hpp"
+
+namespace PathOptimizationNS {
+
+void ReferenceStateArrays::clear() {
+    truncate(0);
+}
+
+void ReferenceStateArrays::reserve(std::size_t n) {
+    for (auto *array : {&x_, &y_, &heading_, &k_, &s_, &v_, &a_}) array->reserve(n);
+    tangents_.reserve(n);
+}
+
+void ReferenceStateArrays::push_back(const State &state, const Tangent &tangent) {
+    x_.push_back(state.x);
+    y_.push_back(state.y);
+    heading_.push_back(state.z);
+    k_.push_back(state.k);
+    s_.push_back(state.s);
+    v_.push_back(state.v);
+    a_.push_back(state.a);
+    tangents_.push_back(tangent);
+}
+
+void ReferenceStateArrays::truncate(std::size_t n) {
+    if (n >= size()) return;
+    for (auto *array : {&x_, &y_, &heading_, &k_, &s_, &v_, &a_}) array->resize(n);
+    tangents_.resize(n);
+}
+
+std::vector<State> ReferenceStateArrays::states() const {
+    std::vector<State> states;
+    states.reserve(size());
+    for (std::size_t i = 0; i != size(); ++i) {
+        states.emplace_back(x_[i], y_[i], heading_[i], k_[i], s_[i], v_[i], a_[i]);
+    }
+    return states;
+}
+
+void CircleBoundArrays::clear() {
+    for (int circle = 0; circle != kCircles; ++circle) {
+        lb_[circle].clear();
+        ub_[circle].clear();
+    }
+}
+
+void CircleBoundArrays::reserve(std::size_t n) {
+    for (int circle = 0; circle != kCircles; ++circle) {
+        lb_[circle].reserve(n);
+        ub_[circle].reserve(n);
+    }
+}
+
+void CircleBoundArrays::push_back(const CoveringCircleBounds &bounds) {
+    const CoveringCircleBounds::SingleCircleBounds *circles[kCircles] = {&bounds.c0, &bounds.c1, &bounds.c2,
+                                                                         &bounds.c3};
+    for (int circle = 0; circle != kCircles; ++circle) {
+        lb_[circle].push_back(circles[circle]->lb);
+        ub_[circle].push_back(circles[circle]->ub);
+    }
+}
+
+std::vector<CoveringCircleBounds> CircleBoundArrays::bounds() const {
+    std::vector<CoveringCircleBounds> bounds(size());
+    for (std::size_t i = 0; i != size(); ++i) {
+        CoveringCircleBounds::SingleCircleBounds *circles[kCircles] = {&bounds[i].c0, &bounds[i].c1, &bounds[i].c2,
+                                                                       &bounds[i].c3};
+        for (int circle = 0; circle != kCircles; ++circle) {
+            circles[circle]->lb = lb_[circle][i];
+            circles[circle]->ub = ub_[circle][i];
+        }
+    }
+    return bounds;
+}
+
+}
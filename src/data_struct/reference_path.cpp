@@ -34,6 +34,10 @@ void ReferencePath::clear() {
     reference_path_impl_->clear();
 }
 
+void ReferencePath::swap(ReferencePath &other) {
+    reference_path_impl_.swap(other.reference_path_impl_);
+}
+
 std::size_t ReferencePath::getSize() const {
     return reference_path_impl_->getSize();
 }
@@ -46,14 +50,26 @@ void ReferencePath::setLength(double s) {
     reference_path_impl_->setLength(s);
 }
 
-const std::vector<State> &ReferencePath::getReferenceStates() const {
+std::vector<State> ReferencePath::getReferenceStates() const {
     return reference_path_impl_->getReferenceStates();
 }
 
-const std::vector<CoveringCircleBounds> &ReferencePath::getBounds() const {
+const std::vector<Tangent> &ReferencePath::getTangents() const {
+    return reference_path_impl_->getTangents();
+}
+
+std::vector<CoveringCircleBounds> ReferencePath::getBounds() const {
     return reference_path_impl_->getBounds();
 }
 
+const ReferenceStateArrays &ReferencePath::getReferenceArrays() const {
+    return reference_path_impl_->getReferenceArrays();
+}
+
+const CircleBoundArrays &ReferencePath::getBoundArrays() const {
+    return reference_path_impl_->getBoundArrays();
+}
+
 const std::vector<double> &ReferencePath::getMaxKList() const {
     return reference_path_impl_->getMaxKList();
 }
@@ -74,8 +90,8 @@ void ReferencePath::setReference(const std::vector<PathOptimizationNS::State> &&
     reference_path_impl_->setReference(reference);
 }
 
-void ReferencePath::updateBounds(const Map &map) {
-    reference_path_impl_->updateBounds(map);
+bool ReferencePath::updateBounds(const Map &map) {
+    return reference_path_impl_->updateBounds(map);
 }
 
 void ReferencePath::updateLimits() {
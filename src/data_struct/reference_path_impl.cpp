@@ -7,6 +7,10 @@
 #include <path_optimizer/tools/Map.hpp>
 #include "path_optimizer/tools/tools.hpp"
 #include "path_optimizer/tools/spline.h"
+#include "path_optimizer/tools/tracer.hpp"
+#include "path_optimizer/tools/metrics.hpp"
+#include "path_optimizer/tools/arena.hpp"
+#include "path_optimizer/tools/deadline.hpp"
 #include "path_optimizer/data_struct/data_struct.hpp"
 #include "path_optimizer/config/planning_flags.hpp"
 
@@ -61,22 +65,33 @@ const tk::spline &ReferencePathImpl::getOriginalYS() const {
 
 void ReferencePathImpl::setReference(const std::vector<State> &reference) {
     DLOG(INFO) << "left reference version";
-    reference_states_ = reference;
+    assignStates(reference);
     use_spline_ = false;
 }
 
 void ReferencePathImpl::setReference(const std::vector<PathOptimizationNS::State> &&reference) {
     DLOG(INFO) << "right reference version";
-    reference_states_ = reference;
+    assignStates(reference);
     use_spline_ = false;
 }
 
+void ReferencePathImpl::assignStates(const std::vector<State> &reference) {
+    reference_states_.clear();
+    reference_states_.reserve(reference.size());
+    for (const auto &state : reference) {
+        reference_states_.push_back(state, getTangent(state.z));
+    }
+}
+
 void ReferencePathImpl::clear() {
     max_s_ = 0;
     reference_states_.clear();
     bounds_.clear();
     max_k_list_.clear();
     max_kp_list_.clear();
+    // The search result and abnormal bounds of the last solve.
+    is_original_spline_set = false;
+    display_set_.clear();
 }
 
 std::size_t ReferencePathImpl::getSize() const {
@@ -86,7 +101,7 @@ std::size_t ReferencePathImpl::getSize() const {
 bool ReferencePathImpl::trimStates() {
     if (bounds_.empty() || reference_states_.empty() || bounds_.size() >= reference_states_.size())
         return false;
-    reference_states_.resize(bounds_.size());
+    reference_states_.truncate(bounds_.size());
     return true;
 }
 
@@ -98,11 +113,23 @@ void ReferencePathImpl::setLength(double s) {
     max_s_ = s;
 }
 
-const std::vector<State> &ReferencePathImpl::getReferenceStates() const {
+std::vector<State> ReferencePathImpl::getReferenceStates() const {
+    return reference_states_.states();
+}
+
+const std::vector<Tangent> &ReferencePathImpl::getTangents() const {
+    return reference_states_.tangents();
+}
+
+std::vector<CoveringCircleBounds> ReferencePathImpl::getBounds() const {
+    return bounds_.bounds();
+}
+
+const ReferenceStateArrays &ReferencePathImpl::getReferenceArrays() const {
     return reference_states_;
 }
 
-const std::vector<CoveringCircleBounds> &ReferencePathImpl::getBounds() const {
+const CircleBoundArrays &ReferencePathImpl::getBoundArrays() const {
     return bounds_;
 }
 
@@ -123,11 +150,6 @@ void ReferencePathImpl::updateLimits() {
         LOG(WARNING) << "Empty reference, updateLimits() fail!";
         return;
     }
-    if (FLAGS_optimization_method != "KPC") {
-        // curvature and curvature rate can only be limited in KPC method.
-        LOG(INFO) << "Solver is K or KP; skip updateLimits().";
-        return;
-    }
     max_k_list_.clear();
     max_kp_list_.clear();
     if (use_spline_) {
@@ -139,10 +161,12 @@ void ReferencePathImpl::updateLimits() {
         }
         return;
     }
+    const auto &v = reference_states_.v();
+    const auto &a = reference_states_.a();
     for (size_t i = 0; i != reference_states_.size(); ++i) {
         // Friction circle limit.
-        double ref_v = reference_states_.at(i).v;
-        double ref_ax = reference_states_.at(i).a;
+        double ref_v = v[i];
+        double ref_ax = a[i];
         double ay_allowed = sqrt(pow(FLAGS_mu * 9.8, 2) - pow(ref_ax, 2));
         if (ref_v > 0.0001) max_k_list_.emplace_back(ay_allowed / pow(ref_v, 2));
         else max_k_list_.emplace_back(DBL_MAX);
@@ -153,60 +177,81 @@ void ReferencePathImpl::updateLimits() {
     LOG(INFO) << "K and KP constraints are updated according to v and a.";
 }
 
-void ReferencePathImpl::updateBounds(const Map &map) {
+bool ReferencePathImpl::updateBounds(const Map &map) {
+    TRACE_SCOPE("ReferencePath::updateBounds");
+    ScopedLatency latency(stageLatency(PlanningStage::BOUNDS));
     if (reference_states_.empty()) {
         LOG(WARNING) << "Empty reference, updateBounds fail!";
-        return;
+        return true;
     }
     bounds_.clear();
-    for (const auto &state : reference_states_) {
-        // Circle centers.
-        State
-            c0(state.x + FLAGS_d1 * cos(state.z),
-               state.y + FLAGS_d1 * sin(state.z),
-               state.z),
-            c1(state.x + FLAGS_d2 * cos(state.z),
-               state.y + FLAGS_d2 * sin(state.z),
-               state.z),
-            c2(state.x + FLAGS_d3 * cos(state.z),
-               state.y + FLAGS_d3 * sin(state.z),
-               state.z),
-            c3(state.x + FLAGS_d4 * cos(state.z),
-               state.y + FLAGS_d4 * sin(state.z),
-               state.z);
+    const size_t size = reference_states_.size();
+    bounds_.reserve(size);
+    // Circle centers, one array per circle, in a pass over the contiguous x, y and tangent arrays.
+    const auto &xs = reference_states_.x();
+    const auto &ys = reference_states_.y();
+    const auto &headings = reference_states_.heading();
+    const auto &tangents = reference_states_.tangents();
+    const double center_offsets[CircleBoundArrays::kCircles] = {FLAGS_d1, FLAGS_d2, FLAGS_d3, FLAGS_d4};
+    ArenaVector<double> center_x[CircleBoundArrays::kCircles], center_y[CircleBoundArrays::kCircles];
+    for (int c = 0; c != CircleBoundArrays::kCircles; ++c) {
+        center_x[c].resize(size);
+        center_y[c].resize(size);
+        const double offset = center_offsets[c];
+        for (size_t i = 0; i != size; ++i) {
+            center_x[c][i] = xs[i] + offset * tangents[i].x;
+            center_y[c][i] = ys[i] + offset * tangents[i].y;
+        }
+    }
+    bool path_blocked = false;
+    for (size_t i = 0; i != size; ++i) {
+        if (Deadline::currentExpired()) {
+            LOG(WARNING) << "Bound search stopped by the deadline at s: " << reference_states_.s()[i];
+            break;
+        }
         // Calculate boundaries.
-        auto clearance_0 = getClearanceWithDirectionStrict(c0, map);
-        auto clearance_1 = getClearanceWithDirectionStrict(c1, map);
-        auto clearance_2 = getClearanceWithDirectionStrict(c2, map);
-        auto clearance_3 = getClearanceWithDirectionStrict(c3, map);
-        if (clearance_0[0] == clearance_0[1] ||
-            clearance_1[0] == clearance_1[1] ||
-            clearance_2[0] == clearance_2[1] ||
-            clearance_3[0] == clearance_3[1]) {
-            LOG(INFO) << "Path is blocked at s: " << state.s;
-            return;
+        std::array<double, 2> clearance[CircleBoundArrays::kCircles];
+        bool blocked = false;
+        for (int c = 0; c != CircleBoundArrays::kCircles; ++c) {
+            clearance[c] = getClearanceWithDirectionStrict(State(center_x[c][i], center_y[c][i], headings[i]),
+                                                           tangents[i], map);
+            blocked |= clearance[c][0] == clearance[c][1];
+        }
+        if (blocked) {
+            LOG(INFO) << "Path is blocked at s: " << reference_states_.s()[i];
+            countFailure(FailureReason::PATH_BLOCKED);
+            path_blocked = true;
+            break;
         }
         CoveringCircleBounds covering_circle_bounds;
-        covering_circle_bounds.c0 = clearance_0;
-        covering_circle_bounds.c1 = clearance_1;
-        covering_circle_bounds.c2 = clearance_2;
-        covering_circle_bounds.c3 = clearance_3;
-        bounds_.emplace_back(covering_circle_bounds);
-    }
-    if (reference_states_.size() != bounds_.size()) {
-        reference_states_.resize(bounds_.size());
+        covering_circle_bounds.c0 = clearance[0];
+        covering_circle_bounds.c1 = clearance[1];
+        covering_circle_bounds.c2 = clearance[2];
+        covering_circle_bounds.c3 = clearance[3];
+        bounds_.push_back(covering_circle_bounds);
     }
+    // The states end where the bounds do, also on a blocked path.
+    reference_states_.truncate(bounds_.size());
+    if (path_blocked) return false;
     LOG(INFO) << "Boundary updated.";
+    return true;
 }
 
-std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const PathOptimizationNS::State &state,
-                                                                       const PathOptimizationNS::Map &map) {
+std::array<double, 2> ReferencePathImpl::getClearanceWithDirectionStrict(const PathOptimizationNS::State &state,
+                                                                         const PathOptimizationNS::Map &map) {
+    return getClearanceWithDirectionStrict(state, getTangent(state.z), map);
+}
+
+std::array<double, 2> ReferencePathImpl::getClearanceWithDirectionStrict(const PathOptimizationNS::State &state,
+                                                                         const PathOptimizationNS::Tangent &tangent,
+                                                                         const PathOptimizationNS::Map &map) {
     // TODO: too much repeated code!
     double left_bound = 0;
     double right_bound = 0;
     double delta_s = 0.5;
-    double left_angle = constraintAngle(state.z + M_PI_2);
-    double right_angle = constraintAngle(state.z - M_PI_2);
+    // Unit normals to the left and right.
+    const double left_x = -tangent.y, left_y = tangent.x;
+    const double right_x = tangent.y, right_y = -tangent.x;
 
     auto n = static_cast<size_t >(5.0 / delta_s);
     // Check if the original position is collision free.
@@ -217,27 +262,58 @@ std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const Pat
         double right_s = 0;
         for (size_t j = 0; j != n; ++j) {
             right_s += delta_s;
-            double x = state.x + right_s * cos(right_angle);
-            double y = state.y + right_s * sin(right_angle);
+            double x = state.x + right_s * right_x;
+            double y = state.y + right_s * right_y;
             grid_map::Position new_position(x, y);
-            double clearance = map.getObstacleDistance(new_position);
-            if (clearance < FLAGS_circle_radius) {
+            if (!map.isClear(new_position, FLAGS_circle_radius)) {
                 break;
             }
         }
         double left_s = 0;
         for (size_t j = 0; j != n; ++j) {
             left_s += delta_s;
-            double x = state.x + left_s * cos(left_angle);
-            double y = state.y + left_s * sin(left_angle);
+            double x = state.x + left_s * left_x;
+            double y = state.y + left_s * left_y;
             grid_map::Position new_position(x, y);
-            double clearance = map.getObstacleDistance(new_position);
-            if (clearance < FLAGS_circle_radius) {
+            if (!map.isClear(new_position, FLAGS_circle_radius)) {
                 break;
             }
         }
         right_bound = -(right_s - delta_s);
         left_bound = left_s - delta_s;
+    } else if (map.hasSignedDistance()) {
+        // Collision already; the signed distance gradient gives the side to expand to and how far
+        // the free space is, without sampling both sides.
+        DLOG(INFO) << "Using the signed distance gradient to determine the direction to expand.";
+        const auto gradient = map.getDistanceGradient(original_position);
+        const double left_slope = gradient.x() * left_x + gradient.y() * left_y;
+        const bool to_left = left_slope >= 0;
+        const double dx = to_left ? left_x : right_x, dy = to_left ? left_y : right_y;
+        // The field rises at most 1 m per m; a flat gradient would give an absurd jump.
+        const double slope = std::max(std::fabs(left_slope), 0.5);
+        double s = std::min(5.0, (FLAGS_circle_radius - map.getSignedDistance(original_position)) / slope);
+        auto clearance_at = [&](double distance) {
+            return map.getObstacleDistance(grid_map::Position(state.x + distance * dx, state.y + distance * dy));
+        };
+        // The estimate assumes a constant slope, step on until the circle is really free.
+        for (size_t j = 0; j != n && clearance_at(s) <= FLAGS_circle_radius; ++j) {
+            s += delta_s;
+        }
+        const double free_s = s;
+        for (size_t j = 0; j != n; ++j) {
+            s += delta_s;
+            if (clearance_at(s) < FLAGS_circle_radius) {
+                break;
+            }
+        }
+        if (to_left) {
+            right_bound = free_s;
+            left_bound = s - delta_s;
+        } else {
+            left_bound = -free_s;
+            right_bound = -(s - delta_s);
+        }
+        DLOG(INFO) << left_bound << ", " << right_bound;
     } else if (is_original_spline_set && use_spline_ && !FLAGS_enable_simple_boundary_decision) {
         DLOG(INFO) << "Using relative position to determine the direction to expand.";
         // Use position to determine the direction.
@@ -255,8 +331,8 @@ std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const Pat
             double right_s = 0;
             for (int j = 0; j != n; ++j) {
                 right_s += delta_s;
-                double x = state.x + right_s * cos(right_angle);
-                double y = state.y + right_s * sin(right_angle);
+                double x = state.x + right_s * right_x;
+                double y = state.y + right_s * right_y;
                 grid_map::Position new_position(x, y);
                 double clearance = map.getObstacleDistance(new_position);
                 if (clearance > FLAGS_circle_radius) {
@@ -266,11 +342,10 @@ std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const Pat
             left_bound = -right_s;
             for (int j = 0; j != n; ++j) {
                 right_s += delta_s;
-                double x = state.x + right_s * cos(right_angle);
-                double y = state.y + right_s * sin(right_angle);
+                double x = state.x + right_s * right_x;
+                double y = state.y + right_s * right_y;
                 grid_map::Position new_position(x, y);
-                double clearance = map.getObstacleDistance(new_position);
-                if (clearance < FLAGS_circle_radius) {
+                if (!map.isClear(new_position, FLAGS_circle_radius)) {
                     break;
                 }
             }
@@ -281,8 +356,8 @@ std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const Pat
             double left_s = 0;
             for (int j = 0; j != n; ++j) {
                 left_s += delta_s;
-                double x = state.x + left_s * cos(left_angle);
-                double y = state.y + left_s * sin(left_angle);
+                double x = state.x + left_s * left_x;
+                double y = state.y + left_s * left_y;
                 grid_map::Position new_position(x, y);
                 double clearance = map.getObstacleDistance(new_position);
                 if (clearance > FLAGS_circle_radius) {
@@ -292,11 +367,10 @@ std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const Pat
             right_bound = left_s;
             for (int j = 0; j != n; ++j) {
                 left_s += delta_s;
-                double x = state.x + left_s * cos(left_angle);
-                double y = state.y + left_s * sin(left_angle);
+                double x = state.x + left_s * left_x;
+                double y = state.y + left_s * left_y;
                 grid_map::Position new_position(x, y);
-                double clearance = map.getObstacleDistance(new_position);
-                if (clearance < FLAGS_circle_radius) {
+                if (!map.isClear(new_position, FLAGS_circle_radius)) {
                     break;
                 }
             }
@@ -309,8 +383,8 @@ std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const Pat
         double right_s = 0;
         for (size_t j = 0; j != n; ++j) {
             right_s += delta_s;
-            double x = state.x + right_s * cos(right_angle);
-            double y = state.y + right_s * sin(right_angle);
+            double x = state.x + right_s * right_x;
+            double y = state.y + right_s * right_y;
             grid_map::Position new_position(x, y);
             double clearance = map.getObstacleDistance(new_position);
             if (clearance > FLAGS_circle_radius) {
@@ -320,8 +394,8 @@ std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const Pat
         double left_s = 0;
         for (size_t j = 0; j != n; ++j) {
             left_s += delta_s;
-            double x = state.x + left_s * cos(left_angle);
-            double y = state.y + left_s * sin(left_angle);
+            double x = state.x + left_s * left_x;
+            double y = state.y + left_s * left_y;
             grid_map::Position new_position(x, y);
             double clearance = map.getObstacleDistance(new_position);
             if (clearance > FLAGS_circle_radius) {
@@ -334,11 +408,10 @@ std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const Pat
             right_bound = left_s;
             for (size_t j = 0; j != n; ++j) {
                 left_s += delta_s;
-                double x = state.x + left_s * cos(left_angle);
-                double y = state.y + left_s * sin(left_angle);
+                double x = state.x + left_s * left_x;
+                double y = state.y + left_s * left_y;
                 grid_map::Position new_position(x, y);
-                double clearance = map.getObstacleDistance(new_position);
-                if (clearance < FLAGS_circle_radius) {
+                if (!map.isClear(new_position, FLAGS_circle_radius)) {
                     break;
                 }
             }
@@ -348,11 +421,10 @@ std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const Pat
             left_bound = -right_s;
             for (size_t j = 0; j != n; ++j) {
                 right_s += delta_s;
-                double x = state.x + right_s * cos(right_angle);
-                double y = state.y + right_s * sin(right_angle);
+                double x = state.x + right_s * right_x;
+                double y = state.y + right_s * right_y;
                 grid_map::Position new_position(x, y);
-                double clearance = map.getObstacleDistance(new_position);
-                if (clearance < FLAGS_circle_radius) {
+                if (!map.isClear(new_position, FLAGS_circle_radius)) {
                     break;
                 }
             }
@@ -364,8 +436,8 @@ std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const Pat
     for (int i = 1; i != static_cast<int>(delta_s / smaller_ds); ++i) {
         left_bound += smaller_ds;
         grid_map::Position position(
-            state.x + left_bound * cos(left_angle),
-            state.y + left_bound * sin(left_angle)
+            state.x + left_bound * left_x,
+            state.y + left_bound * left_y
         );
         if (map.getObstacleDistance(position) < FLAGS_circle_radius) {
             left_bound -= smaller_ds;
@@ -375,8 +447,8 @@ std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const Pat
     for (int i = 1; i != static_cast<int>(delta_s / smaller_ds); ++i) {
         right_bound -= smaller_ds;
         grid_map::Position position(
-            state.x + right_bound * cos(right_angle),
-            state.y + right_bound * sin(right_angle)
+            state.x + right_bound * right_x,
+            state.y + right_bound * right_y
         );
         if (map.getObstacleDistance(position) < FLAGS_circle_radius) {
             right_bound += smaller_ds;
@@ -391,6 +463,7 @@ std::vector<double> ReferencePathImpl::getClearanceWithDirectionStrict(const Pat
 }
 
 bool ReferencePathImpl::buildReferenceFromSpline(double delta_s_smaller, double delta_s_larger) {
+    TRACE_SCOPE("ReferencePath::buildReferenceFromSpline");
     CHECK_LE(delta_s_smaller, delta_s_larger);
     if (!use_spline_ || max_s_ <= 0) {
         LOG(WARNING) << "Cannot build reference line from spline!";
@@ -403,9 +476,15 @@ bool ReferencePathImpl::buildReferenceFromSpline(double delta_s_smaller, double
     while (tmp_s <= max_s_) {
         double x = (*x_s_)(tmp_s);
         double y = (*y_s_)(tmp_s);
-        double h = getHeading(*x_s_, *y_s_, tmp_s);
-        double k = getCurvature(*x_s_, *y_s_, tmp_s);
-        reference_states_.emplace_back(x, y, h, k, tmp_s);
+        // Heading, curvature and tangent from one set of derivatives.
+        const double x_d1 = x_s_->deriv(1, tmp_s), y_d1 = y_s_->deriv(1, tmp_s);
+        const double x_d2 = x_s_->deriv(2, tmp_s), y_d2 = y_s_->deriv(2, tmp_s);
+        const double squared_norm = x_d1 * x_d1 + y_d1 * y_d1;
+        const double norm = sqrt(squared_norm);
+        double h = atan2(y_d1, x_d1);
+        double k = (x_d1 * y_d2 - y_d1 * x_d2) / (squared_norm * norm);
+        reference_states_.push_back(State(x, y, h, k, tmp_s),
+                                    norm > 0 ? Tangent(x_d1 / norm, y_d1 / norm) : Tangent());
         // Use k to decide delta s.
         if (FLAGS_enable_dynamic_segmentation) {
             double k_share = fabs(k) > large_k ? 1 :
@@ -0,0 +1,30 @@
+#include "path_optimizer/data_struct/solve_result.hpp"
+
+namespace PathOptimizationNS {
+
+const char *toString(SolveStatus status) {
+    switch (status) {
+        case SolveStatus::SUCCESS: return "success";
+        case SolveStatus::EMPTY_INPUT: return "empty_input";
+        case SolveStatus::SEARCH_FAILED: return "search_failed";
+        case SolveStatus::SMOOTHING_FAILED: return "smoothing_failed";
+        case SolveStatus::LARGE_HEADING_ERROR: return "heading_error";
+        case SolveStatus::EMPTY_REFERENCE: return "empty_reference";
+        case SolveStatus::PATH_BLOCKED: return "path_blocked";
+        case SolveStatus::QP_FAILED: return "qp_failed";
+        case SolveStatus::COLLISION: return "collision";
+        case SolveStatus::DEADLINE_EXCEEDED: return "deadline_exceeded";
+        default: return "unknown";
+    }
+}
+
+const char *toString(SolveQuality quality) {
+    switch (quality) {
+        case SolveQuality::FULL: return "full";
+        case SolveQuality::COARSE: return "coarse";
+        case SolveQuality::COARSEST: return "coarsest";
+        default: return "unknown";
+    }
+}
+
+}
@@ -1,9 +1,11 @@
 //
 // Created by ljn on 19-8-16.
 //
+#include <algorithm>
 #include <iostream>
 #include <cmath>
-#include <ctime>
+#include <chrono>
+#include <sstream>
 #include "path_optimizer/path_optimizer.hpp"
 #include "path_optimizer/reference_path_smoother/reference_path_smoother.hpp"
 #include "path_optimizer/tools/tools.hpp"
@@ -13,6 +15,10 @@
 #include "path_optimizer/tools/collosion_checker.hpp"
 #include "path_optimizer/tools/Map.hpp"
 #include "path_optimizer/tools/spline.h"
+#include "path_optimizer/tools/tracer.hpp"
+#include "path_optimizer/tools/metrics.hpp"
+#include "path_optimizer/tools/arena.hpp"
+#include "path_optimizer/tools/deadline.hpp"
 #include "path_optimizer/solver/solver.hpp"
 #include "tinyspline_ros/tinysplinecpp.h"
 #include "path_optimizer/reference_path_smoother/angle_diff_smoother.hpp"
@@ -20,57 +26,224 @@
 
 namespace PathOptimizationNS {
 
+namespace {
+// Under FLAGS_time_budget_ms, each stage has to be done by its share of the budget, counted from the
+// start of the solve, so time left over by a stage goes to the next ones.
+const double kSmoothingBudgetEnd = 0.45;
+const double kSegmentationBudgetEnd = 0.6;
+const double kOptimizationBudgetEnd = 0.9;
+// Indexed by SolveQuality. 0 iterations means the solver default.
+const double kSearchSpacingScale[] = {1, 2, 4};
+const int kSmootherMaxIterations[] = {0, 200, 50};
+const int kQpMaxIterations[] = {0, 1000, 250};
+// A budgeted solve that uses more than this share of the budget makes the next one coarser, one
+// that uses less than the lower share makes it finer.
+const double kCoarserAbove = 0.8;
+const double kFinerBelow = 0.3;
+// Largest heading difference between the predicted and the actual start state for which a reference
+// smoothed ahead is used.
+const double kPipelineMaxHeadingError = 10 * M_PI / 180;
+// While waiting for the pipeline, the solve is checked for cancellation this often.
+const std::chrono::milliseconds kPipelinePollInterval(2);
+
+// Compares portfolio solutions of different QP formulations, whose objectives are not comparable:
+// squared curvature and squared curvature change along the path.
+double pathCost(const std::vector<State> &path) {
+    double cost = 0;
+    for (size_t i = 1; i < path.size(); ++i) {
+        const double ds = path[i].s - path[i - 1].s;
+        if (ds <= 0) continue;
+        const double dk = path[i].k - path[i - 1].k;
+        cost += path[i].k * path[i].k * ds + dk * dk / ds;
+    }
+    return cost;
+}
+
+// Curvature and curvature rate can only be limited in KPC method, alone or in the portfolio.
+bool curvatureLimited() {
+    if (FLAGS_solver_portfolio.empty()) return FLAGS_optimization_method == "KPC";
+    std::stringstream list(FLAGS_solver_portfolio);
+    std::string type;
+    while (std::getline(list, type, ',')) {
+        if (type == "KPC") return true;
+    }
+    return false;
+}
+
+bool samePositions(const std::vector<State> &a, const std::vector<State> &b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const State &p, const State &q) {
+        return p.x == q.x && p.y == q.y;
+    });
+}
+}
+
 PathOptimizer::PathOptimizer(const State &start_state,
                              const State &end_state,
                              const grid_map::GridMap &map) :
+    PathOptimizer(start_state, end_state, Map{map}) {}
+
+PathOptimizer::PathOptimizer(const State &start_state,
+                             const State &end_state,
+                             const Map &map) :
     grid_map_(new Map{map}),
     collision_checker_(new CollisionChecker{map}),
     reference_path_(new ReferencePath),
-    vehicle_state_(new VehicleState{start_state, end_state, 0, 0}) {
+    vehicle_state_(new VehicleState{start_state, end_state, 0, 0}),
+    arena_(new Arena(static_cast<std::size_t>(std::max(FLAGS_planning_arena_kb, 1)) * 1024)) {
     updateConfig();
 }
 
 PathOptimizer::~PathOptimizer() {
+    if (worker_.joinable()) {
+        // Outstanding solves stop at their next checkpoint and still deliver their fallback results.
+        {
+            std::lock_guard<std::mutex> lock(worker_mutex_);
+            stop_worker_ = true;
+            running_deadline_.cancel();
+            for (auto &job : jobs_) job.deadline.cancel();
+        }
+        worker_cv_.notify_one();
+        worker_.join();
+    }
+    if (pipeline_.valid()) pipeline_.wait();
+    // Before what they refer to.
+    pipeline_smoother_.reset();
+    smoother_.reset();
+    portfolio_solvers_.clear();
+    solver_.reset();
     delete grid_map_;
     delete collision_checker_;
     delete reference_path_;
     delete vehicle_state_;
+    delete arena_;
+}
+
+void PathOptimizer::setStartState(const State &start_state) {
+    vehicle_state_->setStartState(start_state);
+}
+
+void PathOptimizer::setGoal(const State &end_state) {
+    vehicle_state_->setEndState(end_state);
+}
+
+void PathOptimizer::setMap(const grid_map::GridMap &map) {
+    setMap(Map{map});
+}
+
+void PathOptimizer::setMap(const Map &map) {
+    // The pipeline thread reads the map. Its reference would be stale anyway.
+    if (pipeline_.valid()) {
+        pipeline_deadline_.cancel();
+        pipeline_.wait();
+    }
+    ++map_version_;
+    // Assigned in place: the smoother holds a reference to *grid_map_.
+    *grid_map_ = map;
+    collision_checker_->setMap(map);
+}
+
+SolveResult PathOptimizer::solve(const std::vector<State> &reference_points,
+                                 std::vector<State> *final_path,
+                                 const Deadline &deadline) {
+    return solveCycle(reference_points, nullptr, final_path, deadline);
+}
+
+SolveResult PathOptimizer::solvePipelined(const std::vector<State> &reference_points,
+                                          const State &next_start_state,
+                                          std::vector<State> *final_path,
+                                          const Deadline &deadline) {
+    return solveCycle(reference_points, &next_start_state, final_path, deadline);
 }
 
-bool PathOptimizer::solve(const std::vector<State> &reference_points, std::vector<State> *final_path) {
+SolveResult PathOptimizer::solveCycle(const std::vector<State> &reference_points,
+                                      const State *next_start_state,
+                                      std::vector<State> *final_path,
+                                      const Deadline &deadline) {
+    TRACE_SCOPE("PathOptimizer::solve");
+    ScopedLatency latency(stageLatency(PlanningStage::SOLVE));
     if (FLAGS_enable_computation_time_output) std::cout << "------" << std::endl;
     CHECK_NOTNULL(final_path);
+    arena_->reset();
+    ScopedArena scoped_arena(FLAGS_planning_arena_kb > 0 ? arena_ : nullptr);
+    budget_ms_ = FLAGS_time_budget_ms;
+    solve_begin_ = std::chrono::steady_clock::now();
+    solve_deadline_ = deadline;
+    beginStage(kSmoothingBudgetEnd);
+    ScopedDeadline scoped_deadline(&stage_deadline_);
+    reference_smoothed_ = false;
+    // A time budget needs bounded work more than the best path: densified output solves the QP on a
+    // 1 m grid instead of the output spacing.
+    raw_output_ = FLAGS_enable_raw_output && budget_ms_ <= 0;
 
-    auto t1 = std::clock();
+    SolveResult result;
+    if (FLAGS_enable_debug_output) result.debug = std::make_shared<SolveDebugInfo>();
+    if (budget_ms_ > 0) result.quality = quality_;
+    auto t1 = std::chrono::steady_clock::now();
     if (reference_points.empty()) {
         LOG(WARNING) << "Empty input, quit path optimization";
-        return false;
+        countFailure(FailureReason::EMPTY_INPUT);
+        result.status = SolveStatus::EMPTY_INPUT;
+        return finishSolve(t1, &result, final_path);
     }
     reference_path_->clear();
+    if (deadlineExceeded(&result)) return finishSolve(t1, &result, final_path);
 
-    // Smooth reference path.
-    auto reference_path_smoother = ReferencePathSmoother::create(FLAGS_smoothing_method,
-                                                                 reference_points,
-                                                                 vehicle_state_->getStartState(),
-                                                                 *grid_map_);
-    bool smoothing_ok = reference_path_smoother->solve(reference_path_, &smoothed_path_);
-    reference_searching_display_ = reference_path_smoother->display();
+    // Smooth reference path, unless the previous solvePipelined() did.
+    const auto quality_index = static_cast<int>(result.quality);
+    bool smoothing_ok = true;
+    if (takePreparedReference(reference_points)) {
+        result.smoothing_prepared = true;
+    } else {
+        if (!smoother_ || smoother_type_ != FLAGS_smoothing_method) {
+            smoother_ = ReferencePathSmoother::create(FLAGS_smoothing_method,
+                                                      reference_points,
+                                                      vehicle_state_->getStartState(),
+                                                      *grid_map_);
+            smoother_type_ = FLAGS_smoothing_method;
+        } else {
+            smoother_->setInputPoints(reference_points);
+        }
+        smoother_->setSearchLateralSpacing(FLAGS_search_lateral_spacing * kSearchSpacingScale[quality_index]);
+        smoother_->setMaxIterations(kSmootherMaxIterations[quality_index]);
+        smoothing_ok = smoother_->solve(reference_path_, result.debug ? &result.debug->smoothed_path : nullptr);
+        if (result.debug) result.debug->search_result = smoother_->display();
+    }
+    // The next cycle's smoothing overlaps with the rest of this one.
+    if (next_start_state) startPipeline(reference_points, *next_start_state, quality_index);
+    auto t2 = std::chrono::steady_clock::now();
+    result.timings.smoothing_ms = time_ms(t1, t2);
     if (!smoothing_ok) {
+        if (deadlineExceeded(&result)) return finishSolve(t1, &result, final_path);
         LOG(WARNING) << "Path optimization FAILED!";
-        return false;
+        countFailure(FailureReason::SMOOTHING_FAILED);
+        result.status = SolveStatus::SMOOTHING_FAILED;
+        if (smoother_->searchFailed()) {
+            // The raw input the smoother fell back to failed, so the search is what failed the solve.
+            countFailure(FailureReason::SEARCH_FAILED);
+            result.status = SolveStatus::SEARCH_FAILED;
+        }
+        return finishSolve(t1, &result, final_path);
     }
+    reference_smoothed_ = true;
+    if (deadlineExceeded(&result)) return finishSolve(t1, &result, final_path);
+    beginStage(kSegmentationBudgetEnd);
 
-    auto t2 = std::clock();
     // Divide reference path into segments;
-    if (!segmentSmoothedPath()) {
+    if (!segmentSmoothedPath(&result)) {
         LOG(WARNING) << "Path optimization FAILED!";
-        return false;
+        return finishSolve(t1, &result, final_path);
     }
+    // The bounds are cut short when the deadline expires during the bound search.
+    if (deadlineExceeded(&result)) return finishSolve(t1, &result, final_path);
+    beginStage(kOptimizationBudgetEnd);
 
-    auto t3 = std::clock();
+    auto t3 = std::chrono::steady_clock::now();
+    result.timings.segmentation_ms = time_ms(t2, t3);
     // Optimize.
-    if (optimizePath(final_path)) {
-        auto t4 = std::clock();
+    bool optimization_ok = optimizePath(final_path, &result);
+    auto t4 = std::chrono::steady_clock::now();
+    result.timings.output_check_ms = time_ms(t3, t4) - result.timings.optimization_ms;
+    if (optimization_ok) {
         if (FLAGS_enable_computation_time_output) {
             time_ms_out(t1, t2, "Reference smoothing");
             time_ms_out(t2, t3, "Reference segmentation");
@@ -78,48 +251,247 @@ bool PathOptimizer::solve(const std::vector<State> &reference_points, std::vecto
             time_ms_out(t1, t4, "All");
         }
         LOG(INFO) << "Path optimization SUCCEEDED! Total time cost: " << time_s(t1, t4) << " s";
-        return true;
     } else {
         LOG(WARNING) << "Path optimization FAILED!";
+    }
+    return finishSolve(t1, &result, final_path);
+}
+
+void PathOptimizer::startPipeline(const std::vector<State> &reference_points,
+                                  const State &next_start_state,
+                                  int quality_index) {
+    if (pipeline_.valid()) pipeline_.wait();
+    pipeline_points_ = reference_points;
+    pipeline_start_state_ = next_start_state;
+    pipeline_map_version_ = map_version_;
+    if (!pipeline_reference_) pipeline_reference_.reset(new ReferencePath);
+    if (!pipeline_arena_) {
+        pipeline_arena_.reset(new Arena(static_cast<std::size_t>(std::max(FLAGS_planning_arena_kb, 1)) * 1024));
+    }
+    if (!pipeline_smoother_ || pipeline_smoother_type_ != FLAGS_smoothing_method) {
+        pipeline_smoother_ = ReferencePathSmoother::create(FLAGS_smoothing_method,
+                                                           pipeline_points_,
+                                                           pipeline_start_state_,
+                                                           *grid_map_);
+        pipeline_smoother_type_ = FLAGS_smoothing_method;
+    } else {
+        pipeline_smoother_->setInputPoints(pipeline_points_);
+    }
+    if (!pipeline_smoother_) return;
+    pipeline_smoother_->setSearchLateralSpacing(FLAGS_search_lateral_spacing * kSearchSpacingScale[quality_index]);
+    pipeline_smoother_->setMaxIterations(kSmootherMaxIterations[quality_index]);
+    // No time limit: the next cycle has not started yet. Cancelled if it does not use the reference.
+    pipeline_deadline_ = Deadline();
+    const Deadline deadline = pipeline_deadline_;
+    pipeline_ = std::async(std::launch::async, [this, deadline]() {
+        TRACE_SCOPE("PathOptimizer::pipelinedSmoothing");
+        ScopedDeadline scoped_deadline(&deadline);
+        pipeline_arena_->reset();
+        ScopedArena scoped_arena(FLAGS_planning_arena_kb > 0 ? pipeline_arena_.get() : nullptr);
+        pipeline_reference_->clear();
+        return pipeline_smoother_->solve(pipeline_reference_.get());
+    });
+}
+
+bool PathOptimizer::takePreparedReference(const std::vector<State> &reference_points) {
+    if (!pipeline_.valid()) return false;
+    const auto &start_state = vehicle_state_->getStartState();
+    if (pipeline_map_version_ != map_version_
+        || !samePositions(pipeline_points_, reference_points)
+        || distance(pipeline_start_state_, start_state) > FLAGS_pipeline_max_start_error
+        || fabs(constraintAngle(pipeline_start_state_.z - start_state.z)) > kPipelineMaxHeadingError) {
+        LOG(INFO) << "Reference smoothed ahead is stale, smooth again.";
+        // It stops at its next checkpoint; smoother_ must not run IPOPT before.
+        pipeline_deadline_.cancel();
+        pipeline_.get();
         return false;
     }
+    // Wait no longer than the smoothing stage may take (its share of FLAGS_time_budget_ms included).
+    const Deadline *deadline = Deadline::current();
+    const auto stage_end = deadline ? deadline->time() : Deadline::Clock::time_point::max();
+    while (pipeline_.wait_until(std::min(stage_end, Deadline::Clock::now() + kPipelinePollInterval))
+        != std::future_status::ready) {
+        if (Deadline::currentExpired()) {
+            // The solve ends without IPOPT, so the pipeline may finish in the background.
+            LOG(WARNING) << "Deadline exceeded while waiting for the reference smoothed ahead.";
+            pipeline_deadline_.cancel();
+            return false;
+        }
+    }
+    if (!pipeline_.get()) return false;
+    reference_path_->swap(*pipeline_reference_);
+    return true;
+}
+
+SolveHandle PathOptimizer::solveAsync(const std::vector<State> &reference_points, const Deadline &deadline) {
+    // The handle and the destructor cancel the solve, so it needs a cancellation of its own.
+    const Deadline job_deadline = deadline.isCancellable() ? deadline : Deadline(deadline.time());
+    std::packaged_task<AsyncSolveResult()> task([this, reference_points, job_deadline]() {
+        AsyncSolveResult async_result;
+        async_result.result = solve(reference_points, &async_result.path, job_deadline);
+        return async_result;
+    });
+    SolveHandle handle(task.get_future(), job_deadline);
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex_);
+        jobs_.push_back(AsyncJob{std::move(task), job_deadline});
+        if (!worker_.joinable()) worker_ = std::thread(&PathOptimizer::runWorker, this);
+    }
+    worker_cv_.notify_one();
+    return handle;
+}
+
+void PathOptimizer::runWorker() {
+    while (true) {
+        AsyncJob job;
+        {
+            std::unique_lock<std::mutex> lock(worker_mutex_);
+            worker_cv_.wait(lock, [this]() { return stop_worker_ || !jobs_.empty(); });
+            // Jobs queued before the stop are run, their deadlines are cancelled.
+            if (jobs_.empty()) return;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+            running_deadline_ = job.deadline;
+        }
+        job.task();
+        {
+            // Callers may keep the deadline of a finished job and hand it to another solve.
+            std::lock_guard<std::mutex> lock(worker_mutex_);
+            running_deadline_ = Deadline::none();
+        }
+    }
 }
 
-bool PathOptimizer::solveWithoutSmoothing(const std::vector<PathOptimizationNS::State> &reference_points,
-                                          std::vector<PathOptimizationNS::State> *final_path) {
+SolveResult PathOptimizer::solveWithoutSmoothing(const std::vector<PathOptimizationNS::State> &reference_points,
+                                                 std::vector<PathOptimizationNS::State> *final_path) {
     // This function is used to calculate once more based on the previous result.
+    TRACE_SCOPE("PathOptimizer::solveWithoutSmoothing");
+    ScopedLatency latency(stageLatency(PlanningStage::SOLVE_WITHOUT_SMOOTHING));
     if (FLAGS_enable_computation_time_output) std::cout << "------" << std::endl;
     CHECK_NOTNULL(final_path);
-    auto t1 = std::clock();
+    arena_->reset();
+    ScopedArena scoped_arena(FLAGS_planning_arena_kb > 0 ? arena_ : nullptr);
+    reference_smoothed_ = false;
+    raw_output_ = FLAGS_enable_raw_output;
+    budget_ms_ = 0;
+    solve_deadline_ = Deadline::none();
+    SolveResult result;
+    if (FLAGS_enable_debug_output) result.debug = std::make_shared<SolveDebugInfo>();
+    auto t1 = std::chrono::steady_clock::now();
     if (reference_points.empty()) {
         LOG(WARNING) << "Empty input, quit path optimization!";
-        return false;
+        countFailure(FailureReason::EMPTY_INPUT);
+        result.status = SolveStatus::EMPTY_INPUT;
+        return finishSolve(t1, &result, final_path);
     }
     vehicle_state_->setInitError(0, 0);
     // Set reference path.
     reference_path_->clear();
     reference_path_->setReference(reference_points);
-    reference_path_->updateBounds(*grid_map_);
-    reference_path_->updateLimits();
+    if (!reference_path_->updateBounds(*grid_map_)) {
+        LOG(WARNING) << "Path optimization without smoothing FAILED!";
+        result.status = SolveStatus::PATH_BLOCKED;
+        return finishSolve(t1, &result, final_path);
+    }
+    if (curvatureLimited()) reference_path_->updateLimits();
     size_ = reference_path_->getSize();
 
-    if (optimizePath(final_path)) {
-        auto t2 = std::clock();
+    auto t2 = std::chrono::steady_clock::now();
+    result.timings.segmentation_ms = time_ms(t1, t2);
+    bool optimization_ok = optimizePath(final_path, &result);
+    auto t3 = std::chrono::steady_clock::now();
+    result.timings.output_check_ms = time_ms(t2, t3) - result.timings.optimization_ms;
+    if (optimization_ok) {
         if (FLAGS_enable_computation_time_output) {
-            time_ms_out(t1, t2, "Solve without smoothing");
+            time_ms_out(t1, t3, "Solve without smoothing");
         }
         LOG(INFO) << "Path optimization without smoothing SUCCEEDED! Total time cost: "
-                  << time_s(t1, t2) << " s";
-        return true;
+                  << time_s(t1, t3) << " s";
     } else {
         LOG(WARNING) << "Path optimization without smoothing FAILED!";
-        return false;
     }
+    return finishSolve(t1, &result, final_path);
+}
+
+void PathOptimizer::beginStage(double budget_share) {
+    if (budget_ms_ <= 0) {
+        stage_deadline_ = solve_deadline_;
+        return;
+    }
+    stage_deadline_ = solve_deadline_.earlier(
+        solve_begin_ + std::chrono::duration_cast<Deadline::Clock::duration>(
+            std::chrono::duration<double, std::milli>(budget_share * budget_ms_)));
+}
+
+bool PathOptimizer::deadlineExceeded(SolveResult *result) const {
+    if (!Deadline::currentExpired()) return false;
+    LOG(WARNING) << "Deadline exceeded, quit path optimization.";
+    countFailure(FailureReason::DEADLINE);
+    result->status = SolveStatus::DEADLINE_EXCEEDED;
+    return true;
 }
 
-bool PathOptimizer::segmentSmoothedPath() {
+void PathOptimizer::useFallback(SolveResult *result, std::vector<State> *final_path) const {
+    final_path->clear();
+    // The smoothed reference starts at the current vehicle position, so it is preferred over the
+    // previous path. It is collision checked like the optimized path.
+    if (reference_smoothed_) {
+        const auto &xs = reference_path_->getXS();
+        const auto &ys = reference_path_->getYS();
+        const double length = reference_path_->getLength();
+        for (int i = 0; i * FLAGS_output_spacing <= length; ++i) {
+            const double s = i * FLAGS_output_spacing;
+            State state{xs(s), ys(s), getHeading(xs, ys, s), getCurvature(xs, ys, s), s};
+            if (FLAGS_enable_collision_check && !collision_checker_->isSingleStateCollisionFreeImproved(state)) {
+                break;
+            }
+            final_path->emplace_back(state);
+        }
+        if (!final_path->empty()) {
+            result->fallback = FallbackPath::SMOOTHED_REFERENCE;
+            return;
+        }
+    }
+    if (!last_path_.empty()) {
+        *final_path = last_path_;
+        result->fallback = FallbackPath::PREVIOUS_PATH;
+    }
+}
+
+const SolveResult &PathOptimizer::finishSolve(const std::chrono::steady_clock::time_point &begin,
+                                              SolveResult *result,
+                                              std::vector<State> *final_path) {
+    if (result->status == SolveStatus::DEADLINE_EXCEEDED) {
+        useFallback(result, final_path);
+    } else if (result->success()) {
+        last_path_ = *final_path;
+    }
+    result->timings.total_ms = time_ms(begin, std::chrono::steady_clock::now());
+    if (budget_ms_ > 0) {
+        const double used = result->timings.total_ms / budget_ms_;
+        const int quality = static_cast<int>(quality_);
+        if ((result->status == SolveStatus::DEADLINE_EXCEEDED || used > kCoarserAbove)
+            && quality_ != SolveQuality::COARSEST) {
+            quality_ = static_cast<SolveQuality>(quality + 1);
+        } else if (result->status != SolveStatus::DEADLINE_EXCEEDED && used < kFinerBelow
+            && quality_ != SolveQuality::FULL) {
+            quality_ = static_cast<SolveQuality>(quality - 1);
+        }
+    }
+    if (result->debug) result->debug->abnormal_bounds = reference_path_->display_abnormal_bounds();
+    if (FLAGS_planning_arena_kb > 0) arenaBytes()->record(arena_->bytesUsed());
+    countSolve(result->success());
+    MetricsRegistry::instance().maybeDump();
+    return *result;
+}
+
+bool PathOptimizer::segmentSmoothedPath(SolveResult *result) {
+    TRACE_SCOPE("PathOptimizer::segmentSmoothedPath");
+    ScopedLatency latency(stageLatency(PlanningStage::SEGMENTATION));
     if (reference_path_->getLength() == 0) {
         LOG(WARNING) << "Smoothed path is empty!";
+        countFailure(FailureReason::EMPTY_REFERENCE);
+        result->status = SolveStatus::EMPTY_REFERENCE;
         return false;
     }
 
@@ -137,6 +509,8 @@ bool PathOptimizer::segmentSmoothedPath() {
     // If the start heading differs a lot with the ref path, quit.
     if (fabs(initial_heading_error) > 75 * M_PI / 180) {
         LOG(WARNING) << "Initial psi error is larger than 75°, quit path optimization!";
+        countFailure(FailureReason::LARGE_HEADING_ERROR);
+        result->status = SolveStatus::LARGE_HEADING_ERROR;
         return false;
     }
     vehicle_state_->setInitError(initial_offset, initial_heading_error);
@@ -169,43 +543,173 @@ bool PathOptimizer::segmentSmoothedPath() {
     // If we want to make the result path dense by interpolation later, the interval here is 1.0m. This makes computation faster, but
     // may fail the collision check due to the large interval.
     // If we want to output the result directly, the interval is controlled by FLAGS_output_spacing.
-    const double delta_s_smaller = FLAGS_enable_raw_output ? 0.15 : 0.5;
-    const double delta_s_larger = FLAGS_enable_raw_output ? FLAGS_output_spacing : 1.0;
+    const double delta_s_smaller = raw_output_ ? 0.15 : 0.5;
+    const double delta_s_larger = raw_output_ ? FLAGS_output_spacing : 1.0;
     reference_path_->buildReferenceFromSpline(delta_s_smaller, delta_s_larger);
-    reference_path_->updateBounds(*grid_map_);
-    reference_path_->updateLimits();
+    if (!reference_path_->updateBounds(*grid_map_)) {
+        // Counted by updateBounds.
+        result->status = SolveStatus::PATH_BLOCKED;
+        return false;
+    }
+    if (curvatureLimited()) reference_path_->updateLimits();
     size_ = reference_path_->getSize();
     LOG(INFO) << "Reference path segmentation succeeded. Size: " << size_;
     return true;
 }
 
-bool PathOptimizer::optimizePath(std::vector<State> *final_path) {
+bool PathOptimizer::solvePortfolio(std::vector<State> *final_path, SolveResult *result) {
+    TRACE_SCOPE("PathOptimizer::solvePortfolio");
+    if (portfolio_flag_ != FLAGS_solver_portfolio) {
+        portfolio_flag_ = FLAGS_solver_portfolio;
+        portfolio_types_.clear();
+        portfolio_solvers_.clear();
+        std::stringstream list(portfolio_flag_);
+        std::string type;
+        while (std::getline(list, type, ',')) {
+            auto solver = OsqpSolver::create(type, *reference_path_, *vehicle_state_, size_);
+            if (!solver) continue;
+            portfolio_types_.push_back(type);
+            portfolio_solvers_.push_back(std::move(solver));
+        }
+        portfolio_paths_.resize(portfolio_solvers_.size());
+    }
+    const size_t count = portfolio_solvers_.size();
+    if (count == 0) return false;
+    for (auto &solver : portfolio_solvers_) {
+        solver->reset(size_);
+        solver->setMaxIterations(kQpMaxIterations[static_cast<int>(result->quality)]);
+    }
+
+    enum { RUNNING, SOLVED, FAILED };
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::vector<int> states(count, RUNNING);
+    // The deadline is thread-local, the solvers read it for their OSQP time limit, which is what
+    // bounds a run that is cancelled while OSQP runs.
+    const Deadline *deadline = Deadline::current();
+    std::vector<std::future<void>> runs;
+    runs.reserve(count);
+    for (size_t i = 0; i != count; ++i) {
+        runs.push_back(std::async(std::launch::async, [&, i]() {
+            ScopedDeadline scoped_deadline(deadline);
+            const bool solved = portfolio_solvers_[i]->solve(&portfolio_paths_[i]);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                states[i] = solved ? SOLVED : FAILED;
+            }
+            finished.notify_one();
+        }));
+    }
+
+    // The first feasible solution, or with FLAGS_portfolio_wait_ms the smoothest one by then.
+    std::vector<int> final_states;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto any_solved = [&]() { return std::count(states.begin(), states.end(), SOLVED) > 0; };
+        auto all_done = [&]() { return std::count(states.begin(), states.end(), RUNNING) == 0; };
+        finished.wait(lock, [&]() { return any_solved() || all_done(); });
+        if (FLAGS_portfolio_wait_ms > 0 && any_solved()) {
+            finished.wait_for(lock, std::chrono::duration<double, std::milli>(FLAGS_portfolio_wait_ms), all_done);
+        }
+        final_states = states;
+    }
+    int winner = -1;
+    double winner_cost = 0;
+    for (size_t i = 0; i != count; ++i) {
+        if (final_states[i] != SOLVED) continue;
+        const double cost = pathCost(portfolio_paths_[i]);
+        if (winner < 0 || cost < winner_cost) {
+            winner = static_cast<int>(i);
+            winner_cost = cost;
+        }
+    }
+    for (size_t i = 0; i != count; ++i) {
+        if (final_states[i] == RUNNING) portfolio_solvers_[i]->cancel();
+    }
+    // The solvers read the reference path, which the next stages and solves change. Cancelled ones
+    // drop their results.
+    for (auto &run : runs) run.wait();
+
+    for (size_t i = 0; i != count; ++i) {
+        countPortfolioResult(portfolio_types_[i],
+                             static_cast<int>(i) == winner ? PortfolioResult::WON :
+                             final_states[i] == SOLVED ? PortfolioResult::FEASIBLE : PortfolioResult::FAILED);
+    }
+    if (winner < 0) return false;
+    final_path->swap(portfolio_paths_[winner]);
+    result->qp = portfolio_solvers_[winner]->getQpInfo();
+    result->optimization_method = portfolio_types_[winner];
+    return true;
+}
+
+bool PathOptimizer::optimizePath(std::vector<State> *final_path, SolveResult *result) {
+    if (deadlineExceeded(result)) return false;
     // Solve problem.
-    auto solver = OsqpSolver::create(FLAGS_optimization_method, *reference_path_, *vehicle_state_, size_);
-    if (solver && !solver->solve(final_path)) {
+    auto t1 = std::chrono::steady_clock::now();
+    bool qp_failed;
+    if (!FLAGS_solver_portfolio.empty()) {
+        qp_failed = !solvePortfolio(final_path, result);
+    } else {
+        if (!solver_ || solver_type_ != FLAGS_optimization_method) {
+            solver_ = OsqpSolver::create(FLAGS_optimization_method, *reference_path_, *vehicle_state_, size_);
+            solver_type_ = FLAGS_optimization_method;
+        } else {
+            solver_->reset(size_);
+        }
+        if (solver_) solver_->setMaxIterations(kQpMaxIterations[static_cast<int>(result->quality)]);
+        qp_failed = solver_ && !solver_->solve(final_path);
+        if (solver_) result->qp = solver_->getQpInfo();
+        result->optimization_method = FLAGS_optimization_method;
+    }
+    result->timings.optimization_ms = time_ms(t1, std::chrono::steady_clock::now());
+    if (qp_failed) {
+        // Includes OSQP stopping at its time limit.
+        if (deadlineExceeded(result)) return false;
         LOG(WARNING) << "QP failed.";
+        countFailure(FailureReason::QP_FAILED);
+        result->status = SolveStatus::QP_FAILED;
         return false;
     }
     LOG(INFO) << "QP succeeded.";
 
+    beginStage(1.0);
+    TRACE_SCOPE("PathOptimizer::outputCheck");
+    ScopedLatency latency(stageLatency(PlanningStage::OUTPUT_CHECK));
     // Output. Choose from:
     // 1. set the interval smaller and output the result directly.
     // 2. set the interval larger and use interpolation to make the result dense.
-    if (FLAGS_enable_raw_output) {
+    if (raw_output_) {
         double s{0};
         for (auto iter = final_path->begin(); iter != final_path->end(); ++iter) {
             if (iter != final_path->begin()) s += distance(*(iter - 1), *iter);
             iter->s = s;
+            if (iter != final_path->begin() && Deadline::currentExpired()) {
+                // The rest is not checked.
+                final_path->erase(iter, final_path->end());
+                LOG(WARNING) << "output check stopped by the deadline at " << final_path->back().s << "m.";
+                result->truncated = true;
+                if (final_path->back().s >= 20) return true;
+                deadlineExceeded(result);
+                return false;
+            }
             if (FLAGS_enable_collision_check && !collision_checker_->isSingleStateCollisionFreeImproved(*iter)) {
                 final_path->erase(iter, final_path->end());
                 LOG(WARNING) << "collision check failed at " << final_path->back().s << "m.";
-                return final_path->back().s >= 20;
+                countFailure(FailureReason::COLLISION);
+                collisionStation()->record(static_cast<uint64_t>(final_path->back().s * 100));
+                result->truncated = true;
+                if (final_path->back().s >= 20) return true;
+                result->status = SolveStatus::COLLISION;
+                return false;
             }
         }
         LOG(INFO) << "Output raw result.";
         return true;
     } else {
         std::vector<double> result_x, result_y, result_s;
+        result_x.reserve(final_path->size());
+        result_y.reserve(final_path->size());
+        result_s.reserve(final_path->size());
         for (const auto &p : *final_path) {
             result_x.emplace_back(p.x);
             result_y.emplace_back(p.y);
@@ -223,9 +727,22 @@ bool PathOptimizer::optimizePath(std::vector<State> *final_path) {
                             getHeading(x_s, y_s, tmp_s),
                             getCurvature(x_s, y_s, tmp_s),
                             tmp_s};
+            if (!final_path->empty() && Deadline::currentExpired()) {
+                // The rest is not checked.
+                LOG(WARNING) << "output check stopped by the deadline at " << final_path->back().s << "m.";
+                result->truncated = true;
+                if (final_path->back().s >= 20) return true;
+                deadlineExceeded(result);
+                return false;
+            }
             if (FLAGS_enable_collision_check && !collision_checker_->isSingleStateCollisionFreeImproved(tmp_state)) {
                 LOG(WARNING) << "[PathOptimizer] collision check failed at " << final_path->back().s << "m.";
-                return final_path->back().s >= 20;
+                countFailure(FailureReason::COLLISION);
+                collisionStation()->record(static_cast<uint64_t>(final_path->back().s * 100));
+                result->truncated = true;
+                if (final_path->back().s >= 20) return true;
+                result->status = SolveStatus::COLLISION;
+                return false;
             }
             final_path->emplace_back(tmp_state);
         }
@@ -234,16 +751,4 @@ bool PathOptimizer::optimizePath(std::vector<State> *final_path) {
     }
 }
 
-const std::vector<State> &PathOptimizer::getSmoothedPath() const {
-    return this->smoothed_path_;
-}
-
-std::vector<std::tuple<State, double, double>> PathOptimizer::display_abnormal_bounds() const {
-    return this->reference_path_->display_abnormal_bounds();
-}
-
-const std::vector<std::vector<double>> &PathOptimizer::getSearchResult() const {
-    return this->reference_searching_display_;
-}
-
 }
@@ -4,6 +4,7 @@
 #include "glog/logging.h"
 #include "path_optimizer/reference_path_smoother/angle_diff_smoother.hpp"
 #include "path_optimizer/tools/tools.hpp"
+#include "path_optimizer/tools/tracer.hpp"
 #include "path_optimizer/config/planning_flags.hpp"
 #include "path_optimizer/data_struct/reference_path.hpp"
 
@@ -93,8 +94,10 @@ AngleDiffSmoother::AngleDiffSmoother(const std::vector<PathOptimizationNS::State
 
 bool AngleDiffSmoother::smooth(PathOptimizationNS::ReferencePath *reference_path,
                                std::vector<PathOptimizationNS::State> *smoothed_path_display) {
+    TRACE_SCOPE("AngleDiffSmoother::smooth", "smoothing");
     std::vector<double> x_list, y_list, s_list, angle_list;
-    if (!segmentRawReference(&x_list, &y_list, &s_list, &angle_list)) return false;
+    std::vector<Tangent> tangent_list;
+    if (!segmentRawReference(&x_list, &y_list, &s_list, &angle_list, &tangent_list)) return false;
     size_t N = s_list.size();
 
     typedef CPPAD_TESTVECTOR(double) Dvector;
@@ -128,9 +131,10 @@ bool AngleDiffSmoother::smooth(PathOptimizationNS::ReferencePath *reference_path
     // magnitude.
     options += "Sparse  true        forward\n";
     options += "Sparse  true        reverse\n";
-    // NOTE: Currently the solver has a maximum time limit of 0.1 seconds.
+    // NOTE: Currently the solver has a maximum time limit of 0.1 seconds, less if the deadline is closer.
     // Change this as you see fit.
-    options += "Numeric max_cpu_time          0.1\n";
+    options += ipoptTimeLimit(0.1);
+    if (max_iterations_ > 0) options += "Integer max_iter              " + std::to_string(max_iterations_) + "\n";
     // place to return solution
     CppAD::ipopt::solve_result<Dvector> solution;
     // weights of the cost function
@@ -146,26 +150,23 @@ bool AngleDiffSmoother::smooth(PathOptimizationNS::ReferencePath *reference_path
                                       N,
                                       weights);
     // solve the problem
+    ScopedSpan ipopt_span("AngleDiffSmoother::ipopt", "smoothing");
     CppAD::ipopt::solve<Dvector, FgEvalFrenetSmooth>(options, vars,
                                                      vars_lowerbound, vars_upperbound,
                                                      constraints_lowerbound, constraints_upperbound,
                                                      fg_eval_frenet, solution);
+    ipopt_span.stop();
     // Check if it works
-    if (solution.status != CppAD::ipopt::solve_result<Dvector>::success) {
+    if (!ipoptResultUsable(solution)) {
         LOG(WARNING) << "Angle diff smoother failed!";
         return false;
     }
-    // output
-    tk::spline raw_x_s, raw_y_s;
-    raw_x_s.set_points(s_list_, x_list_);
-    raw_y_s.set_points(s_list_, y_list_);
+    // output. x_list and y_list are the raw path at s_list; offset them along the normals.
     std::vector<double> result_x_list, result_y_list, result_s_list;
     double tmp_s = 0;
     for (size_t i = 0; i != N; i++) {
-        double length_on_ref_path = s_list[i];
-        double new_angle = constraintAngle(angle_list[i] + M_PI_2);
-        double tmp_x = raw_x_s(length_on_ref_path) + solution.x[i] * cos(new_angle);
-        double tmp_y = raw_y_s(length_on_ref_path) + solution.x[i] * sin(new_angle);
+        double tmp_x = x_list[i] - solution.x[i] * tangent_list[i].y;
+        double tmp_y = y_list[i] + solution.x[i] * tangent_list[i].x;
         result_x_list.emplace_back(tmp_x);
         result_y_list.emplace_back(tmp_y);
         if (i != 0) {
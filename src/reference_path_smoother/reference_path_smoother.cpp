@@ -1,11 +1,15 @@
 //
 // Created by ljn on 20-2-9.
 //
+#include <initializer_list>
 #include <glog/logging.h>
 #include "path_optimizer/reference_path_smoother/reference_path_smoother.hpp"
 #include "path_optimizer/tools/spline.h"
 #include "path_optimizer/tools/tools.hpp"
 #include "path_optimizer/tools/Map.hpp"
+#include "path_optimizer/tools/tracer.hpp"
+#include "path_optimizer/tools/metrics.hpp"
+#include "path_optimizer/tools/deadline.hpp"
 #include "path_optimizer/config/planning_flags.hpp"
 #include "path_optimizer/data_struct/reference_path.hpp"
 #include "path_optimizer/reference_path_smoother/angle_diff_smoother.hpp"
@@ -29,21 +33,46 @@ std::unique_ptr<ReferencePathSmoother> ReferencePathSmoother::create(std::string
 
 bool ReferencePathSmoother::solve(PathOptimizationNS::ReferencePath *reference_path,
                                   std::vector<PathOptimizationNS::State> *smoothed_path_display) {
+    TRACE_SCOPE("ReferencePathSmoother::solve", "smoothing");
+    x_list_.clear();
+    y_list_.clear();
+    s_list_.clear();
+    search_failed_ = false;
     bSpline();
-    if (FLAGS_enable_searching && modifyInputPoints()) {
+    const bool searched = FLAGS_enable_searching && modifyInputPoints();
+    // The search containers are in the arena of this solve, which is reset before the next one.
+    sampled_points_ = decltype(sampled_points_)();
+    open_set_ = decltype(open_set_)();
+    closed_set_ = decltype(closed_set_)();
+    if (Deadline::currentExpired()) return false;
+    if (searched) {
         // If searching process succeeded, add the searched result into reference_path.
         tk::spline searched_xs, searched_ys;
         searched_xs.set_points(s_list_, x_list_);
         searched_ys.set_points(s_list_, y_list_);
         reference_path->setOriginalSpline(searched_xs, searched_ys, s_list_.back());
     }
+    ScopedLatency latency(stageLatency(PlanningStage::SMOOTHING));
     return smooth(reference_path, smoothed_path_display);
 }
 
+void ReferencePathSmoother::setInputPoints(const std::vector<State> &input_points) {
+    input_points_ = &input_points;
+}
+
+void ReferencePathSmoother::setSearchLateralSpacing(double spacing) {
+    search_lateral_spacing_ = spacing;
+}
+
+void ReferencePathSmoother::setMaxIterations(int max_iterations) {
+    max_iterations_ = max_iterations;
+}
+
 bool ReferencePathSmoother::segmentRawReference(std::vector<double> *x_list,
                                                 std::vector<double> *y_list,
                                                 std::vector<double> *s_list,
-                                                std::vector<double> *angle_list) const {
+                                                std::vector<double> *angle_list,
+                                                std::vector<Tangent> *tangent_list) const {
     if (s_list_.size() != x_list_.size() || s_list_.size() != y_list_.size()) {
         LOG(ERROR) << "Raw path x y and s size not equal!";
         return false;
@@ -55,6 +84,11 @@ bool ReferencePathSmoother::segmentRawReference(std::vector<double> *x_list,
     y_spline.set_points(s_list_, y_list_);
     // Divide the raw path.
     double delta_s = 1.0;
+    const auto expected_points = static_cast<size_t>(max_s / delta_s) + 2;
+    for (auto *list : {s_list, x_list, y_list, angle_list}) {
+        if (list) list->reserve(expected_points);
+    }
+    if (tangent_list) tangent_list->reserve(expected_points);
     s_list->emplace_back(0);
     while (s_list->back() < max_s) {
         s_list->emplace_back(s_list->back() + delta_s);
@@ -66,8 +100,11 @@ bool ReferencePathSmoother::segmentRawReference(std::vector<double> *x_list,
     // Store reference states in vectors. They will be used later.
     for (size_t i = 0; i != point_num; ++i) {
         double length_on_ref_path = s_list->at(i);
-        double angle = atan2(y_spline.deriv(1, length_on_ref_path), x_spline.deriv(1, length_on_ref_path));
-        angle_list->emplace_back(angle);
+        if (angle_list) {
+            double angle = atan2(y_spline.deriv(1, length_on_ref_path), x_spline.deriv(1, length_on_ref_path));
+            angle_list->emplace_back(angle);
+        }
+        if (tangent_list) tangent_list->emplace_back(getTangent(x_spline, y_spline, length_on_ref_path));
         x_list->emplace_back(x_spline(length_on_ref_path));
         y_list->emplace_back(y_spline(length_on_ref_path));
     }
@@ -105,13 +142,27 @@ std::vector<std::vector<double>> ReferencePathSmoother::display() const {
     return std::vector<std::vector<double>>{x_list_, y_list_, s_list_};
 }
 
+std::string ReferencePathSmoother::ipoptTimeLimit(double limit) {
+    const std::string seconds = std::to_string(Deadline::currentTimeLimit(limit));
+    std::string options = "Numeric max_cpu_time          " + seconds + "\n";
+#ifdef IPOPT_HAS_MAX_WALL_TIME
+    options += "Numeric max_wall_time         " + seconds + "\n";
+#endif
+    return options;
+}
+
+bool ReferencePathSmoother::searchFailed() const {
+    return search_failed_;
+}
+
 double ReferencePathSmoother::getG(const PathOptimizationNS::APoint &point,
                                    const PathOptimizationNS::APoint &parent) const {
     // Obstacle cost.
     grid_map::Position position(point.x, point.y);
     double obstacle_cost = 0;
-    double distance_to_obs = grid_map_.getObstacleDistance(position);
     double safety_distance = 5;
+    // Most nodes are far from obstacles, where a coarse lookup proves there is no cost.
+    double distance_to_obs = grid_map_.getObstacleDistanceUpTo(position, safety_distance);
     if (distance_to_obs < safety_distance) {
         obstacle_cost = (safety_distance - distance_to_obs) / safety_distance * FLAGS_search_obstacle_cost;
     }
@@ -132,14 +183,21 @@ double ReferencePathSmoother::getG(const PathOptimizationNS::APoint &point,
 }
 
 bool ReferencePathSmoother::modifyInputPoints() {
-    auto t1 = std::clock();
+    TRACE_SCOPE("ReferencePathSmoother::modifyInputPoints", "smoothing");
+    ScopedLatency latency(stageLatency(PlanningStage::SEARCH));
+    auto t1 = std::chrono::steady_clock::now();
     if (x_list_.empty() || y_list_.empty() || s_list_.empty()) return false;
+    // Fresh containers, bound to the arena of this solve.
+    sampled_points_ = decltype(sampled_points_)();
+    closed_set_ = decltype(closed_set_)();
+    open_set_ = decltype(open_set_)();
     tk::spline x_s, y_s;
     x_s.set_points(s_list_, x_list_);
     y_s.set_points(s_list_, y_list_);
     // Sampling interval.
     double tmp_s = 0;
-    std::vector<double> layers_s_list;
+    ArenaVector<double> layers_s_list;
+    layers_s_list.reserve(static_cast<size_t>(s_list_.back() / FLAGS_search_longitudial_spacing) + 2);
     while (tmp_s < s_list_.back()) {
         layers_s_list.emplace_back(tmp_s);
         tmp_s += FLAGS_search_longitudial_spacing;
@@ -156,12 +214,13 @@ bool ReferencePathSmoother::modifyInputPoints() {
     start_point.layer = 0;
     start_point.g = 0;
     start_point.h = getH(start_point);
-    sampled_points_.emplace_back(std::vector<APoint>{start_point});
+    sampled_points_.reserve(layers_s_list.size());
+    sampled_points_.emplace_back(1, start_point);
     for (size_t i = 1; i != layers_s_list.size(); ++i) {
         double sr = layers_s_list[i];
         double xr = x_s(sr);
         double yr = y_s(sr);
-        double hr = getHeading(x_s, y_s, sr);
+        const auto tangent = getTangent(x_s, y_s, sr);
         double rr = 1.0 / (getCurvature(x_s, y_s, sr));
         double left_range = FLAGS_search_lateral_range, right_range = -FLAGS_search_lateral_range;
         if (rr > 0) {
@@ -171,14 +230,15 @@ bool ReferencePathSmoother::modifyInputPoints() {
             // right turn
             right_range = std::max(right_range, rr);
         }
-        std::vector<APoint> point_set;
+        ArenaVector<APoint> point_set;
+        point_set.reserve(static_cast<size_t>((left_range - right_range) / search_lateral_spacing_) + 1);
         double offset = right_range;
         while (offset <= left_range) {
             APoint point;
             point.s = sr;
             point.l = offset;
-            point.x = xr + offset * cos(hr + M_PI_2);
-            point.y = yr + offset * sin(hr + M_PI_2);
+            point.x = xr - offset * tangent.y;
+            point.y = yr + offset * tangent.x;
             point.layer = i;
             point.offset = offset;
             grid_map::Position position(point.x, point.y);
@@ -186,9 +246,9 @@ bool ReferencePathSmoother::modifyInputPoints() {
                 && grid_map_.getObstacleDistance(position) > FLAGS_circle_radius) {
                 point_set.emplace_back(point);
             }
-            offset += FLAGS_search_lateral_spacing;
+            offset += search_lateral_spacing_;
         }
-        sampled_points_.emplace_back(point_set);
+        sampled_points_.emplace_back(std::move(point_set));
     }
 
     // Push the start point into the open set.
@@ -198,7 +258,13 @@ bool ReferencePathSmoother::modifyInputPoints() {
     // Search.
     while (true) {
         if (open_set_.empty()) {
+            // Not a failure of the solve yet, the raw input is smoothed instead.
             LOG(WARNING) << "Lattice search failed!";
+            search_failed_ = true;
+            return false;
+        }
+        if (Deadline::currentExpired()) {
+            LOG(WARNING) << "Lattice search stopped by the deadline.";
             return false;
         }
         auto tmp_point_ptr = open_set_.top();
@@ -233,7 +299,9 @@ bool ReferencePathSmoother::modifyInputPoints() {
     }
 
     // Retrieve optimal path.
-    std::vector<double> a_x_list, a_y_list;
+    ArenaVector<double> a_x_list, a_y_list;
+    a_x_list.reserve(sampled_points_.size());
+    a_y_list.reserve(sampled_points_.size());
     auto ptr = open_set_.top();
     while (ptr) {
         a_x_list.emplace_back(ptr->x);
@@ -270,6 +338,9 @@ bool ReferencePathSmoother::modifyInputPoints() {
     s_list_.clear();
     double delta_t = 1.0 / target_s_;
     double tmp_t = 0;
+    x_list_.reserve(static_cast<size_t>(target_s_) + 2);
+    y_list_.reserve(static_cast<size_t>(target_s_) + 2);
+    s_list_.reserve(static_cast<size_t>(target_s_) + 2);
     while (tmp_t < 1) {
         auto result = b_spline.eval(tmp_t).result();
         x_list_.emplace_back(result[0]);
@@ -286,7 +357,7 @@ bool ReferencePathSmoother::modifyInputPoints() {
         double dis = sqrt(pow(x_list_[i] - x_list_[i - 1], 2) + pow(y_list_[i] - y_list_[i - 1], 2));
         s_list_.emplace_back(s_list_.back() + dis);
     }
-    auto t2 = std::clock();
+    auto t2 = std::chrono::steady_clock::now();
     if (FLAGS_enable_computation_time_output) {
         time_ms_out(t1, t2, "Search");
     }
@@ -298,25 +369,29 @@ bool ReferencePathSmoother::checkExistenceInClosedSet(const APoint &point) const
 }
 
 void ReferencePathSmoother::bSpline() {
+    TRACE_SCOPE("ReferencePathSmoother::bSpline", "smoothing");
     // B spline smoothing.
     double length = 0;
-    for (size_t i = 0; i != input_points_.size() - 1; ++i) {
-        length += distance(input_points_[i], input_points_[i + 1]);
+    for (size_t i = 0; i != input_points_->size() - 1; ++i) {
+        length += distance((*input_points_)[i], (*input_points_)[i + 1]);
     }
     int degree = 3;
-    double average_length = length / (input_points_.size() - 1);
+    double average_length = length / (input_points_->size() - 1);
     if (average_length > 10) degree = 3;
     else if (average_length > 5) degree = 4;
     else degree = 5;
-    tinyspline::BSpline b_spline_raw(input_points_.size(), 2, degree);
+    tinyspline::BSpline b_spline_raw(input_points_->size(), 2, degree);
     std::vector<tinyspline::real> ctrlp_raw = b_spline_raw.controlPoints();
-    for (size_t i = 0; i != input_points_.size(); ++i) {
-        ctrlp_raw[2 * (i)] = input_points_[i].x;
-        ctrlp_raw[2 * (i) + 1] = input_points_[i].y;
+    for (size_t i = 0; i != input_points_->size(); ++i) {
+        ctrlp_raw[2 * (i)] = (*input_points_)[i].x;
+        ctrlp_raw[2 * (i) + 1] = (*input_points_)[i].y;
     }
     b_spline_raw.setControlPoints(ctrlp_raw);
     double delta_t = 1.0 / length;
     double tmp_t = 0;
+    x_list_.reserve(static_cast<size_t>(length) + 2);
+    y_list_.reserve(static_cast<size_t>(length) + 2);
+    s_list_.reserve(static_cast<size_t>(length) + 2);
     while (tmp_t < 1) {
         auto result = b_spline_raw.eval(tmp_t).result();
         x_list_.emplace_back(result[0]);
@@ -336,9 +411,10 @@ void ReferencePathSmoother::bSpline() {
 ReferencePathSmoother::ReferencePathSmoother(const std::vector<State> &input_points,
                                              const State &start_state,
                                              const Map &grid_map) :
-    input_points_(input_points),
+    input_points_(&input_points),
     start_state_(start_state),
-    grid_map_(grid_map) {}
+    grid_map_(grid_map),
+    search_lateral_spacing_(FLAGS_search_lateral_spacing) {}
 
 inline double ReferencePathSmoother::getH(const APoint &p) const {
     // Note that this h is neither admissible nor consistent, so the result is not optimal.
@@ -7,6 +7,8 @@
 #include "path_optimizer/tools/Map.hpp"
 #include "path_optimizer/reference_path_smoother/tension_smoother.hpp"
 #include "path_optimizer/tools/tools.hpp"
+#include "path_optimizer/tools/tracer.hpp"
+#include "path_optimizer/tools/deadline.hpp"
 #include "path_optimizer/data_struct/reference_path.hpp"
 #include "path_optimizer/config/planning_flags.hpp"
 #include "path_optimizer/data_struct/data_struct.hpp"
@@ -20,12 +22,13 @@ void FgEvalReferenceSmoothing::operator()(PathOptimizationNS::FgEvalReferenceSmo
         ad last_offset = vars[i - 1];
         ad current_offset = vars[i];
         ad next_offset = vars[i + 1];
-        ad last_x = seg_x_list_[i - 1] + last_offset * cos(seg_angle_list_[i - 1] + M_PI_2);
-        ad last_y = seg_y_list_[i - 1] + last_offset * sin(seg_angle_list_[i - 1] + M_PI_2);
-        ad current_x = seg_x_list_[i] + current_offset * cos(seg_angle_list_[i] + M_PI_2);
-        ad current_y = seg_y_list_[i] + current_offset * sin(seg_angle_list_[i] + M_PI_2);
-        ad next_x = seg_x_list_[i + 1] + next_offset * cos(seg_angle_list_[i + 1] + M_PI_2);
-        ad next_y = seg_y_list_[i + 1] + next_offset * sin(seg_angle_list_[i + 1] + M_PI_2);
+        // Offsets along the left normals (-sin, cos).
+        ad last_x = seg_x_list_[i - 1] - last_offset * seg_tangent_list_[i - 1].y;
+        ad last_y = seg_y_list_[i - 1] + last_offset * seg_tangent_list_[i - 1].x;
+        ad current_x = seg_x_list_[i] - current_offset * seg_tangent_list_[i].y;
+        ad current_y = seg_y_list_[i] + current_offset * seg_tangent_list_[i].x;
+        ad next_x = seg_x_list_[i + 1] - next_offset * seg_tangent_list_[i + 1].y;
+        ad next_y = seg_y_list_[i + 1] + next_offset * seg_tangent_list_[i + 1].x;
         ad ref_x = seg_x_list_[i];
         ad ref_y = seg_y_list_[i];
         // Deviation cost:
@@ -43,14 +46,16 @@ TensionSmoother::TensionSmoother(const std::vector<PathOptimizationNS::State> &i
 
 bool TensionSmoother::smooth(PathOptimizationNS::ReferencePath *reference_path,
                              std::vector<PathOptimizationNS::State> *smoothed_path_display) {
-    std::vector<double> x_list, y_list, s_list, angle_list;
-    if (!segmentRawReference(&x_list, &y_list, &s_list, &angle_list)) return false;
+    TRACE_SCOPE("TensionSmoother::smooth", "smoothing");
+    std::vector<double> x_list, y_list, s_list;
+    std::vector<Tangent> tangent_list;
+    if (!segmentRawReference(&x_list, &y_list, &s_list, nullptr, &tangent_list)) return false;
     std::vector<double> result_x_list, result_y_list, result_s_list;
     bool solver_ok{false};
     if (FLAGS_tension_solver == "IPOPT") {
-        solver_ok = ipoptSmooth(x_list, y_list, angle_list, s_list, &result_x_list, &result_y_list, &result_s_list);
+        solver_ok = ipoptSmooth(x_list, y_list, tangent_list, s_list, &result_x_list, &result_y_list, &result_s_list);
     } else if (FLAGS_tension_solver == "OSQP") {
-        solver_ok = osqpSmooth(x_list, y_list, angle_list, s_list, &result_x_list, &result_y_list, &result_s_list);
+        solver_ok = osqpSmooth(x_list, y_list, tangent_list, s_list, &result_x_list, &result_y_list, &result_s_list);
     } else {
         LOG(ERROR) << "No such solver for tension smoother!";
         return false;
@@ -85,14 +90,15 @@ bool TensionSmoother::smooth(PathOptimizationNS::ReferencePath *reference_path,
 
 bool TensionSmoother::ipoptSmooth(const std::vector<double> &x_list,
                                   const std::vector<double> &y_list,
-                                  const std::vector<double> &angle_list,
+                                  const std::vector<Tangent> &tangent_list,
                                   const std::vector<double> &s_list,
                                   std::vector<double> *result_x_list,
                                   std::vector<double> *result_y_list,
                                   std::vector<double> *result_s_list) {
+    TRACE_SCOPE("TensionSmoother::ipoptSmooth", "smoothing");
     CHECK_EQ(x_list.size(), y_list.size());
-    CHECK_EQ(y_list.size(), angle_list.size());
-    CHECK_EQ(angle_list.size(), s_list.size());
+    CHECK_EQ(y_list.size(), tangent_list.size());
+    CHECK_EQ(tangent_list.size(), s_list.size());
     typedef CPPAD_TESTVECTOR(double) Dvector;
     size_t n_vars = x_list.size();
     Dvector vars(n_vars);
@@ -115,7 +121,7 @@ bool TensionSmoother::ipoptSmooth(const std::vector<double> &x_list,
         double y = y_list[i];
         double clearance = grid_map_.getObstacleDistance(grid_map::Position(x, y));
         // Adjust clearance.
-        clearance = isEqual(clearance, 0) ? default_clearance :
+        clearance = isEqual(clearance, 0) ? collisionClearance(x, y, tangent_list[i], default_clearance) :
                     clearance > FLAGS_circle_radius ? clearance - FLAGS_circle_radius : clearance;
         vars_lowerbound[i] = -clearance;
         vars_upperbound[i] = clearance;
@@ -131,7 +137,8 @@ bool TensionSmoother::ipoptSmooth(const std::vector<double> &x_list,
     options += "Integer print_level  0\n";
     options += "Sparse  true        forward\n";
     options += "Sparse  true        reverse\n";
-    options += "Numeric max_cpu_time          0.05\n";
+    options += ipoptTimeLimit(0.05);
+    if (max_iterations_ > 0) options += "Integer max_iter              " + std::to_string(max_iterations_) + "\n";
 
     // place to return solution
     CppAD::ipopt::solve_result<Dvector> solution;
@@ -139,16 +146,14 @@ bool TensionSmoother::ipoptSmooth(const std::vector<double> &x_list,
     FgEvalReferenceSmoothing fg_eval_reference_smoothing(x_list,
                                                          y_list,
                                                          s_list,
-                                                         angle_list);
+                                                         tangent_list);
     // solve the problem
     CppAD::ipopt::solve<Dvector, FgEvalReferenceSmoothing>(options, vars,
                                                            vars_lowerbound, vars_upperbound,
                                                            constraints_lowerbound, constraints_upperbound,
                                                            fg_eval_reference_smoothing, solution);
     // Check if it works
-    bool ok = true;
-    ok &= solution.status == CppAD::ipopt::solve_result<Dvector>::success;
-    if (!ok) {
+    if (!ipoptResultUsable(solution)) {
         LOG(WARNING) << "Tension smoothing ipopt solver failed!";
         return false;
     }
@@ -158,9 +163,8 @@ bool TensionSmoother::ipoptSmooth(const std::vector<double> &x_list,
     result_y_list->clear();
     double tmp_s = 0;
     for (size_t i = 0; i != n_vars; ++i) {
-        double new_angle = constraintAngle(angle_list[i] + M_PI_2);
-        double tmp_x = x_list[i] + solution.x[i] * cos(new_angle);
-        double tmp_y = y_list[i] + solution.x[i] * sin(new_angle);
+        double tmp_x = x_list[i] - solution.x[i] * tangent_list[i].y;
+        double tmp_y = y_list[i] + solution.x[i] * tangent_list[i].x;
         result_x_list->emplace_back(tmp_x);
         result_y_list->emplace_back(tmp_y);
         if (i != 0) tmp_s += sqrt(pow(result_x_list->at(i) - result_x_list->at(i - 1), 2)
@@ -172,18 +176,23 @@ bool TensionSmoother::ipoptSmooth(const std::vector<double> &x_list,
 
 bool TensionSmoother::osqpSmooth(const std::vector<double> &x_list,
                                  const std::vector<double> &y_list,
-                                 const std::vector<double> &angle_list,
+                                 const std::vector<Tangent> &tangent_list,
                                  const std::vector<double> &s_list,
                                  std::vector<double> *result_x_list,
                                  std::vector<double> *result_y_list,
                                  std::vector<double> *result_s_list) {
+    TRACE_SCOPE("TensionSmoother::osqpSmooth", "smoothing");
     CHECK_EQ(x_list.size(), y_list.size());
-    CHECK_EQ(y_list.size(), angle_list.size());
-    CHECK_EQ(angle_list.size(), s_list.size());
+    CHECK_EQ(y_list.size(), tangent_list.size());
+    CHECK_EQ(tangent_list.size(), s_list.size());
     auto point_num = x_list.size();
     OsqpEigen::Solver solver_;
     solver_.settings()->setVerbosity(false);
     solver_.settings()->setWarmStart(true);
+    if (Deadline::current() && Deadline::current()->hasTimeLimit()) {
+        solver_.settings()->setTimeLimit(Deadline::currentTimeLimit(HUGE_VAL));
+    }
+    if (max_iterations_ > 0) solver_.settings()->setMaxIteration(max_iterations_);
     solver_.data()->setNumberOfVariables(3 * point_num);
     solver_.data()->setNumberOfConstraints(3 * point_num);
     // Allocate QP problem matrices and vectors.
@@ -193,7 +202,7 @@ bool TensionSmoother::osqpSmooth(const std::vector<double> &x_list,
     Eigen::VectorXd lowerBound;
     Eigen::VectorXd upperBound;
     setHessianMatrix(point_num, &hessian);
-    setConstraintMatrix(x_list, y_list, angle_list, s_list, &linearMatrix, &lowerBound, &upperBound);
+    setConstraintMatrix(x_list, y_list, tangent_list, s_list, &linearMatrix, &lowerBound, &upperBound);
     // Input to solver.
     if (!solver_.data()->setHessianMatrix(hessian)) return false;
     if (!solver_.data()->setGradient(gradient)) return false;
@@ -243,7 +252,7 @@ void TensionSmoother::setHessianMatrix(size_t size, Eigen::SparseMatrix<double>
 
 void TensionSmoother::setConstraintMatrix(const std::vector<double> &x_list,
                                           const std::vector<double> &y_list,
-                                          const std::vector<double> &angle_list,
+                                          const std::vector<Tangent> &tangent_list,
                                           const std::vector<double> &s_list,
                                           Eigen::SparseMatrix<double> *matrix_constraints,
                                           Eigen::VectorXd *lower_bound,
@@ -258,9 +267,9 @@ void TensionSmoother::setConstraintMatrix(const std::vector<double> &x_list,
     for (int i = 0; i != size; ++i) {
         // x, y and d
         cons(x_start_index + i, x_start_index + i) = cons(y_start_index + i, y_start_index + i) = 1;
-        double theta{angle_list[i] + M_PI_2};
-        cons(x_start_index + i, d_start_index + i) = -cos(theta);
-        cons(y_start_index + i, d_start_index + i) = -sin(theta);
+        // x - d * normal = reference, with the left normal (-sin, cos).
+        cons(x_start_index + i, d_start_index + i) = tangent_list[i].y;
+        cons(y_start_index + i, d_start_index + i) = -tangent_list[i].x;
         // d
         cons(d_start_index + i, d_start_index + i) = 1;
         // bounds
@@ -282,11 +291,22 @@ void TensionSmoother::setConstraintMatrix(const std::vector<double> &x_list,
         double y = y_list[i];
         double clearance = grid_map_.getObstacleDistance(grid_map::Position(x, y));
         // Adjust clearance.
-        clearance = isEqual(clearance, 0) ? default_clearance :
+        clearance = isEqual(clearance, 0) ? collisionClearance(x, y, tangent_list[i], default_clearance) :
                    clearance > shrink_clearance ? clearance - shrink_clearance : clearance;
         (*lower_bound)(d_start_index + i) = -clearance;
         (*upper_bound)(d_start_index + i) = clearance;
     }
 }
 
+double TensionSmoother::collisionClearance(double x, double y, const Tangent &tangent,
+                                           double default_clearance) const {
+    const grid_map::Position position(x, y);
+    const double signed_distance = grid_map_.getSignedDistance(position);
+    if (!grid_map_.hasSignedDistance() || signed_distance >= 0) return default_clearance;
+    const auto gradient = grid_map_.getDistanceGradient(position);
+    const double slope = std::fabs(-gradient.x() * tangent.y + gradient.y() * tangent.x);
+    // The offset is symmetric, so only the distance matters, not the side.
+    return -signed_distance / std::max(slope, 0.5) + FLAGS_circle_radius;
+}
+
 }
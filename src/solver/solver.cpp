@@ -2,32 +2,93 @@
 // Created by ljn on 20-3-10.
 //
 
+#include <cmath>
+#include <sstream>
+#include <string>
 #include "path_optimizer/solver/solver.hpp"
 #include "path_optimizer/solver/solver_k_as_input.hpp"
 #include "path_optimizer/solver/solver_kp_as_input.hpp"
 #include "path_optimizer/solver/solver_kp_as_input_constrained.hpp"
 #include "path_optimizer/data_struct/reference_path.hpp"
+#include "path_optimizer/data_struct/reference_arrays.hpp"
 #include "path_optimizer/data_struct/data_struct.hpp"
+#include "path_optimizer/tools/deadline.hpp"
+#include "path_optimizer/tools/metrics.hpp"
+#include "path_optimizer/config/planning_flags.hpp"
 
 namespace PathOptimizationNS {
 
+namespace {
+const int kOsqpDefaultMaxIterations = 4000;
+}
+
 OsqpSolver::OsqpSolver(const ReferencePath &reference_path,
                        const VehicleState &vehicle_state,
                        const size_t &horizon) :
-    horizon_(horizon),
+    horizon_(bucketHorizon(horizon)),
+    active_horizon_(horizon),
     reference_path_(reference_path),
     vehicle_state_(vehicle_state),
     reference_interval_(0) {
-    LOG(INFO) << "Optimization horizon: " << horizon;
+    LOG(INFO) << "Optimization horizon: " << horizon << ", padded to " << horizon_;
+    updateReferenceInterval();
+}
+
+void OsqpSolver::reset(const size_t &horizon) {
+    horizon_ = bucketHorizon(horizon);
+    active_horizon_ = horizon;
+    LOG(INFO) << "Optimization horizon: " << horizon << ", padded to " << horizon_;
+    updateReferenceInterval();
+    updateSizes();
+    qp_info_ = QpInfo();
+    cancelled_ = false;
+}
+
+size_t OsqpSolver::bucketHorizon(size_t horizon) {
+    // Validated to be increasing sizes.
+    std::stringstream list(FLAGS_qp_horizon_buckets);
+    std::string bucket;
+    while (std::getline(list, bucket, ',')) {
+        const size_t size = std::stoul(bucket);
+        if (size >= horizon) return size;
+    }
+    return horizon;
+}
+
+void OsqpSolver::cancel() {
+    // The workspace settings are not touched: OSQP reads them without synchronization.
+    cancelled_ = true;
+}
+
+bool OsqpSolver::runOsqp() {
+    // Set up only if loadProblem() did not update the workspace of the last solve.
+    if (!solver_.isInitialized() && !solver_.initSolver()) return false;
+    if (cancelled_) return false;
+    const bool solved = solver_.solve();
+    return solved && !cancelled_;
+}
+
+void OsqpSolver::updateReferenceInterval() {
+    reference_interval_ = 0;
     // Check some of the reference states to get the interval.
     const int check_num = 10;
     for (int i = 1; i < reference_path_.getSize() && i < check_num; ++i) {
         reference_interval_ = std::max(reference_interval_,
-                                       reference_path_.getReferenceStates()[i].s
-                                           - reference_path_.getReferenceStates()[i - 1].s);
+                                       reference_path_.getReferenceArrays().s()[i]
+                                           - reference_path_.getReferenceArrays().s()[i - 1]);
     }
 }
 
+void OsqpSolver::copyBounds(const std::vector<double> &bounds, double shift, size_t begin, size_t stride,
+                            double padding, Eigen::VectorXd *vector) const {
+    CHECK_LE(active_horizon_, bounds.size());
+    Eigen::Map<Eigen::VectorXd, 0, Eigen::InnerStride<>> destination(vector->data() + begin, horizon_,
+                                                                     Eigen::InnerStride<>(stride));
+    destination.head(active_horizon_) =
+        Eigen::Map<const Eigen::VectorXd>(bounds.data(), active_horizon_).array() + shift;
+    destination.tail(horizon_ - active_horizon_).setConstant(padding);
+}
+
 std::unique_ptr<OsqpSolver> OsqpSolver::create(std::string &type,
                                                const PathOptimizationNS::ReferencePath &reference_path,
                                                const PathOptimizationNS::VehicleState &vehicle_state,
@@ -44,4 +105,103 @@ std::unique_ptr<OsqpSolver> OsqpSolver::create(std::string &type,
     }
 }
 
-}
\ No newline at end of file
+void OsqpSolver::setMaxIterations(int max_iterations) {
+    max_iterations_ = max_iterations;
+}
+
+void OsqpSolver::setHessianMatrix(Eigen::SparseMatrix<double> *matrix_h) const {
+    Triplets triplets;
+    setHessianTriplets(&triplets);
+    buildSparse(numVariables(), numVariables(), triplets, matrix_h);
+}
+
+void OsqpSolver::setConstraintMatrix(Eigen::SparseMatrix<double> *matrix_constraints,
+                                     Eigen::VectorXd *lower_bound,
+                                     Eigen::VectorXd *upper_bound) const {
+    Triplets triplets;
+    setConstraintTriplets(&triplets, lower_bound, upper_bound);
+    buildSparse(numConstraints(), numVariables(), triplets, matrix_constraints);
+}
+
+bool OsqpSolver::loadProblem() {
+    // Set Hessian matrix.
+    hessian_triplets_.clear();
+    setHessianTriplets(&hessian_triplets_);
+    // Set state transition matrix, constraint matrix and bound vector.
+    constraint_triplets_.clear();
+    setConstraintTriplets(&constraint_triplets_, &lower_bound_, &upper_bound_);
+    qp_info_.padded_stages = static_cast<int>(horizon_ - active_horizon_);
+    qp_info_.workspace_reused = solver_.isInitialized() && pattern_horizon_ == horizon_
+        && pattern_control_steps_ == controlSteps() && updateProblem();
+    countQpSetup(qp_info_.workspace_reused);
+    if (qp_info_.workspace_reused) return true;
+
+    if (solver_.isInitialized()) solver_.clearSolver();
+    solver_.data()->clearHessianMatrix();
+    solver_.data()->clearLinearConstraintsMatrix();
+    solver_.settings()->setVerbosity(false);
+    solver_.settings()->setWarmStart(true);
+    const size_t num_variables = numVariables();
+    const size_t num_constraints = numConstraints();
+    solver_.data()->setNumberOfVariables(static_cast<int>(num_variables));
+    solver_.data()->setNumberOfConstraints(static_cast<int>(num_constraints));
+    gradient_.setZero(num_variables);
+    hessian_pattern_.build(num_variables, num_variables, hessian_triplets_, true, &hessian_);
+    constraint_pattern_.build(num_constraints, num_variables, constraint_triplets_, false, &linear_matrix_);
+    pattern_horizon_ = horizon_;
+    pattern_control_steps_ = controlSteps();
+    updateSettings();
+    // Input to solver.
+    return solver_.data()->setHessianMatrix(hessian_)
+        && solver_.data()->setGradient(gradient_)
+        && solver_.data()->setLinearConstraintsMatrix(linear_matrix_)
+        && solver_.data()->setLowerBound(lower_bound_)
+        && solver_.data()->setUpperBound(upper_bound_);
+}
+
+bool OsqpSolver::updateProblem() {
+    if (!hessian_pattern_.fillValues(hessian_triplets_, &hessian_)
+        || !constraint_pattern_.fillValues(constraint_triplets_, &linear_matrix_)) {
+        LOG(WARNING) << "QP entries differ from the last solve of the same size, setting up OSQP again.";
+        return false;
+    }
+    updateSettings();
+    // The gradient is always 0. Same layout, so all values are replaced in the order OSQP stores them.
+    return osqp_update_P_A(solver_.workspace().get(),
+                           hessian_.valuePtr(), OSQP_NULL, static_cast<c_int>(hessian_.nonZeros()),
+                           linear_matrix_.valuePtr(), OSQP_NULL, static_cast<c_int>(linear_matrix_.nonZeros())) == 0
+        && solver_.updateBounds(lower_bound_, upper_bound_);
+}
+
+void OsqpSolver::updateSettings() {
+    const int max_iterations = max_iterations_ > 0 ? max_iterations_ : kOsqpDefaultMaxIterations;
+    // Whatever is left of the deadline after the build. 0 means no limit; the settings outlive the
+    // problem, so it is set on every solve.
+    const auto *deadline = Deadline::current();
+    const double time_limit = deadline && deadline->hasTimeLimit() ? Deadline::currentTimeLimit(HUGE_VAL) : 0.0;
+    if (solver_.isInitialized()) {
+        // The workspace has its own copy of the settings, read at every iteration.
+        solver_.workspace()->settings->max_iter = max_iterations;
+        solver_.workspace()->settings->time_limit = time_limit;
+    } else {
+        solver_.settings()->setMaxIteration(max_iterations);
+        solver_.settings()->setTimeLimit(time_limit);
+    }
+}
+
+const QpInfo &OsqpSolver::getQpInfo() const {
+    return qp_info_;
+}
+
+void OsqpSolver::updateQpInfo() {
+    const auto &workspace = solver_.workspace();
+    if (!workspace || !workspace->info) return;
+    qp_info_.valid = true;
+    qp_info_.status = static_cast<int>(workspace->info->status_val);
+    qp_info_.iterations = static_cast<int>(workspace->info->iter);
+    qp_info_.objective = workspace->info->obj_val;
+    qp_info_.primal_residual = workspace->info->pri_res;
+    qp_info_.dual_residual = workspace->info->dua_res;
+}
+
+}
@@ -3,10 +3,14 @@
 //
 
 #include "path_optimizer/solver/solver_k_as_input.hpp"
+#include "path_optimizer/solver/stage_kernels.hpp"
 #include "path_optimizer/data_struct/data_struct.hpp"
 #include "path_optimizer/data_struct/reference_path.hpp"
+#include "path_optimizer/data_struct/reference_arrays.hpp"
 #include "path_optimizer/data_struct/vehicle_state_frenet.hpp"
 #include "path_optimizer/tools/tools.hpp"
+#include "path_optimizer/tools/tracer.hpp"
+#include "path_optimizer/tools/metrics.hpp"
 #include "path_optimizer/config/planning_flags.hpp"
 
 namespace PathOptimizationNS {
@@ -18,46 +22,34 @@ SolverKAsInput::SolverKAsInput(const ReferencePath &reference_path,
 }
 
 bool SolverKAsInput::solve(std::vector<State> *optimized_path) {
-    const auto &ref_states = reference_path_.getReferenceStates();
-    solver_.settings()->setVerbosity(false);
-    solver_.settings()->setWarmStart(true);
-    solver_.data()->setNumberOfVariables(4 * horizon_ - 1);
-    solver_.data()->setNumberOfConstraints(11 * horizon_ - 1);
-    // Allocate QP problem matrices and vectors.
-    Eigen::SparseMatrix<double> hessian;
-    Eigen::VectorXd gradient = Eigen::VectorXd::Zero(4 * horizon_ - 1);
-    Eigen::SparseMatrix<double> linearMatrix;
-    Eigen::VectorXd lowerBound;
-    Eigen::VectorXd upperBound;
-    // Set Hessian matrix.
-    setHessianMatrix(&hessian);
-    // Set state transition matrix, constraint matrix and bound vector.
-    setConstraintMatrix(
-        &linearMatrix,
-        &lowerBound,
-        &upperBound);
-    // Input to solver.
-    if (!solver_.data()->setHessianMatrix(hessian)) return false;
-    if (!solver_.data()->setGradient(gradient)) return false;
-    if (!solver_.data()->setLinearConstraintsMatrix(linearMatrix)) return false;
-    if (!solver_.data()->setLowerBound(lowerBound)) return false;
-    if (!solver_.data()->setUpperBound(upperBound)) return false;
+    const auto &ref_states = reference_path_.getReferenceArrays();
+    ScopedSpan build_span("SolverKAsInput::build", "qp");
+    ScopedLatency build_latency(stageLatency(PlanningStage::QP_BUILD));
+    if (!loadProblem()) return false;
+    build_span.stop();
+    qp_info_.build_ms = build_latency.stop();
     // Solve.
-    if (!solver_.initSolver()) return false;
-    if (!solver_.solve()) return false;
+    ScopedSpan osqp_span("SolverKAsInput::osqp", "qp");
+    ScopedLatency osqp_latency(stageLatency(PlanningStage::QP_SOLVE));
+    const bool solved = runOsqp();
+    osqp_span.stop();
+    qp_info_.solve_ms = osqp_latency.stop();
+    updateQpInfo();
+    if (!solved) return false;
     const auto &QPSolution = solver_.getSolution();
+    const auto &tangents = reference_path_.getTangents();
     optimized_path->clear();
     double tmp_s = 0;
-    for (size_t i = 0; i != horizon_; ++i) {
-        double angle = ref_states[i].z;
-        double new_angle = constraintAngle(angle + M_PI_2);
-        double tmp_x = ref_states[i].x + QPSolution(2 * i + 1) * cos(new_angle);
-        double tmp_y = ref_states[i].y + QPSolution(2 * i + 1) * sin(new_angle);
+    for (size_t i = 0; i != active_horizon_; ++i) {
+        double angle = ref_states.heading()[i];
+        // Offset along the left normal (-sin, cos) of the reference.
+        double tmp_x = ref_states.x()[i] - QPSolution(2 * i + 1) * tangents[i].y;
+        double tmp_y = ref_states.y()[i] + QPSolution(2 * i + 1) * tangents[i].x;
         double k = 0;
-        if (i != horizon_ - 1) {
+        if (i != active_horizon_ - 1) {
             k = QPSolution(2 * horizon_ + i);
         } else {
-            k = QPSolution(3 * horizon_ - 2);
+            k = QPSolution(2 * horizon_ + active_horizon_ - 2);
         }
         if (i != 0) {
             tmp_s += sqrt(pow(tmp_x - optimized_path->back().x, 2) + pow(tmp_y - optimized_path->back().y, 2));
@@ -67,133 +59,109 @@ bool SolverKAsInput::solve(std::vector<State> *optimized_path) {
     return true;
 }
 
-void SolverKAsInput::setHessianMatrix(Eigen::SparseMatrix<double> *matrix_h) const {
+size_t SolverKAsInput::numVariables() const {
+    return 4 * horizon_ - 1;
+}
+
+size_t SolverKAsInput::numConstraints() const {
+    return 11 * horizon_ - 1;
+}
+
+void SolverKAsInput::setHessianTriplets(Triplets *triplets) const {
     const size_t state_size = 2 * horizon_;
     const size_t control_size = horizon_ - 1;
     const size_t slack_size = horizon_;
-    const size_t matrix_size = state_size + control_size + slack_size;
     double w_c = FLAGS_K_curvature_weight;
     double w_cr = FLAGS_K_curvature_rate_weight;
     double w_pq = FLAGS_K_deviation_weight;
     double w_e = FLAGS_KP_slack_weight;
-    Eigen::MatrixXd hessian = Eigen::MatrixXd::Constant(matrix_size, matrix_size, 0);
+    triplets->reserve(horizon_ + 3 * control_size + slack_size);
     // Populate hessian matrix
     // Matrix Q is for state variables, only related to e_y.
-    Eigen::Matrix2d matrix_Q;
-    matrix_Q << 0, 0,
-        0, w_pq;
-    // Matrix R is for control variables.
-    Eigen::SparseMatrix<double> matrix_R;
-    matrix_R.resize(control_size, control_size);
+    for (size_t i = 0; i != horizon_; ++i) {
+        addTriplet(2 * i + 1, 2 * i + 1, i < active_horizon_ ? w_pq : 0, triplets);
+    }
+    // Matrix R is for control variables, tridiagonal over the active ones. The padded controls do
+    // not act on the state; w_c alone holds them at 0.
+    const size_t active_controls = active_horizon_ - 1;
     for (size_t i = 0; i != control_size; ++i) {
-        for (size_t j = 0; j != control_size; ++j) {
-            if (i == j) {
-                if (i == 0 || i == control_size - 1) {
-                    matrix_R.insert(i, j) = w_c + w_cr;
-                } else {
-                    matrix_R.insert(i, j) = w_cr * 2 + w_c;
-                }
-            } else if (i == j - 1 || i == j + 1) {
-                matrix_R.insert(i, j) = -w_cr;
-            }
+        const size_t index = state_size + i;
+        if (i >= active_controls) {
+            addTriplet(index, index, w_c, triplets);
+        } else if (i == 0 || i == active_controls - 1) {
+            addTriplet(index, index, w_c + w_cr, triplets);
+        } else {
+            addTriplet(index, index, w_cr * 2 + w_c, triplets);
         }
+        if (i != 0) addTriplet(index, index - 1, i < active_controls ? -w_cr : 0, triplets);
+        if (i != control_size - 1) addTriplet(index, index + 1, i + 1 < active_controls ? -w_cr : 0, triplets);
     }
     // Matrix S is for slack variables.
-    Eigen::MatrixXd matrix_S = Eigen::MatrixXd::Identity(slack_size, slack_size) * w_e;
-
-    // Fill Q, R and S into hessian matrix.
-    for (size_t i = 0; i != horizon_; ++i) {
-        hessian.block(2 * i, 2 * i, 2, 2) = matrix_Q;
+    for (size_t i = 0; i != slack_size; ++i) {
+        addTriplet(3 * horizon_ - 1 + i, 3 * horizon_ - 1 + i, w_e, triplets);
     }
-    hessian.block(2 * horizon_, 2 * horizon_, control_size, control_size) = matrix_R;
-    hessian.block(3 * horizon_ - 1, 3 * horizon_ - 1, slack_size, slack_size) = matrix_S;
-    *matrix_h = hessian.sparseView();
 }
 
-void SolverKAsInput::setDynamicMatrix(size_t i,
-                                      Eigen::Matrix<double, 2, 2> *matrix_a,
-                                      Eigen::Matrix<double, 2, 1> *matrix_b) const {
-    const auto &ref_states = reference_path_.getReferenceStates();
-    double ref_k = ref_states[i].k;
-    double ref_s = ref_states[i + 1].s - ref_states[i].s;
-    double ref_delta = atan(ref_k * FLAGS_wheel_base);
-    Eigen::Matrix2d a;
-    a << 1, -ref_s * pow(ref_k, 2),
-        ref_s, 1;
-    Eigen::Matrix<double, 2, 1> b;
-    b << ref_s / FLAGS_wheel_base / pow(cos(ref_delta), 2), 0;
-    *matrix_a = a;
-    *matrix_b = b;
-}
-
-void SolverKAsInput::setConstraintMatrix(Eigen::SparseMatrix<double> *matrix_constraints,
-                                         Eigen::VectorXd *lower_bound,
-                                         Eigen::VectorXd *upper_bound) const {
-    const auto &ref_states = reference_path_.getReferenceStates();
-    Eigen::MatrixXd cons = Eigen::MatrixXd::Zero(11 * horizon_ - 1, 4 * horizon_ - 1);
+void SolverKAsInput::setConstraintTriplets(Triplets *triplets,
+                                           Eigen::VectorXd *lower_bound,
+                                           Eigen::VectorXd *upper_bound) const {
+    const auto &ref_states = reference_path_.getReferenceArrays();
+    *lower_bound = Eigen::VectorXd::Zero(numConstraints());
+    *upper_bound = Eigen::VectorXd::Zero(numConstraints());
+    triplets->reserve(StageKernel<2>::kNonZeros * horizon_ + 4 * horizon_ + 11 * horizon_);
 
-    // Set trans part.
-    for (size_t i = 0; i != 2 * horizon_; ++i) {
-        cons(i, i) = -1;
-    }
-    Eigen::Matrix<double, 2, 2> a;
-    Eigen::Matrix<double, 2, 1> b;
+    // Set trans part, with the initial state bounds.
+    Eigen::Matrix<double, 2, 1> x0;
+    auto init_error = vehicle_state_.getInitError();
+    x0 << init_error[1], init_error[0];
+    addTriplet(0, 0, -1, triplets);
+    addTriplet(1, 1, -1, triplets);
+    lower_bound->segment<2>(0) = -x0;
+    upper_bound->segment<2>(0) = -x0;
+    const StageKernel<2> kernel(FLAGS_wheel_base);
+    StageKernel<2>::StateVector rhs;
     for (size_t i = 0; i != horizon_ - 1; ++i) {
-        setDynamicMatrix(i, &a, &b);
-        cons.block(2 * (i + 1), 2 * i, 2, 2) = a;
-        cons.block(2 * (i + 1), 2 * horizon_ + i, 2, 1) = b;
+        // Padded stages hold the state: A = I, B = 0.
+        const bool active = i + 1 < active_horizon_;
+        const double ds = active ? ref_states.s()[i + 1] - ref_states.s()[i] : 0.0;
+        kernel.emit(i, 2 * horizon_ + i, active ? ref_states.k()[i] : 0.0, ds, triplets, &rhs);
+        lower_bound->segment<2>(2 + 2 * i) = rhs;
+        upper_bound->segment<2>(2 + 2 * i) = rhs;
     }
 
     // Set variable constraint part.
     for (size_t i = 0; i != 4 * horizon_ - 1; ++i) {
-        cons(2 * horizon_ + i, i) = 1;
+        addTriplet(2 * horizon_ + i, i, 1, triplets);
     }
 
     // Set collision avoidance part 1. This part does not include the second circle.
-    Eigen::Matrix<double, 3, 2> collision;
-    collision << FLAGS_d1, 1,
-//        FLAGS_d2, 1,
-        FLAGS_d3, 1,
-        FLAGS_d4, 1;
+    const double part_1_offsets[] = {FLAGS_d1, FLAGS_d3, FLAGS_d4};
     for (size_t i = 0; i != horizon_; ++i) {
-        cons.block(6 * horizon_ - 1 + 3 * i, 2 * i, 3, 2) = collision;
+        for (size_t j = 0; j != 3; ++j) {
+            addTriplet(6 * horizon_ - 1 + 3 * i + j, 2 * i, part_1_offsets[j], triplets);
+            addTriplet(6 * horizon_ - 1 + 3 * i + j, 2 * i + 1, 1, triplets);
+        }
     }
 
     // Set collison avoidance part 2, This part contains the second circle only.
     // The purpose for this is to shrink the drivable corridor and then add a slack variable on it.
-    Eigen::Matrix<double, 1, 2> collision1;
-    collision1 << FLAGS_d2, 1;
     for (size_t i = 0; i != horizon_; ++i) {
-        cons.block(9 * horizon_ - 1 + i, 2 * i, 1, 2) = collision1;
-        cons.block(10 * horizon_ - 1 + i, 2 * i, 1, 2) = collision1;
+        addTriplet(9 * horizon_ - 1 + i, 2 * i, FLAGS_d2, triplets);
+        addTriplet(9 * horizon_ - 1 + i, 2 * i + 1, 1, triplets);
+        addTriplet(9 * horizon_ - 1 + i, 3 * horizon_ - 1 + i, -1, triplets);
+        addTriplet(10 * horizon_ - 1 + i, 2 * i, FLAGS_d2, triplets);
+        addTriplet(10 * horizon_ - 1 + i, 2 * i + 1, 1, triplets);
+        addTriplet(10 * horizon_ - 1 + i, 3 * horizon_ - 1 + i, 1, triplets);
     }
-    cons.block(9 * horizon_ - 1, 3 * horizon_ - 1, horizon_, horizon_) = -Eigen::MatrixXd::Identity(horizon_, horizon_);
-    cons.block(10 * horizon_ - 1, 3 * horizon_ - 1, horizon_, horizon_) = Eigen::MatrixXd::Identity(horizon_, horizon_);
     // Finished.
-    *matrix_constraints = cons.sparseView();
 
-    // Set initial state bounds.
-    *lower_bound = Eigen::MatrixXd::Zero(11 * horizon_ - 1, 1);
-    *upper_bound = Eigen::MatrixXd::Zero(11 * horizon_ - 1, 1);
-    Eigen::Matrix<double, 2, 1> x0;
-    auto init_error = vehicle_state_.getInitError();
-    x0 << init_error[1], init_error[0];
-    lower_bound->block(0, 0, 2, 1) = -x0;
-    upper_bound->block(0, 0, 2, 1) = -x0;
-    for (size_t i = 0; i != horizon_ - 1; ++i) {
-        double ds = ref_states[i + 1].s - ref_states[i].s;
-        double steer = atan(ref_states[i].k * FLAGS_wheel_base);
-        Eigen::Vector2d c;
-        c << ds * steer / FLAGS_wheel_base / pow(cos(steer), 2), 0;
-        lower_bound->block(2 + 2 * i, 0, 2, 1) = c;
-        upper_bound->block(2 + 2 * i, 0, 2, 1) = c;
-    }
     // State variables bounds.
     lower_bound->block(2 * horizon_, 0, 2 * horizon_, 1) = Eigen::VectorXd::Constant(2 * horizon_, -OsqpEigen::INFTY);
     upper_bound->block(2 * horizon_, 0, 2 * horizon_, 1) = Eigen::VectorXd::Constant(2 * horizon_, OsqpEigen::INFTY);
     // Add end state bounds.
     if (FLAGS_constraint_end_heading) {
-        double end_psi = constraintAngle(vehicle_state_.getEndState().z - ref_states.back().z);
+        const double end_heading = ref_states.heading()[active_horizon_ - 1];
+        double end_psi = constraintAngle(vehicle_state_.getEndState().z - end_heading);
         if (end_psi < 70 * M_PI / 180) {
             (*lower_bound)(2 * horizon_ + 2 * horizon_ - 2) = end_psi - 5 * M_PI / 180;
             (*upper_bound)(2 * horizon_ + 2 * horizon_ - 2) = end_psi + 5 * M_PI / 180;
@@ -209,24 +177,17 @@ void SolverKAsInput::setConstraintMatrix(Eigen::SparseMatrix<double> *matrix_con
     upper_bound->block(5 * horizon_ - 1, 0, horizon_, 1) =
         Eigen::VectorXd::Constant(horizon_, FLAGS_expected_safety_margin);
     // Set collision bound part 1.
-    const auto &bounds = reference_path_.getBounds();
-    for (size_t i = 0; i != horizon_; ++i) {
-        Eigen::Vector3d ld, ud;
-        ud
-            << bounds[i].c0.ub, bounds[i].c2.ub, bounds[i].c3.ub;
-        ld
-            << bounds[i].c0.lb, bounds[i].c2.lb, bounds[i].c3.lb;
-        lower_bound->block(6 * horizon_ - 1 + 3 * i, 0, 3, 1) = ld;
-        upper_bound->block(6 * horizon_ - 1 + 3 * i, 0, 3, 1) = ud;
+    // Circles 0, 2 and 3 interleaved per state.
+    const auto &bounds = reference_path_.getBoundArrays();
+    const int part_1_circles[] = {0, 2, 3};
+    for (size_t j = 0; j != 3; ++j) {
+        copyBounds(bounds.lb(part_1_circles[j]), 0, 6 * horizon_ - 1 + j, 3, -OsqpEigen::INFTY, lower_bound);
+        copyBounds(bounds.ub(part_1_circles[j]), 0, 6 * horizon_ - 1 + j, 3, OsqpEigen::INFTY, upper_bound);
     }
     // Set collision bound part 2.
     upper_bound->block(10 * horizon_ - 1, 0, horizon_, 1) = Eigen::VectorXd::Constant(horizon_, OsqpEigen::INFTY);
     lower_bound->block(9 * horizon_ - 1, 0, horizon_, 1) = Eigen::VectorXd::Constant(horizon_, -OsqpEigen::INFTY);
-    for (size_t i = 0; i != horizon_; ++i) {
-        double ud = bounds[i].c1.ub - FLAGS_expected_safety_margin;
-        double ld = bounds[i].c1.lb + FLAGS_expected_safety_margin;
-        (*upper_bound)(9 * horizon_ - 1 + i, 0) = ud;
-        (*lower_bound)(10 * horizon_ - 1 + i, 0) = ld;
-    }
+    copyBounds(bounds.ub(1), -FLAGS_expected_safety_margin, 9 * horizon_ - 1, 1, OsqpEigen::INFTY, upper_bound);
+    copyBounds(bounds.lb(1), FLAGS_expected_safety_margin, 10 * horizon_ - 1, 1, -OsqpEigen::INFTY, lower_bound);
 }
 }
\ No newline at end of file
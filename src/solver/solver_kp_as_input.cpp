@@ -3,122 +3,125 @@
 //
 
 #include "path_optimizer/solver/solver_kp_as_input.hpp"
+#include "path_optimizer/solver/stage_kernels.hpp"
 #include "path_optimizer/data_struct/data_struct.hpp"
 #include "path_optimizer/data_struct/reference_path.hpp"
+#include "path_optimizer/data_struct/reference_arrays.hpp"
 #include "path_optimizer/data_struct/vehicle_state_frenet.hpp"
 #include "path_optimizer/tools/tools.hpp"
+#include "path_optimizer/tools/tracer.hpp"
+#include "path_optimizer/tools/metrics.hpp"
 #include "path_optimizer/config/planning_flags.hpp"
 
 namespace PathOptimizationNS {
 SolverKpAsInput::SolverKpAsInput(const ReferencePath &reference_path,
                                  const VehicleState &vehicle_state,
                                  const size_t &horizon) :
-    OsqpSolver(reference_path, vehicle_state, horizon),
-    keep_control_steps_(std::max(static_cast<int>(1.2 / reference_interval_), 1)),
-    control_horizon_((horizon_ + keep_control_steps_ - 2) / keep_control_steps_),
-    state_size_(3 * horizon_),
-    control_size_(control_horizon_),
-    slack_size_(horizon_) {
+    OsqpSolver(reference_path, vehicle_state, horizon) {
+    updateSizes();
+}
+
+void SolverKpAsInput::updateSizes() {
+    keep_control_steps_ = std::max(static_cast<int>(1.2 / reference_interval_), 1);
+    control_horizon_ = (horizon_ + keep_control_steps_ - 2) / keep_control_steps_;
+    state_size_ = 3 * horizon_;
+    control_size_ = control_horizon_;
+    slack_size_ = horizon_;
     LOG(INFO) << "KP: control horizon is " << control_horizon_;
 }
 
-void SolverKpAsInput::setHessianMatrix(Eigen::SparseMatrix<double> *matrix_h) const {
-    const size_t matrix_size = state_size_ + control_size_ + slack_size_;
-    Eigen::MatrixXd hessian{Eigen::MatrixXd::Constant(matrix_size, matrix_size, 0)};
+size_t SolverKpAsInput::numVariables() const {
+    return state_size_ + control_size_ + slack_size_;
+}
+
+size_t SolverKpAsInput::numConstraints() const {
+    return 10 * horizon_ + control_horizon_ + 2;
+}
+
+int SolverKpAsInput::controlSteps() const {
+    return keep_control_steps_;
+}
+
+void SolverKpAsInput::setHessianTriplets(Triplets *triplets) const {
     double w_c = FLAGS_KP_curvature_weight;
     double w_cr = FLAGS_KP_curvature_rate_weight;
     double w_pq = FLAGS_KP_deviation_weight;
     double w_collision_slack = FLAGS_KP_slack_weight;
+    triplets->reserve(3 * horizon_ + control_horizon_);
     for (size_t i = 0; i != horizon_; ++i) {
-        hessian(3 * i, 3 * i) += w_pq;
-        hessian(3 * i + 2, 3 * i + 2) += w_c;
-        hessian(state_size_ + control_size_ + i, state_size_ + control_size_ + i) += w_collision_slack;
+        // Padded states are copies of the last one.
+        const bool active = i < active_horizon_;
+        addTriplet(3 * i, 3 * i, active ? w_pq : 0, triplets);
+        addTriplet(3 * i + 2, 3 * i + 2, active ? w_c : 0, triplets);
+        addTriplet(state_size_ + control_size_ + i, state_size_ + control_size_ + i, w_collision_slack, triplets);
     }
     for (size_t i = 0; i != control_horizon_; ++i) {
-        hessian(state_size_ + i, state_size_ + i) += keep_control_steps_ * w_cr;
+        addTriplet(state_size_ + i, state_size_ + i, keep_control_steps_ * w_cr, triplets);
     }
-    *matrix_h = hessian.sparseView();
 }
 
-void SolverKpAsInput::setConstraintMatrix(Eigen::SparseMatrix<double> *matrix_constraints,
-                                          Eigen::VectorXd *lower_bound,
-                                          Eigen::VectorXd *upper_bound) const {
-    const auto &ref_states = reference_path_.getReferenceStates();
+void SolverKpAsInput::setConstraintTriplets(Triplets *triplets,
+                                            Eigen::VectorXd *lower_bound,
+                                            Eigen::VectorXd *upper_bound) const {
+    const auto &ref_states = reference_path_.getReferenceArrays();
     const size_t trans_range_begin{0};
     const size_t vars_range_begin{trans_range_begin + 3 * horizon_};
     const size_t collision_range_begin{vars_range_begin + 2 * horizon_ + control_horizon_};
     const size_t end_state_range_begin{collision_range_begin + 5 * horizon_};
-    Eigen::MatrixXd cons = Eigen::MatrixXd::Zero(10 * horizon_ + control_horizon_ + 2, 4 * horizon_ + control_horizon_);
+    const size_t num_constraints{numConstraints()};
+    *lower_bound = Eigen::VectorXd::Zero(num_constraints);
+    *upper_bound = Eigen::VectorXd::Zero(num_constraints);
+    triplets->reserve(StageKernel<3>::kNonZeros * horizon_ + 2 * horizon_ + control_horizon_ + 12 * horizon_ + 2);
     // Set transition part.
-    for (size_t i = 0; i != state_size_; ++i) {
-        cons(i, i) = -1;
+    Eigen::Matrix<double, 3, 1> x0;
+    const auto init_error = vehicle_state_.getInitError();
+    x0 << init_error[0], init_error[1], vehicle_state_.getStartState().k;
+    for (size_t i = 0; i != 3; ++i) {
+        addTriplet(i, i, -1, triplets);
     }
-    Eigen::Matrix3d a(Eigen::Matrix3d::Zero());
-    a(0, 1) = 1;
-    a(1, 2) = 1;
-    Eigen::Matrix<double, 3, 1> b(Eigen::MatrixXd::Constant(3, 1, 0));
-    b(2, 0) = 1;
-    std::vector<Eigen::MatrixXd> c_list;
+    lower_bound->segment<3>(0) = -x0;
+    upper_bound->segment<3>(0) = -x0;
+    const StageKernel<3> kernel;
+    StageKernel<3>::StateVector rhs;
     for (size_t i = 0; i != horizon_ - 1; ++i) {
-        const auto ref_k{ref_states[i].k};
-        const auto ds{ref_states[i + 1].s - ref_states[i].s};
-        const auto ref_kp{(ref_states[i + 1].k - ref_k) / ds};
-        a(1, 0) = -pow(ref_k, 2);
-        auto A{a * ds + Eigen::Matrix3d::Identity()};
-        auto B{b * ds};
-        cons.block(3 * (i + 1), 3 * i, 3, 3) = A;
-        size_t control_index{i / keep_control_steps_};
-        cons.block(3 * (i + 1), state_size_ + control_index, 3, 1) = B;
-        Eigen::Matrix<double, 3, 1> c, ref_state;
-        c << 0, 0, ref_kp;
-        ref_state << 0, 0, ref_k;
-        c_list.emplace_back(ds * (c - a * ref_state - b * ref_kp));
+        // Padded stages hold the state: A = I, B = 0.
+        const bool active = i + 1 < active_horizon_;
+        const auto ds{active ? ref_states.s()[i + 1] - ref_states.s()[i] : 0.0};
+        kernel.emit(i, state_size_ + i / keep_control_steps_, active ? ref_states.k()[i] : 0.0, ds, triplets, &rhs);
+        lower_bound->segment<3>(3 * (i + 1)) = rhs;
+        upper_bound->segment<3>(3 * (i + 1)) = rhs;
     }
 
     // Set vars part.
     for (size_t i = 0; i != horizon_; ++i) {
-        cons(vars_range_begin + i, 3 * i + 2) = 1;
-        cons(vars_range_begin + horizon_ + control_horizon_ + i, state_size_ + control_size_ + i) = 1;
+        addTriplet(vars_range_begin + i, 3 * i + 2, 1, triplets);
+        addTriplet(vars_range_begin + horizon_ + control_horizon_ + i, state_size_ + control_size_ + i, 1, triplets);
     }
     for (size_t i = 0; i != control_size_; ++i) {
-        cons(vars_range_begin + horizon_ + i, state_size_ + i) = 1;
+        addTriplet(vars_range_begin + horizon_ + i, state_size_ + i, 1, triplets);
     }
 
     // Set collision part.
-    Eigen::Matrix<double, 3, 2> collision;
-    collision << 1, FLAGS_d1,
-        1, FLAGS_d2,
-//        1, FLAGS_d3,
-        1, FLAGS_d4;
+    // Circles 0, 1 and 3 interleaved per state, then circle 2 with the slack.
+    const double interleaved_offsets[] = {FLAGS_d1, FLAGS_d2, FLAGS_d4};
     for (size_t i = 0; i != horizon_; ++i) {
-        cons.block(collision_range_begin + 3 * i, 3 * i, 3, 2) = collision;
+        for (size_t j = 0; j != 3; ++j) {
+            addTriplet(collision_range_begin + 3 * i + j, 3 * i, 1, triplets);
+            addTriplet(collision_range_begin + 3 * i + j, 3 * i + 1, interleaved_offsets[j], triplets);
+        }
     }
-    Eigen::Matrix<double, 1, 2> collision1;
-    collision1 << 1, FLAGS_d3;
     for (size_t i = 0; i != horizon_; ++i) {
-        cons.block(collision_range_begin + 3 * horizon_ + i, 3 * i, 1, 2) = collision1;
-        cons(collision_range_begin + 3 * horizon_ + i, state_size_ + control_size_ + i) = -1;
-        cons.block(collision_range_begin + 4 * horizon_ + i, 3 * i, 1, 2) = collision1;
-        cons(collision_range_begin + 4 * horizon_ + i, state_size_ + control_size_ + i) = 1;
+        addTriplet(collision_range_begin + 3 * horizon_ + i, 3 * i, 1, triplets);
+        addTriplet(collision_range_begin + 3 * horizon_ + i, 3 * i + 1, FLAGS_d3, triplets);
+        addTriplet(collision_range_begin + 3 * horizon_ + i, state_size_ + control_size_ + i, -1, triplets);
+        addTriplet(collision_range_begin + 4 * horizon_ + i, 3 * i, 1, triplets);
+        addTriplet(collision_range_begin + 4 * horizon_ + i, 3 * i + 1, FLAGS_d3, triplets);
+        addTriplet(collision_range_begin + 4 * horizon_ + i, state_size_ + control_size_ + i, 1, triplets);
     }
 
     // End state.
-    cons(end_state_range_begin, state_size_ - 3) = 1; // end ey
-    cons(end_state_range_begin + 1, state_size_ - 2) = 1; // end ephi
-    *matrix_constraints = cons.sparseView();
-
-    // Set bounds.
-    *lower_bound = Eigen::MatrixXd::Zero(10 * horizon_ + control_horizon_ + 2, 1);
-    *upper_bound = Eigen::MatrixXd::Zero(10 * horizon_ + control_horizon_ + 2, 1);
-    Eigen::Matrix<double, 3, 1> x0;
-    const auto init_error = vehicle_state_.getInitError();
-    x0 << init_error[0], init_error[1], vehicle_state_.getStartState().k;
-    lower_bound->block(0, 0, 3, 1) = -x0;
-    upper_bound->block(0, 0, 3, 1) = -x0;
-    for (size_t i = 0; i != horizon_ - 1; ++i) {
-        lower_bound->block(3 * (i + 1), 0, 3, 1) = -c_list[i];
-        upper_bound->block(3 * (i + 1), 0, 3, 1) = -c_list[i];
-    }
+    addTriplet(end_state_range_begin, state_size_ - 3, 1, triplets); // end ey
+    addTriplet(end_state_range_begin + 1, state_size_ - 2, 1, triplets); // end ephi
 
     // Vars bound.
     for (size_t i = 0; i != horizon_; ++i) {
@@ -133,22 +136,20 @@ void SolverKpAsInput::setConstraintMatrix(Eigen::SparseMatrix<double> *matrix_co
     }
 
     // Collision bound.
-    const auto &bounds = reference_path_.getBounds();
-    for (size_t i = 0; i != horizon_; ++i) {
-        Eigen::Vector3d ld, ud;
-        ud
-            << bounds[i].c0.ub, bounds[i].c1.ub, bounds[i].c3.ub;
-        ld
-            << bounds[i].c0.lb, bounds[i].c1.lb, bounds[i].c3.lb;
-        lower_bound->block(collision_range_begin + 3 * i, 0, 3, 1) = ld;
-        upper_bound->block(collision_range_begin + 3 * i, 0, 3, 1) = ud;
-        double uds = bounds[i].c2.ub - FLAGS_expected_safety_margin;
-        double lds = bounds[i].c2.lb + FLAGS_expected_safety_margin;
-        (*upper_bound)(collision_range_begin + 3 * horizon_ + i, 0) = uds;
-        (*lower_bound)(collision_range_begin + 3 * horizon_ + i, 0) = -OsqpEigen::INFTY;
-        (*lower_bound)(collision_range_begin + 4 * horizon_ + i, 0) = lds;
-        (*upper_bound)(collision_range_begin + 4 * horizon_ + i, 0) = OsqpEigen::INFTY;
+    const auto &bounds = reference_path_.getBoundArrays();
+    const int interleaved_circles[] = {0, 1, 3};
+    for (size_t j = 0; j != 3; ++j) {
+        copyBounds(bounds.lb(interleaved_circles[j]), 0, collision_range_begin + j, 3, -OsqpEigen::INFTY,
+                   lower_bound);
+        copyBounds(bounds.ub(interleaved_circles[j]), 0, collision_range_begin + j, 3, OsqpEigen::INFTY,
+                   upper_bound);
     }
+    copyBounds(bounds.ub(2), -FLAGS_expected_safety_margin, collision_range_begin + 3 * horizon_, 1,
+               OsqpEigen::INFTY, upper_bound);
+    lower_bound->segment(collision_range_begin + 3 * horizon_, horizon_).setConstant(-OsqpEigen::INFTY);
+    copyBounds(bounds.lb(2), FLAGS_expected_safety_margin, collision_range_begin + 4 * horizon_, 1,
+               -OsqpEigen::INFTY, lower_bound);
+    upper_bound->segment(collision_range_begin + 4 * horizon_, horizon_).setConstant(OsqpEigen::INFTY);
 
     // End state.
     // End ey is not constrained.
@@ -157,7 +158,8 @@ void SolverKpAsInput::setConstraintMatrix(Eigen::SparseMatrix<double> *matrix_co
     (*lower_bound)(end_state_range_begin + 1) = -OsqpEigen::INFTY;
     (*upper_bound)(end_state_range_begin + 1) = OsqpEigen::INFTY;
     if (FLAGS_constraint_end_heading) {
-        double end_psi = constraintAngle(vehicle_state_.getEndState().z - ref_states.back().z);
+        const double end_heading = ref_states.heading()[active_horizon_ - 1];
+        double end_psi = constraintAngle(vehicle_state_.getEndState().z - end_heading);
         if (end_psi < 70 * M_PI / 180) {
             (*lower_bound)(end_state_range_begin + 1) = end_psi - 5 * M_PI / 180;
             (*upper_bound)(end_state_range_begin + 1) = end_psi + 5 * M_PI / 180;
@@ -167,41 +169,29 @@ void SolverKpAsInput::setConstraintMatrix(Eigen::SparseMatrix<double> *matrix_co
 }
 
 bool SolverKpAsInput::solve(std::vector<PathOptimizationNS::State> *optimized_path) {
-    const auto &ref_states = reference_path_.getReferenceStates();
-    solver_.settings()->setVerbosity(false);
-    solver_.settings()->setWarmStart(true);
-    solver_.data()->setNumberOfVariables(state_size_ + control_size_ + slack_size_);
-    solver_.data()->setNumberOfConstraints(10 * horizon_ + control_horizon_ + 2);
-    // Allocate QP problem matrices and vectors.
-    Eigen::SparseMatrix<double> hessian;
-    Eigen::VectorXd gradient = Eigen::VectorXd::Zero(state_size_ + control_size_ + slack_size_);
-    Eigen::SparseMatrix<double> linearMatrix;
-    Eigen::VectorXd lowerBound;
-    Eigen::VectorXd upperBound;
-    // Set Hessian matrix.
-    setHessianMatrix(&hessian);
-    // Set state transition matrix, constraint matrix and bound vector.
-    setConstraintMatrix(
-        &linearMatrix,
-        &lowerBound,
-        &upperBound);
-    // Input to solver.
-    if (!solver_.data()->setHessianMatrix(hessian)) return false;
-    if (!solver_.data()->setGradient(gradient)) return false;
-    if (!solver_.data()->setLinearConstraintsMatrix(linearMatrix)) return false;
-    if (!solver_.data()->setLowerBound(lowerBound)) return false;
-    if (!solver_.data()->setUpperBound(upperBound)) return false;
+    const auto &ref_states = reference_path_.getReferenceArrays();
+    ScopedSpan build_span("SolverKpAsInput::build", "qp");
+    ScopedLatency build_latency(stageLatency(PlanningStage::QP_BUILD));
+    if (!loadProblem()) return false;
+    build_span.stop();
+    qp_info_.build_ms = build_latency.stop();
     // Solve.
-    if (!solver_.initSolver()) return false;
-    if (!solver_.solve()) return false;
+    ScopedSpan osqp_span("SolverKpAsInput::osqp", "qp");
+    ScopedLatency osqp_latency(stageLatency(PlanningStage::QP_SOLVE));
+    const bool solved = runOsqp();
+    osqp_span.stop();
+    qp_info_.solve_ms = osqp_latency.stop();
+    updateQpInfo();
+    if (!solved) return false;
     const auto &QPSolution = solver_.getSolution();
+    const auto &tangents = reference_path_.getTangents();
     optimized_path->clear();
     double tmp_s = 0;
-    for (size_t i = 0; i != horizon_; ++i) {
-        double angle = ref_states[i].z;
-        double new_angle = constraintAngle(angle + M_PI_2);
-        double tmp_x = ref_states[i].x + QPSolution(3 * i) * cos(new_angle);
-        double tmp_y = ref_states[i].y + QPSolution(3 * i) * sin(new_angle);
+    for (size_t i = 0; i != active_horizon_; ++i) {
+        double angle = ref_states.heading()[i];
+        // Offset along the left normal (-sin, cos) of the reference.
+        double tmp_x = ref_states.x()[i] - QPSolution(3 * i) * tangents[i].y;
+        double tmp_y = ref_states.y()[i] + QPSolution(3 * i) * tangents[i].x;
         double k = QPSolution(3 * i + 2);
         if (i != 0) {
             tmp_s += sqrt(pow(tmp_x - optimized_path->back().x, 2) + pow(tmp_y - optimized_path->back().y, 2));
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <glog/logging.h>
+#include "path_optimizer/solver/sparsity_pattern.hpp"
+
+namespace PathOptimizationNS {
+
+void SparsityPattern::build(std::size_t rows, std::size_t cols, const Triplets &triplets,
+                            bool upper_triangular, Eigen::SparseMatrix<double> *matrix) {
+    if (upper_triangular) {
+        Triplets upper;
+        upper.reserve(triplets.size());
+        for (const auto &triplet : triplets) {
+            if (triplet.row() <= triplet.col()) upper.push_back(triplet);
+        }
+        buildSparse(rows, cols, upper, matrix);
+    } else {
+        buildSparse(rows, cols, triplets, matrix);
+    }
+    CHECK(matrix->isCompressed());
+    // Rows are sorted within each column after setFromTriplets.
+    const int *outer = matrix->outerIndexPtr();
+    const int *inner = matrix->innerIndexPtr();
+    positions_.resize(triplets.size());
+    for (std::size_t i = 0; i != triplets.size(); ++i) {
+        const auto &triplet = triplets[i];
+        if (upper_triangular && triplet.row() > triplet.col()) {
+            positions_[i] = -1;
+            continue;
+        }
+        const int *row = std::lower_bound(inner + outer[triplet.col()], inner + outer[triplet.col() + 1],
+                                          triplet.row());
+        positions_[i] = static_cast<int>(row - inner);
+    }
+    non_zeros_ = static_cast<std::size_t>(matrix->nonZeros());
+}
+
+bool SparsityPattern::fillValues(const Triplets &triplets, Eigen::SparseMatrix<double> *matrix) const {
+    if (positions_.empty() || triplets.size() != positions_.size()
+        || static_cast<std::size_t>(matrix->nonZeros()) != non_zeros_) {
+        return false;
+    }
+    double *values = matrix->valuePtr();
+    std::fill(values, values + non_zeros_, 0.0);
+    // Duplicates are summed, as in setFromTriplets.
+    for (std::size_t i = 0; i != triplets.size(); ++i) {
+        if (positions_[i] < 0) continue;
+        DCHECK_EQ(matrix->innerIndexPtr()[positions_[i]], triplets[i].row());
+        values[positions_[i]] += triplets[i].value();
+    }
+    return true;
+}
+
+}
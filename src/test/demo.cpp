@@ -25,9 +25,10 @@
 #include "opencv2/core/eigen.hpp"
 #include "opencv2/opencv.hpp"
 #include "path_optimizer/path_optimizer.hpp"
-#include "path_optimizer/tools/eigen2cv.hpp"
+#include "path_optimizer/tools/Map.hpp"
 #include "path_optimizer/data_struct/data_struct.hpp"
 #include "path_optimizer/tools/tools.hpp"
+#include "path_optimizer/tools/tracer.hpp"
 
 PathOptimizationNS::State start_state, end_state;
 std::vector<PathOptimizationNS::State> reference_path;
@@ -69,6 +70,7 @@ void goalCb(const geometry_msgs::PoseStampedConstPtr &goal) {
 
 int main(int argc, char **argv) {
     ros::init(argc, argv, "path_optimization");
+    google::ParseCommandLineFlags(&argc, &argv, true);
     ros::NodeHandle nh("~");
 
     std::string base_dir = ros::package::getPath("path_optimizer");
@@ -101,11 +103,7 @@ int main(int argc, char **argv) {
     grid_map::GridMapCvConverter::addLayerFromImage<unsigned char, 1>(
         img_src, "obstacle", grid_map, OCCUPY, FREE, 0.5);
     // Update distance layer.
-    Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> binary =
-        grid_map.get("obstacle").cast<unsigned char>();
-    cv::distanceTransform(eigen2cv(binary), eigen2cv(grid_map.get("distance")),
-                          CV_DIST_L2, CV_DIST_MASK_PRECISE);
-    grid_map.get("distance") *= resolution;
+    PathOptimizationNS::Map::buildSignedDistanceField(&grid_map);
     grid_map.setFrameId("/map");
 
     // Set publishers.
@@ -123,6 +121,9 @@ int main(int argc, char **argv) {
     ros_viz_tools::RosVizTools markers(nh, "markers");
     std::string marker_frame_id = "/map";
 
+    // One optimizer for all cycles, updated with the latest start and goal.
+    PathOptimizationNS::PathOptimizer path_optimizer(start_state, end_state, grid_map);
+
     // Loop.
     ros::Rate rate(30.0);
     while (nh.ok()) {
@@ -187,15 +188,20 @@ int main(int argc, char **argv) {
         if (reference_rcv && start_state_rcv && end_state_rcv) {
             FLAGS_enable_searching = true;
             FLAGS_optimization_method = "KP";
-            PathOptimizationNS::PathOptimizer path_optimizer(start_state, end_state, grid_map);
-            if (path_optimizer.solve(reference_path, &result_path)) {
-                std::cout << "ok!" << std::endl;
+            FLAGS_enable_debug_output = true;
+            path_optimizer.setStartState(start_state);
+            path_optimizer.setGoal(end_state);
+            auto result = path_optimizer.solve(reference_path, &result_path);
+            if (result) {
+                std::cout << "ok! QP iterations: " << result.qp.iterations << std::endl;
                 // Test solveWithoutSmoothing:
 //                path_optimizer.solveWithoutSmoothing(result_path, &result_path);
+            } else {
+                std::cout << "failed: " << PathOptimizationNS::toString(result.status) << std::endl;
             }
-            smoothed_reference_path = path_optimizer.getSmoothedPath();
-            abnormal_bounds = path_optimizer.display_abnormal_bounds();
-            a_star_display = path_optimizer.getSearchResult();
+            smoothed_reference_path = result.debug->smoothed_path;
+            abnormal_bounds = result.debug->abnormal_bounds;
+            a_star_display = result.debug->search_result;
         }
 
         // Visualize a-star.
@@ -322,6 +328,7 @@ int main(int argc, char **argv) {
         rate.sleep();
     }
 
+    if (!FLAGS_trace_file.empty()) PathOptimizationNS::Tracer::instance().dumpChromeTrace(FLAGS_trace_file);
     google::ShutdownGoogleLogging();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,522 @@
+// Micro-benchmarks of the hot kernels, each in isolation, so a regression of path_optimizer_benchmark
+// can be traced to the kernel that caused it:
+//   path_optimizer_kernel_benchmark --benchmark_filter=BM_solver --scenario=scenarios/benchmark_route.scenario
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "path_optimizer/config/planning_flags.hpp"
+#include "path_optimizer/data_struct/data_struct.hpp"
+#include "path_optimizer/data_struct/reference_path.hpp"
+#include "path_optimizer/data_struct/reference_path_impl.hpp"
+#include "path_optimizer/data_struct/vehicle_state_frenet.hpp"
+#include "path_optimizer/reference_path_smoother/reference_path_smoother.hpp"
+#include "path_optimizer/solver/solver.hpp"
+#include "path_optimizer/tools/collosion_checker.hpp"
+#include "path_optimizer/tools/eigen2cv.hpp"
+#include "path_optimizer/tools/Map.hpp"
+#include "path_optimizer/tools/map_window.hpp"
+#include "path_optimizer/tools/scenario.hpp"
+#include "path_optimizer/tools/scenario_generator.hpp"
+#include "path_optimizer/tools/spline.h"
+#include "path_optimizer/tools/tools.hpp"
+#include "path_optimizer/tools/tracer.hpp"
+
+DEFINE_string(scenario, "scenarios/benchmark_route.scenario", "map and route for the map query benchmarks");
+
+namespace {
+
+using namespace PathOptimizationNS;
+
+const Scenario &benchmarkScenario() {
+    static Scenario scenario;
+    static bool loaded = loadScenario(FLAGS_scenario, &scenario);
+    CHECK(loaded) << "Cannot load " << FLAGS_scenario;
+    return scenario;
+}
+
+// Reference states along the scenario route, with heading, for bound search and collision check.
+std::vector<State> routeStates(const Scenario &scenario) {
+    std::vector<State> states(scenario.reference_points);
+    for (size_t i = 0; i != states.size(); ++i) {
+        const auto &next = states[std::min(i + 1, states.size() - 1)];
+        const auto &prev = states[i == 0 ? 0 : i - 1];
+        states[i].z = atan2(next.y - prev.y, next.x - prev.x);
+    }
+    return states;
+}
+
+std::vector<State> routeStates() {
+    return routeStates(benchmarkScenario());
+}
+
+// A gently curving road of n states, 0.5 m apart, between two walls 4 m from the center line.
+struct Road {
+    explicit Road(size_t n) {
+        const double delta_s = 0.5;
+        State state;
+        for (size_t i = 0; i != n; ++i) {
+            state.s = i * delta_s;
+            state.z = 0.2 * sin(state.s / 20);
+            state.k = 0.01 * cos(state.s / 20);
+            states.emplace_back(state);
+            state.x += delta_s * cos(state.z);
+            state.y += delta_s * sin(state.z);
+        }
+        const double resolution = 0.2;
+        map.setGeometry(grid_map::Length(states.back().x + 40, 60), resolution,
+                        grid_map::Position(states.back().x / 2, 0));
+        map.add("distance");
+        auto &distance = map.get("distance");
+        for (int r = 0; r != distance.rows(); ++r) {
+            for (int c = 0; c != distance.cols(); ++c) {
+                grid_map::Position position;
+                map.getPosition(grid_map::Index(r, c), position);
+                distance(r, c) = static_cast<float>(std::max(0.0, 4.0 - std::fabs(position.y())));
+            }
+        }
+    }
+    std::vector<State> states;
+    grid_map::GridMap map;
+};
+
+const Road &road(size_t n) {
+    static std::vector<std::unique_ptr<Road>> roads;
+    for (const auto &road : roads) {
+        if (road->states.size() == n) return *road;
+    }
+    roads.emplace_back(new Road(n));
+    return *roads.back();
+}
+
+void splineKnots(size_t n, std::vector<double> *s, std::vector<double> *y) {
+    for (size_t i = 0; i != n; ++i) {
+        s->emplace_back(i * 0.5);
+        y->emplace_back(sin(i * 0.05));
+    }
+}
+
+void BM_splineSetPoints(benchmark::State &state) {
+    std::vector<double> s, y;
+    splineKnots(static_cast<size_t>(state.range(0)), &s, &y);
+    for (auto _ : state) {
+        tk::spline spline;
+        spline.set_points(s, y);
+        benchmark::DoNotOptimize(spline);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_splineSetPoints)->Arg(100)->Arg(1000)->Arg(10000);
+
+void BM_splineEvaluate(benchmark::State &state) {
+    std::vector<double> s, y;
+    splineKnots(static_cast<size_t>(state.range(0)), &s, &y);
+    tk::spline spline;
+    spline.set_points(s, y);
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<double> distribution(0, s.back());
+    std::vector<double> queries(1024);
+    for (auto &query : queries) query = distribution(generator);
+    for (auto _ : state) {
+        for (double query : queries) benchmark::DoNotOptimize(spline(query));
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_splineEvaluate)->Arg(100)->Arg(1000)->Arg(10000);
+
+// Argument: FLAGS_distance_layer_bits, 0 for the float layer.
+void BM_getObstacleDistance(benchmark::State &state) {
+    google::FlagSaver flag_saver;
+    FLAGS_distance_layer_bits = static_cast<int>(state.range(0));
+    const auto &grid_map = benchmarkScenario().map;
+    Map map(grid_map);
+    std::mt19937 generator(0);
+    const auto &center = grid_map.getPosition();
+    const auto &length = grid_map.getLength();
+    std::uniform_real_distribution<double> x(center.x() - length.x() / 2, center.x() + length.x() / 2);
+    std::uniform_real_distribution<double> y(center.y() - length.y() / 2, center.y() + length.y() / 2);
+    std::vector<grid_map::Position> queries(1024);
+    for (auto &query : queries) query = grid_map::Position(x(generator), y(generator));
+    for (auto _ : state) {
+        for (const auto &query : queries) benchmark::DoNotOptimize(map.getObstacleDistance(query));
+    }
+    state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_getObstacleDistance)->Arg(0)->Arg(8)->Arg(16);
+
+// Square obstacle grid of n x n cells with 0.1% occupied cells, plus an empty distance layer.
+grid_map::GridMap &obstacleGrid(int n) {
+    static std::vector<std::unique_ptr<grid_map::GridMap>> grids;
+    for (const auto &grid : grids) {
+        if (grid->getSize()(0) == n) return *grid;
+    }
+    grids.emplace_back(new grid_map::GridMap(std::vector<std::string>{"obstacle", "distance"}));
+    auto &grid = *grids.back();
+    grid.setGeometry(grid_map::Length(n * 0.2, n * 0.2), 0.2, grid_map::Position::Zero());
+    std::mt19937 generator(0);
+    auto &obstacle = grid.get("obstacle");
+    for (int i = 0; i != obstacle.size(); ++i) obstacle.data()[i] = generator() % 1000 ? 255 : 0;
+    return grid;
+}
+
+// Arguments: grid size and thread number (0: all cores).
+void BM_buildDistanceField(benchmark::State &state) {
+    auto &grid = obstacleGrid(static_cast<int>(state.range(0)));
+    const auto threads = static_cast<unsigned int>(state.range(1));
+    for (auto _ : state) {
+        Map::buildDistanceField(&grid, "obstacle", "distance", threads);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+}
+BENCHMARK(BM_buildDistanceField)
+    ->Args({1024, 1})->Args({1024, 0})->Args({4096, 1})->Args({4096, 0})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The OpenCV path buildDistanceField replaced: cast, eigen2cv, cv::distanceTransform and scaling.
+void BM_opencvDistanceTransform(benchmark::State &state) {
+    auto &grid = obstacleGrid(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> binary =
+            grid.get("obstacle").cast<unsigned char>();
+        cv::distanceTransform(eigen2cv(binary), eigen2cv(grid.get("distance")), cv::DIST_L2, cv::DIST_MASK_PRECISE);
+        grid.get("distance") *= grid.getResolution();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(0));
+}
+BENCHMARK(BM_opencvDistanceTransform)->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Argument: FLAGS_distance_layer_bits.
+void BM_getClearanceWithDirectionStrict(benchmark::State &state) {
+    google::FlagSaver flag_saver;
+    FLAGS_distance_layer_bits = static_cast<int>(state.range(0));
+    updateConfig();
+    Map map(benchmarkScenario().map);
+    ReferencePathImpl reference_path;
+    const auto states = routeStates();
+    for (auto _ : state) {
+        for (const auto &route_state : states) {
+            benchmark::DoNotOptimize(reference_path.getClearanceWithDirectionStrict(route_state, map));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * states.size());
+}
+BENCHMARK(BM_getClearanceWithDirectionStrict)->Arg(0)->Arg(8)->Arg(16);
+
+// ReferencePath::updateBounds on the scenario route. It offsets the circle centers and the lateral steps of
+// each station along the precomputed unit tangents of ReferencePath::getTangents().
+void BM_updateBounds(benchmark::State &state) {
+    updateConfig();
+    const auto &scenario = benchmarkScenario();
+    Map map(scenario.map);
+    ReferencePath reference_path;
+    for (auto _ : state) {
+        // updateBounds truncates the reference where it is blocked.
+        state.PauseTiming();
+        reference_path.setReference(scenario.reference_points);
+        state.ResumeTiming();
+        reference_path.updateBounds(map);
+    }
+    state.SetItemsProcessed(state.iterations() * scenario.reference_points.size());
+}
+BENCHMARK(BM_updateBounds)->Unit(benchmark::kMillisecond);
+
+void BM_isSingleStateCollisionFreeImproved(benchmark::State &state) {
+    updateConfig();
+    CollisionChecker collision_checker(benchmarkScenario().map);
+    const auto states = routeStates();
+    for (auto _ : state) {
+        for (const auto &route_state : states) {
+            benchmark::DoNotOptimize(collision_checker.isSingleStateCollisionFreeImproved(route_state));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * states.size());
+}
+BENCHMARK(BM_isSingleStateCollisionFreeImproved);
+
+const char *const kLayouts[] = {"column_major", "tiled", "morton"};
+
+// 800 m x 800 m synthetic map, 4000 x 4000 cells, far larger than the caches.
+const Scenario &largeScenario() {
+    static Scenario scenario;
+    static bool generated = [] {
+        SyntheticScenarioConfig config;
+        config.map_size = 800;
+        config.route_length = 600;
+        return generateScenario(config, &scenario);
+    }();
+    CHECK(generated) << "Cannot generate the large scenario";
+    return scenario;
+}
+
+// Argument: FLAGS_distance_layer_layout (0: column_major, 1: tiled, 2: morton).
+void BM_updateBoundsLayout(benchmark::State &state) {
+    google::FlagSaver flag_saver;
+    FLAGS_distance_layer_layout = kLayouts[state.range(0)];
+    updateConfig();
+    const auto &scenario = largeScenario();
+    Map map(scenario.map);
+    ReferencePath reference_path;
+    state.SetLabel(kLayouts[state.range(0)]);
+    for (auto _ : state) {
+        // updateBounds truncates the reference where it is blocked.
+        state.PauseTiming();
+        reference_path.setReference(scenario.reference_points);
+        state.ResumeTiming();
+        reference_path.updateBounds(map);
+    }
+    state.SetItemsProcessed(state.iterations() * scenario.reference_points.size());
+}
+BENCHMARK(BM_updateBoundsLayout)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+void BM_collisionCheckLayout(benchmark::State &state) {
+    google::FlagSaver flag_saver;
+    FLAGS_distance_layer_layout = kLayouts[state.range(0)];
+    updateConfig();
+    const auto &scenario = largeScenario();
+    CollisionChecker collision_checker{Map(scenario.map)};
+    const auto states = routeStates(scenario);
+    state.SetLabel(kLayouts[state.range(0)]);
+    for (auto _ : state) {
+        for (const auto &route_state : states) {
+            benchmark::DoNotOptimize(collision_checker.isSingleStateCollisionFreeImproved(route_state));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * states.size());
+}
+BENCHMARK(BM_collisionCheckLayout)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+
+// Argument: FLAGS_distance_pyramid_levels.
+void BM_updateBoundsPyramid(benchmark::State &state) {
+    google::FlagSaver flag_saver;
+    FLAGS_distance_pyramid_levels = static_cast<int>(state.range(0));
+    updateConfig();
+    const auto &scenario = largeScenario();
+    Map map(scenario.map);
+    ReferencePath reference_path;
+    for (auto _ : state) {
+        state.PauseTiming();
+        reference_path.setReference(scenario.reference_points);
+        state.ResumeTiming();
+        reference_path.updateBounds(map);
+    }
+    state.SetItemsProcessed(state.iterations() * scenario.reference_points.size());
+}
+BENCHMARK(BM_updateBoundsPyramid)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+// Argument: 1 to query a MapWindow around the route instead of the whole grid map.
+void BM_updateBoundsWindow(benchmark::State &state) {
+    updateConfig();
+    const auto &scenario = largeScenario();
+    std::shared_ptr<const MapBackend> backend;
+    if (state.range(0)) {
+        const auto window = MapWindow::aroundRoute(scenario.map, scenario.reference_points);
+        state.counters["touched_mb"] = window->touchedBytes() / 1e6;
+        backend = window;
+    } else {
+        backend = std::make_shared<GridMapBackend>(scenario.map);
+    }
+    Map map(backend);
+    ReferencePath reference_path;
+    for (auto _ : state) {
+        state.PauseTiming();
+        reference_path.setReference(scenario.reference_points);
+        state.ResumeTiming();
+        reference_path.updateBounds(map);
+    }
+    state.SetItemsProcessed(state.iterations() * scenario.reference_points.size());
+}
+BENCHMARK(BM_updateBoundsWindow)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Runs only the lattice search of ReferencePathSmoother.
+class SearchOnlySmoother : public ReferencePathSmoother {
+ public:
+    SearchOnlySmoother(const std::vector<State> &input_points, const State &start_state, const Map &grid_map) :
+        ReferencePathSmoother(input_points, start_state, grid_map) {
+        bSpline();
+        x_ = x_list_;
+        y_ = y_list_;
+        s_ = s_list_;
+    }
+    void reset() {
+        x_list_ = x_;
+        y_list_ = y_;
+        s_list_ = s_;
+    }
+    bool search() {
+        return modifyInputPoints();
+    }
+
+ private:
+    bool smooth(ReferencePath *reference_path, std::vector<State> *smoothed_path_display) override {
+        return true;
+    }
+    std::vector<double> x_, y_, s_;
+};
+
+// Arguments: longitudinal and lateral lattice spacing, in cm.
+void BM_modifyInputPoints(benchmark::State &state) {
+    google::FlagSaver flag_saver;
+    FLAGS_search_longitudial_spacing = state.range(0) / 100.0;
+    FLAGS_search_lateral_spacing = state.range(1) / 100.0;
+    updateConfig();
+    const auto &scenario = benchmarkScenario();
+    Map map(scenario.map);
+    SearchOnlySmoother smoother(scenario.reference_points, scenario.start, map);
+    for (auto _ : state) {
+        state.PauseTiming();
+        smoother.reset();
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(smoother.search());
+    }
+}
+BENCHMARK(BM_modifyInputPoints)
+    ->Args({300, 120})->Args({150, 60})->Args({100, 40})->Args({50, 20})
+    ->Unit(benchmark::kMillisecond);
+
+// Argument: FLAGS_distance_pyramid_levels, for the obstacle cost of the search.
+void BM_modifyInputPointsPyramid(benchmark::State &state) {
+    google::FlagSaver flag_saver;
+    FLAGS_distance_pyramid_levels = static_cast<int>(state.range(0));
+    updateConfig();
+    const auto &scenario = benchmarkScenario();
+    Map map(scenario.map);
+    SearchOnlySmoother smoother(scenario.reference_points, scenario.start, map);
+    for (auto _ : state) {
+        state.PauseTiming();
+        smoother.reset();
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(smoother.search());
+    }
+}
+BENCHMARK(BM_modifyInputPointsPyramid)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+const char *const kSolverTypes[] = {"K", "KP", "KPC"};
+
+struct SolverProblem {
+    SolverProblem(size_t horizon) :
+        vehicle_state(road(horizon).states.front(), road(horizon).states.back(), 0, 0) {
+        updateConfig();
+        const auto &problem_road = road(horizon);
+        reference_path.setReference(problem_road.states);
+        reference_path.updateBounds(Map(problem_road.map));
+        reference_path.updateLimits();
+    }
+    std::unique_ptr<OsqpSolver> create(int type) {
+        std::string name(kSolverTypes[type]);
+        return OsqpSolver::create(name, reference_path, vehicle_state, reference_path.getSize());
+    }
+    ReferencePath reference_path;
+    VehicleState vehicle_state;
+};
+
+// Arguments: solver type (0: K, 1: KP, 2: KPC) and horizon.
+void BM_solverSetHessianMatrix(benchmark::State &state) {
+    SolverProblem problem(static_cast<size_t>(state.range(1)));
+    auto solver = problem.create(static_cast<int>(state.range(0)));
+    state.SetLabel(kSolverTypes[state.range(0)]);
+    for (auto _ : state) {
+        Eigen::SparseMatrix<double> hessian;
+        solver->setHessianMatrix(&hessian);
+        benchmark::DoNotOptimize(hessian);
+    }
+}
+
+void BM_solverSetConstraintMatrix(benchmark::State &state) {
+    SolverProblem problem(static_cast<size_t>(state.range(1)));
+    auto solver = problem.create(static_cast<int>(state.range(0)));
+    state.SetLabel(kSolverTypes[state.range(0)]);
+    for (auto _ : state) {
+        Eigen::SparseMatrix<double> constraints;
+        Eigen::VectorXd lower_bound, upper_bound;
+        solver->setConstraintMatrix(&constraints, &lower_bound, &upper_bound);
+        benchmark::DoNotOptimize(constraints);
+    }
+}
+
+// Whole solve(): matrix setup, osqp_setup and osqp_solve. Compare with the two above.
+void BM_solverSolve(benchmark::State &state) {
+    SolverProblem problem(static_cast<size_t>(state.range(1)));
+    state.SetLabel(kSolverTypes[state.range(0)]);
+    std::vector<State> optimized_path;
+    for (auto _ : state) {
+        auto solver = problem.create(static_cast<int>(state.range(0)));
+        benchmark::DoNotOptimize(solver->solve(&optimized_path));
+    }
+}
+
+// solve() of one solver kept across cycles, as PathOptimizer does: after the first solve only the
+// matrix values and bounds are updated in the OSQP workspace, which also warm-starts.
+void BM_solverResolve(benchmark::State &state) {
+    SolverProblem problem(static_cast<size_t>(state.range(1)));
+    state.SetLabel(kSolverTypes[state.range(0)]);
+    auto solver = problem.create(static_cast<int>(state.range(0)));
+    std::vector<State> optimized_path;
+    for (auto _ : state) {
+        solver->reset(problem.reference_path.getSize());
+        benchmark::DoNotOptimize(solver->solve(&optimized_path));
+    }
+}
+
+// Like BM_solverResolve, but the horizon drifts by up to 3 states per cycle, as the reference
+// segmentation and the truncation at blocked stations make it do. Arguments: solver type, and
+// FLAGS_qp_horizon_buckets off (0) or every 25 states (1). reuse_rate is the share of solves that
+// updated the OSQP workspace of the last one.
+void BM_solverDriftingHorizon(benchmark::State &state) {
+    google::FlagSaver flag_saver;
+    const int max_horizon = 400;
+    FLAGS_qp_horizon_buckets = state.range(1) ? "300,325,350,375,400" : "";
+    SolverProblem problem(max_horizon);
+    state.SetLabel(kSolverTypes[state.range(0)]);
+    auto solver = problem.create(static_cast<int>(state.range(0)));
+    std::mt19937 engine(0);
+    std::uniform_int_distribution<int> drift(-3, 3);
+    int horizon = 350;
+    int reused = 0;
+    std::vector<State> optimized_path;
+    for (auto _ : state) {
+        horizon = std::min(max_horizon, std::max(300, horizon + drift(engine)));
+        solver->reset(static_cast<size_t>(horizon));
+        benchmark::DoNotOptimize(solver->solve(&optimized_path));
+        if (solver->getQpInfo().workspace_reused) ++reused;
+    }
+    state.counters["reuse_rate"] = static_cast<double>(reused) / state.iterations();
+}
+
+void solverArguments(benchmark::internal::Benchmark *benchmark) {
+    for (int type = 0; type != 3; ++type) {
+        for (int horizon : {100, 500, 2000}) benchmark->Args({type, horizon});
+    }
+    benchmark->Unit(benchmark::kMicrosecond);
+}
+BENCHMARK(BM_solverSetHessianMatrix)->Apply(solverArguments);
+BENCHMARK(BM_solverSetConstraintMatrix)->Apply(solverArguments);
+BENCHMARK(BM_solverSolve)->Apply(solverArguments);
+BENCHMARK(BM_solverResolve)->Apply(solverArguments);
+
+void driftingHorizonArguments(benchmark::internal::Benchmark *benchmark) {
+    for (int type = 0; type != 3; ++type) {
+        for (int buckets : {0, 1}) benchmark->Args({type, buckets});
+    }
+    benchmark->Unit(benchmark::kMicrosecond);
+}
+BENCHMARK(BM_solverDriftingHorizon)->Apply(driftingHorizonArguments);
+
+}
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    FLAGS_enable_computation_time_output = false;
+    benchmark::RunSpecifiedBenchmarks();
+    if (!FLAGS_trace_file.empty()) PathOptimizationNS::Tracer::instance().dumpChromeTrace(FLAGS_trace_file);
+    return 0;
+}
@@ -0,0 +1,44 @@
+// Convert a map image into a tiled distance field for TiledDistanceField::open():
+//   path_optimizer_make_tiled_map --image=site.png --resolution=0.1 --output=site.podt --encoding=uint16
+
+#include <string>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include "path_optimizer/tools/scenario.hpp"
+#include "path_optimizer/tools/tiled_distance_field.hpp"
+
+DEFINE_string(image, "", "obstacle image, black (0) is occupied");
+DEFINE_double(resolution, 0.2, "meters per pixel");
+DEFINE_double(origin_x, 0, "x of the map center");
+DEFINE_double(origin_y, 0, "y of the map center");
+DEFINE_string(output, "", "tiled distance field file to write");
+DEFINE_string(encoding, "float32", "float32 or uint16");
+DEFINE_double(max_distance, 20, "distances are clamped to this for uint16");
+
+int main(int argc, char **argv) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+    using PathOptimizationNS::TiledDistanceField;
+    if (FLAGS_image.empty() || FLAGS_output.empty()) {
+        LOG(ERROR) << "--image and --output are required.";
+        return 1;
+    }
+    if (FLAGS_encoding != "float32" && FLAGS_encoding != "uint16") {
+        LOG(ERROR) << "Unknown encoding " << FLAGS_encoding;
+        return 1;
+    }
+    cv::Mat image = cv::imread(FLAGS_image, cv::IMREAD_GRAYSCALE);
+    if (image.empty()) {
+        LOG(ERROR) << "Cannot read " << FLAGS_image;
+        return 1;
+    }
+    grid_map::GridMap grid_map;
+    PathOptimizationNS::gridMapFromImage(image, FLAGS_resolution,
+                                         grid_map::Position(FLAGS_origin_x, FLAGS_origin_y), &grid_map);
+    const auto encoding = FLAGS_encoding == "uint16" ? TiledDistanceField::Encoding::UINT16
+                                                     : TiledDistanceField::Encoding::FLOAT32;
+    if (!TiledDistanceField::write(grid_map, "distance", FLAGS_output, encoding, FLAGS_max_distance)) return 1;
+    LOG(INFO) << "Wrote " << image.rows << "x" << image.cols << " distance field to " << FLAGS_output;
+    return 0;
+}
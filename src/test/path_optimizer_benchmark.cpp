@@ -16,7 +16,9 @@
 #include <opencv/cv.hpp>
 #include "glog/logging.h"
 #include <path_optimizer/path_optimizer.hpp>
-#include "path_optimizer/tools/eigen2cv.hpp"
+#include "path_optimizer/tools/tracer.hpp"
+#include "path_optimizer/tools/allocation_counter.hpp"
+#include "path_optimizer/tools/Map.hpp"
 #include "path_optimizer/data_struct/data_struct.hpp"
 
 static void BM_optimizePath(benchmark::State &state) {
@@ -36,11 +38,7 @@ static void BM_optimizePath(benchmark::State &state) {
     grid_map::GridMapCvConverter::addLayerFromImage<unsigned char, 1>(
         img_src, "obstacle", grid_map, OCCUPY, FREE, 0.5);
     // Update distance layer.
-    Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> binary =
-        grid_map.get("obstacle").cast<unsigned char>();
-    cv::distanceTransform(eigen2cv(binary), eigen2cv(grid_map.get("distance")),
-                          CV_DIST_L2, CV_DIST_MASK_PRECISE);
-    grid_map.get("distance") *= resolution;
+    PathOptimizationNS::Map::buildSignedDistanceField(&grid_map);
     grid_map.setFrameId("/map");
 
     // Input reference path.
@@ -80,13 +78,39 @@ static void BM_optimizePath(benchmark::State &state) {
     goal_state.y = -2.52501;
     goal_state.z = -1.30825;
     goal_state.k = 0;
+    // Args: FLAGS_planning_arena_kb (0 to compare against plain heap allocation), and whether one
+    // optimizer is constructed in every cycle (0), kept across cycles (1), or kept and pipelined (2),
+    // which smooths the next cycle's reference during this cycle's QP. Compare the wall time.
+    google::FlagSaver flag_saver;
+    FLAGS_planning_arena_kb = static_cast<int>(state.range(0));
+    const bool reuse = state.range(1) != 0;
+    const bool pipelined = state.range(1) == 2;
+    int prepared = 0;
+    FLAGS_enable_computation_time_output = false;
+    PathOptimizationNS::PathOptimizer reused_optimizer(start_state, goal_state, grid_map);
+    const auto allocations_before = PathOptimizationNS::allocationCount();
     for (auto _:state) {
-        FLAGS_enable_computation_time_output = false;
-        PathOptimizationNS::PathOptimizer path_optimizer(start_state, goal_state, grid_map);
-        path_optimizer.solve(points, &final_path);
+        if (reuse) {
+            reused_optimizer.setStartState(start_state);
+            reused_optimizer.setGoal(goal_state);
+            if (pipelined) {
+                // The vehicle stands still, so the predicted start state of the next cycle is this one.
+                prepared += reused_optimizer.solvePipelined(points, start_state, &final_path).smoothing_prepared;
+            } else {
+                reused_optimizer.solve(points, &final_path);
+            }
+        } else {
+            PathOptimizationNS::PathOptimizer path_optimizer(start_state, goal_state, grid_map);
+            path_optimizer.solve(points, &final_path);
+        }
     }
+    const auto allocations = PathOptimizationNS::allocationCount() - allocations_before;
+    state.counters["allocs_per_solve"] = static_cast<double>(allocations.allocations) / state.iterations();
+    state.counters["alloc_bytes_per_solve"] = static_cast<double>(allocations.bytes) / state.iterations();
+    if (pipelined) state.counters["prepared_share"] = static_cast<double>(prepared) / state.iterations();
 }
-BENCHMARK(BM_optimizePath)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_optimizePath)->Args({0, 0})->Args({256, 0})->Args({256, 1})->Args({256, 2})
+    ->Unit(benchmark::kMillisecond);
 
 static void BM_optimizePathWithoutSmoothing(benchmark::State &state) {
     // Initialize grid map from image.
@@ -105,11 +129,7 @@ static void BM_optimizePathWithoutSmoothing(benchmark::State &state) {
     grid_map::GridMapCvConverter::addLayerFromImage<unsigned char, 1>(
         img_src, "obstacle", grid_map, OCCUPY, FREE, 0.5);
     // Update distance layer.
-    Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> binary =
-        grid_map.get("obstacle").cast<unsigned char>();
-    cv::distanceTransform(eigen2cv(binary), eigen2cv(grid_map.get("distance")),
-                          CV_DIST_L2, CV_DIST_MASK_PRECISE);
-    grid_map.get("distance") *= resolution;
+    PathOptimizationNS::Map::buildSignedDistanceField(&grid_map);
     grid_map.setFrameId("/map");
 
     // Input reference path.
@@ -150,13 +170,25 @@ static void BM_optimizePathWithoutSmoothing(benchmark::State &state) {
     goal_state.z = -1.30825;
     goal_state.k = 0;
 
+    google::FlagSaver flag_saver;
+    FLAGS_planning_arena_kb = static_cast<int>(state.range(0));
     PathOptimizationNS::PathOptimizer path_optimizer(start_state, goal_state, grid_map);
     path_optimizer.solve(points, &optimized_path);
+    const auto allocations_before = PathOptimizationNS::allocationCount();
     for (auto _:state) {
         FLAGS_enable_computation_time_output = false;
         path_optimizer.solveWithoutSmoothing(optimized_path, &final_path);
     }
+    const auto allocations = PathOptimizationNS::allocationCount() - allocations_before;
+    state.counters["allocs_per_solve"] = static_cast<double>(allocations.allocations) / state.iterations();
+    state.counters["alloc_bytes_per_solve"] = static_cast<double>(allocations.bytes) / state.iterations();
 }
-BENCHMARK(BM_optimizePathWithoutSmoothing)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_optimizePathWithoutSmoothing)->Arg(0)->Arg(256)->Unit(benchmark::kMillisecond);
 
-BENCHMARK_MAIN();
\ No newline at end of file
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    benchmark::RunSpecifiedBenchmarks();
+    if (!FLAGS_trace_file.empty()) PathOptimizationNS::Tracer::instance().dumpChromeTrace(FLAGS_trace_file);
+    return 0;
+}
\ No newline at end of file
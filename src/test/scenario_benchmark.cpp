@@ -0,0 +1,222 @@
+// Runs every scenario in a directory through solve() and solveWithoutSmoothing() under each
+// smoother / solver combination and reports latency distributions and success rates.
+// Does not need ROS:
+//   path_optimizer_scenario_benchmark --scenario_dir=scenarios --iterations=50 --report_file=report.csv
+// Synthetic scenarios for scaling plots, one per map size and route length:
+//   path_optimizer_scenario_benchmark --scenario_dir= --synthetic_map_sizes=200,500,2000
+//       --synthetic_route_lengths=100,200,400,800 --synthetic_resolution=0.5 --report_file=scaling.csv
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include "path_optimizer/path_optimizer.hpp"
+#include "path_optimizer/data_struct/data_struct.hpp"
+#include "path_optimizer/tools/Map.hpp"
+#include "path_optimizer/tools/scenario.hpp"
+#include "path_optimizer/tools/scenario_generator.hpp"
+#include "path_optimizer/tools/tracer.hpp"
+#include "path_optimizer/tools/metrics.hpp"
+
+DEFINE_string(scenario_dir, "scenarios", "directory with *.scenario files");
+DEFINE_string(smoothers,
+              "ANGLE_DIFF,TENSION/OSQP,TENSION/IPOPT",
+              "comma separated smoothing methods, TENSION takes the tension solver after a slash");
+DEFINE_string(solvers, "K,KP,KPC", "comma separated optimization methods");
+DEFINE_int32(iterations, 20, "runs per scenario, combination and mode");
+DEFINE_string(report_file, "", "if not empty, also write the report here as CSV, with mean stage timings");
+DEFINE_string(synthetic_map_sizes, "", "comma separated map sizes in m; generate synthetic scenarios if not empty");
+DEFINE_string(synthetic_route_lengths, "150", "comma separated route lengths in m");
+DEFINE_int32(synthetic_seeds, 1, "synthetic scenarios per map size and route length, seeded 0, 1, ...");
+DEFINE_double(synthetic_resolution, 0.2, "synthetic map resolution");
+DEFINE_double(synthetic_obstacle_density, 0.05, "fraction of the synthetic map covered by obstacles");
+DEFINE_double(synthetic_corridor_width, 8, "obstacle-free width around the synthetic route");
+DEFINE_double(synthetic_max_curvature, 0.05, "max curvature of the synthetic route");
+
+namespace {
+
+using PathOptimizationNS::Map;
+using PathOptimizationNS::PathOptimizer;
+using PathOptimizationNS::Scenario;
+using PathOptimizationNS::State;
+
+struct Row {
+    Row(const std::string &scenario, const std::string &smoother, const std::string &solver, const std::string &mode) :
+        scenario(scenario), smoother(smoother), solver(solver), mode(mode) {}
+    std::string scenario;
+    std::string smoother;
+    std::string solver;
+    std::string mode;
+    int runs{0};
+    int successes{0};
+    std::vector<double> latencies_ms;
+    // Sums over all runs.
+    PathOptimizationNS::StageTimings stage_ms;
+};
+
+std::vector<std::string> split(const std::string &str, char delimiter) {
+    std::vector<std::string> parts;
+    std::istringstream in(str);
+    std::string part;
+    while (std::getline(in, part, delimiter)) {
+        if (!part.empty()) parts.emplace_back(part);
+    }
+    return parts;
+}
+
+void addTimings(const PathOptimizationNS::SolveResult &result, Row *row) {
+    row->stage_ms.smoothing_ms += result.timings.smoothing_ms;
+    row->stage_ms.segmentation_ms += result.timings.segmentation_ms;
+    row->stage_ms.optimization_ms += result.timings.optimization_ms;
+    row->stage_ms.output_check_ms += result.timings.output_check_ms;
+}
+
+double elapsedMs(const std::chrono::steady_clock::time_point &begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Nearest-rank quantile of sorted values.
+double quantile(const std::vector<double> &sorted, double q) {
+    if (sorted.empty()) return 0;
+    auto rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+void runCombination(const Scenario &scenario, const std::string &smoother, const std::string &solver,
+                    std::vector<Row> *rows) {
+    Row full(scenario.name, smoother, solver, "solve");
+    Row without_smoothing(scenario.name, smoother, solver, "solveWithoutSmoothing");
+    std::vector<State> optimized_path, final_path;
+    // Built once, as a planner would, so a fixed-point distance layer is not converted in every run.
+    const Map map(scenario.map);
+    for (int i = 0; i != FLAGS_iterations; ++i) {
+        auto begin = std::chrono::steady_clock::now();
+        PathOptimizer path_optimizer(scenario.start, scenario.goal, map);
+        auto result = path_optimizer.solve(scenario.reference_points, &final_path);
+        full.latencies_ms.emplace_back(elapsedMs(begin));
+        addTimings(result, &full);
+        ++full.runs;
+        if (result) {
+            ++full.successes;
+            optimized_path = final_path;
+        }
+    }
+    // Re-optimize the last successful path, as a planner does on the following cycles.
+    if (!optimized_path.empty()) {
+        PathOptimizer path_optimizer(scenario.start, scenario.goal, map);
+        for (int i = 0; i != FLAGS_iterations; ++i) {
+            auto begin = std::chrono::steady_clock::now();
+            auto result = path_optimizer.solveWithoutSmoothing(optimized_path, &final_path);
+            without_smoothing.latencies_ms.emplace_back(elapsedMs(begin));
+            addTimings(result, &without_smoothing);
+            ++without_smoothing.runs;
+            if (result) ++without_smoothing.successes;
+        }
+    }
+    rows->emplace_back(std::move(full));
+    rows->emplace_back(std::move(without_smoothing));
+}
+
+void runScenario(const Scenario &scenario, std::vector<Row> *rows) {
+    google::FlagSaver flag_saver;
+    for (const auto &flag : scenario.flags) {
+        if (google::SetCommandLineOption(flag.first.c_str(), flag.second.c_str()).empty()) {
+            LOG(WARNING) << scenario.name << ": cannot set flag " << flag.first << "=" << flag.second;
+        }
+    }
+    FLAGS_enable_computation_time_output = false;
+    for (const auto &smoother : split(FLAGS_smoothers, ',')) {
+        auto method = split(smoother, '/');
+        FLAGS_smoothing_method = method[0];
+        if (method.size() > 1) FLAGS_tension_solver = method[1];
+        for (const auto &solver : split(FLAGS_solvers, ',')) {
+            FLAGS_optimization_method = solver;
+            runCombination(scenario, smoother, solver, rows);
+        }
+    }
+}
+
+void report(const std::vector<Row> &rows) {
+    std::printf("%-24s %-16s %-4s %-22s %8s %9s %9s %9s %9s %9s\n",
+                "scenario", "smoother", "qp", "mode", "success", "mean ms", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    std::ofstream csv;
+    if (!FLAGS_report_file.empty()) {
+        csv.open(FLAGS_report_file);
+        csv << "scenario,smoother,solver,mode,runs,successes,mean_ms,p50_ms,p90_ms,p99_ms,max_ms,"
+               "smoothing_ms,segmentation_ms,optimization_ms,output_check_ms\n";
+    }
+    for (const auto &row : rows) {
+        auto sorted = row.latencies_ms;
+        std::sort(sorted.begin(), sorted.end());
+        double mean = 0;
+        for (double latency : sorted) mean += latency;
+        mean = sorted.empty() ? 0 : mean / sorted.size();
+        const double max = sorted.empty() ? 0 : sorted.back();
+        char success[16];
+        std::snprintf(success, sizeof(success), "%d/%d", row.successes, row.runs);
+        std::printf("%-24s %-16s %-4s %-22s %8s %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+                    row.scenario.c_str(), row.smoother.c_str(), row.solver.c_str(), row.mode.c_str(), success,
+                    mean, quantile(sorted, 0.5), quantile(sorted, 0.9), quantile(sorted, 0.99), max);
+        if (csv.is_open()) {
+            csv << row.scenario << "," << row.smoother << "," << row.solver << "," << row.mode << ","
+                << row.runs << "," << row.successes << "," << mean << "," << quantile(sorted, 0.5) << ","
+                << quantile(sorted, 0.9) << "," << quantile(sorted, 0.99) << "," << max;
+            const double runs = std::max(row.runs, 1);
+            csv << "," << row.stage_ms.smoothing_ms / runs << "," << row.stage_ms.segmentation_ms / runs << ","
+                << row.stage_ms.optimization_ms / runs << "," << row.stage_ms.output_check_ms / runs << "\n";
+        }
+    }
+}
+
+void runSyntheticScenarios(std::vector<Row> *rows) {
+    PathOptimizationNS::SyntheticScenarioConfig config;
+    config.resolution = FLAGS_synthetic_resolution;
+    config.obstacle_density = FLAGS_synthetic_obstacle_density;
+    config.corridor_width = FLAGS_synthetic_corridor_width;
+    config.max_curvature = FLAGS_synthetic_max_curvature;
+    for (const auto &map_size : split(FLAGS_synthetic_map_sizes, ',')) {
+        config.map_size = std::stod(map_size);
+        for (const auto &route_length : split(FLAGS_synthetic_route_lengths, ',')) {
+            config.route_length = std::stod(route_length);
+            for (int seed = 0; seed != FLAGS_synthetic_seeds; ++seed) {
+                config.seed = static_cast<uint32_t>(seed);
+                Scenario scenario;
+                if (!PathOptimizationNS::generateScenario(config, &scenario)) continue;
+                LOG(INFO) << "Running scenario " << scenario.name;
+                runScenario(scenario, rows);
+            }
+        }
+    }
+}
+
+}
+
+int main(int argc, char **argv) {
+    google::InitGoogleLogging(argv[0]);
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    std::vector<Row> rows;
+    if (!FLAGS_scenario_dir.empty()) {
+        for (const auto &file : PathOptimizationNS::listScenarioFiles(FLAGS_scenario_dir)) {
+            Scenario scenario;
+            if (!PathOptimizationNS::loadScenario(file, &scenario)) continue;
+            LOG(INFO) << "Running scenario " << scenario.name;
+            runScenario(scenario, &rows);
+        }
+    }
+    runSyntheticScenarios(&rows);
+    if (rows.empty()) {
+        LOG(ERROR) << "No scenario found in " << FLAGS_scenario_dir << " and no synthetic scenario configured.";
+        return 1;
+    }
+    report(rows);
+    if (!FLAGS_trace_file.empty()) PathOptimizationNS::Tracer::instance().dumpChromeTrace(FLAGS_trace_file);
+    if (!FLAGS_metrics_file.empty()) PathOptimizationNS::MetricsRegistry::instance().dumpPrometheus(FLAGS_metrics_file);
+    google::ShutdownGoogleLogging();
+    return 0;
+}
@@ -1,27 +1,229 @@
 //
 // Created by ljn on 20-2-12.
 //
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <thread>
+#include <vector>
 #include <glog/logging.h>
 #include "path_optimizer/tools/Map.hpp"
+#include "path_optimizer/config/planning_flags.hpp"
 
 namespace PathOptimizationNS {
 
+namespace {
+// Rows gathered together in the row pass, so reading along a row touches whole cache lines.
+const int kTileRows = 16;
+
+// Split [0, n) into contiguous chunks, one per thread.
+void parallelFor(int n, unsigned int threads, const std::function<void(int, int)> &body) {
+    threads = std::max(1u, std::min(threads, static_cast<unsigned int>(n)));
+    if (threads == 1) {
+        body(0, n);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i != threads; ++i) {
+        const int begin = static_cast<int>(static_cast<long>(n) * i / threads);
+        const int end = static_cast<int>(static_cast<long>(n) * (i + 1) / threads);
+        workers.emplace_back(body, begin, end);
+    }
+    for (auto &worker : workers) worker.join();
+}
+
+// Lower envelope of the parabolas (q - p)^2 + f(p): d(q) = min_p (q - p)^2 + f(p).
+// v and z are scratch buffers of n and n + 1 elements.
+void squaredDistanceTransform(const double *f, int n, double *d, int *v, double *z) {
+    // Abscissa where the parabolas of q and p intersect.
+    auto intersection = [f](int q, int p) {
+        return ((f[q] + q * static_cast<double>(q)) - (f[p] + p * static_cast<double>(p))) / (2.0 * (q - p));
+    };
+    int k = 0;
+    v[0] = 0;
+    z[0] = -HUGE_VAL;
+    z[1] = HUGE_VAL;
+    for (int q = 1; q < n; ++q) {
+        // z[0] = -inf stops the loop at k = 0.
+        double s = intersection(q, v[k]);
+        while (s <= z[k]) s = intersection(q, v[--k]);
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = HUGE_VAL;
+    }
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < q) ++k;
+        const double dq = q - v[k];
+        d[q] = dq * dq + f[v[k]];
+    }
+}
+
+// Distance in meters from every cell to the closest obstacle cell (value 0), or with inside set, from
+// every cell to the closest free cell. output must have the size of obstacle.
+void distanceTransform(const grid_map::Matrix &obstacle, bool inside, double resolution, unsigned int threads,
+                       grid_map::Matrix *output) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    auto &distance = *output;
+    const int rows = static_cast<int>(distance.rows());
+    const int cols = static_cast<int>(distance.cols());
+    if (rows == 0 || cols == 0) return;
+    // Larger than any distance inside the map, and small enough to square without losing precision.
+    const auto far = static_cast<float>(rows + cols);
+
+    // Column pass: distance in cells to the closest target cell of the same column. Columns are contiguous.
+    parallelFor(cols, threads, [&](int begin, int end) {
+        for (int c = begin; c != end; ++c) {
+            const float *obstacle_column = obstacle.data() + static_cast<long>(c) * rows;
+            float *distance_column = distance.data() + static_cast<long>(c) * rows;
+            float last = far;
+            for (int r = 0; r != rows; ++r) {
+                // Same test as the cast to unsigned char before cv::distanceTransform.
+                last = (obstacle_column[r] < 1) != inside ? 0 : std::min(far, last + 1);
+                distance_column[r] = last;
+            }
+            last = far;
+            for (int r = rows - 1; r >= 0; --r) {
+                last = std::min(distance_column[r], std::min(far, last + 1));
+                distance_column[r] = last;
+            }
+        }
+    });
+
+    // Row pass: exact squared distance from the column distances, kTileRows rows at a time.
+    const int tiles = (rows + kTileRows - 1) / kTileRows;
+    parallelFor(tiles, threads, [&](int begin, int end) {
+        std::vector<double> f(static_cast<size_t>(kTileRows) * cols), d(cols), z(cols + 1);
+        std::vector<int> v(cols);
+        for (int tile = begin; tile != end; ++tile) {
+            const int row_begin = tile * kTileRows;
+            const int tile_rows = std::min(kTileRows, rows - row_begin);
+            for (int c = 0; c != cols; ++c) {
+                const float *column = distance.data() + static_cast<long>(c) * rows + row_begin;
+                for (int t = 0; t != tile_rows; ++t) {
+                    f[static_cast<size_t>(t) * cols + c] = static_cast<double>(column[t]) * column[t];
+                }
+            }
+            for (int t = 0; t != tile_rows; ++t) {
+                double *row = &f[static_cast<size_t>(t) * cols];
+                squaredDistanceTransform(row, cols, d.data(), v.data(), z.data());
+                std::copy(d.begin(), d.end(), row);
+            }
+            for (int c = 0; c != cols; ++c) {
+                float *column = distance.data() + static_cast<long>(c) * rows + row_begin;
+                for (int t = 0; t != tile_rows; ++t) {
+                    column[t] = static_cast<float>(std::sqrt(f[static_cast<size_t>(t) * cols + c]) * resolution);
+                }
+            }
+        }
+    });
+}
+}
+
 Map::Map(const grid_map::GridMap &grid_map) :
-    maps(grid_map) {
-    if (!grid_map.exists("distance")) {
-        LOG(ERROR) << "grid map must contain 'distance' layer";
+    backend_(createMapBackend(grid_map)) {
+    if (FLAGS_distance_pyramid_levels > 0) {
+        // From the backend, whose distances may be quantized.
+        pyramid_ = std::make_shared<const DistancePyramid>(GridGeometry(grid_map), *backend_,
+                                                           FLAGS_distance_pyramid_levels);
     }
 }
 
+Map::Map(std::shared_ptr<const MapBackend> backend, std::shared_ptr<const DistancePyramid> pyramid) :
+    backend_(std::move(backend)),
+    pyramid_(std::move(pyramid)) {
+    CHECK(backend_ != nullptr);
+}
+
 double Map::getObstacleDistance(const Eigen::Vector2d &pos) const {
-    if (maps.isInside(pos)) {
-        return this->maps.atPosition("distance", pos, grid_map::InterpolationMethods::INTER_LINEAR);
+    if (backend_->isInside(pos)) {
+        return backend_->getObstacleDistance(pos);
     } else {
         return 0.0;
     }
 }
 
 bool Map::isInside(const Eigen::Vector2d &pos) const {
-    return maps.isInside(pos);
+    return backend_->isInside(pos);
+}
+
+int Map::getPyramidLevels() const {
+    return pyramid_ ? pyramid_->levels() : 0;
+}
+
+double Map::getObstacleDistanceUpTo(const Eigen::Vector2d &pos, double limit, int level) const {
+    if (!backend_->isInside(pos)) return 0.0;
+    level = std::min(level, getPyramidLevels());
+    if (level > 0) {
+        const double lower_bound = pyramid_->lowerBound(pos, level);
+        if (lower_bound >= limit) return lower_bound;
+    }
+    return backend_->getObstacleDistance(pos);
+}
+
+bool Map::isClear(const Eigen::Vector2d &pos, double clearance, int level) const {
+    return getObstacleDistanceUpTo(pos, clearance, level) >= clearance;
+}
+
+bool Map::hasSignedDistance() const {
+    return backend_->hasSignedDistance();
+}
+
+double Map::getSignedDistance(const Eigen::Vector2d &pos) const {
+    if (!backend_->hasSignedDistance()) return getObstacleDistance(pos);
+    if (backend_->isInside(pos)) {
+        return backend_->getSignedDistance(pos);
+    } else {
+        return 0.0;
+    }
+}
+
+Eigen::Vector2d Map::getDistanceGradient(const Eigen::Vector2d &pos) const {
+    Eigen::Vector2d gradient(0, 0);
+    if (!backend_->isInside(pos)) return gradient;
+    const double step = backend_->getResolution();
+    for (int axis = 0; axis != 2; ++axis) {
+        Eigen::Vector2d forward(pos), backward(pos);
+        forward(axis) += step;
+        backward(axis) -= step;
+        // One-sided at the border.
+        if (!backend_->isInside(forward)) forward = pos;
+        if (!backend_->isInside(backward)) backward = pos;
+        const double span = forward(axis) - backward(axis);
+        if (span > 0) gradient(axis) = (getSignedDistance(forward) - getSignedDistance(backward)) / span;
+    }
+    return gradient;
+}
+
+bool Map::buildDistanceField(grid_map::GridMap *grid_map,
+                             const std::string &obstacle_layer,
+                             const std::string &distance_layer,
+                             unsigned int threads) {
+    CHECK_NOTNULL(grid_map);
+    if (!grid_map->exists(obstacle_layer)) {
+        LOG(WARNING) << "grid map has no '" << obstacle_layer << "' layer, distance field not built.";
+        return false;
+    }
+    // The transform runs on the layer matrices directly, they must not wrap around.
+    if (!grid_map->isDefaultStartIndex()) grid_map->convertToDefaultStartIndex();
+    if (!grid_map->exists(distance_layer)) grid_map->add(distance_layer);
+    distanceTransform(grid_map->get(obstacle_layer), false, grid_map->getResolution(), threads,
+                      &grid_map->get(distance_layer));
+    return true;
+}
+
+bool Map::buildSignedDistanceField(grid_map::GridMap *grid_map,
+                                   const std::string &obstacle_layer,
+                                   const std::string &distance_layer,
+                                   const std::string &signed_distance_layer,
+                                   unsigned int threads) {
+    if (!buildDistanceField(grid_map, obstacle_layer, distance_layer, threads)) return false;
+    if (!grid_map->exists(signed_distance_layer)) grid_map->add(signed_distance_layer);
+    auto &signed_distance = grid_map->get(signed_distance_layer);
+    distanceTransform(grid_map->get(obstacle_layer), true, grid_map->getResolution(), threads, &signed_distance);
+    // At most one of the two is non-zero in every cell.
+    signed_distance = grid_map->get(distance_layer) - signed_distance;
+    return true;
+}
 }
-}
\ No newline at end of file
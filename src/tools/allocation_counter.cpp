@@ -0,0 +1,63 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "path_optimizer/tools/allocation_counter.hpp"
+
+namespace {
+std::atomic<uint64_t> allocations{0};
+std::atomic<uint64_t> allocated_bytes{0};
+
+void *countedAllocate(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    // malloc(0) may return nullptr, operator new must not.
+    return std::malloc(size ? size : 1);
+}
+}
+
+void *operator new(std::size_t size) {
+    void *p = countedAllocate(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](std::size_t size) {
+    void *p = countedAllocate(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocate(size);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+namespace PathOptimizationNS {
+
+AllocationCount allocationCount() {
+    AllocationCount count;
+    count.allocations = allocations.load(std::memory_order_relaxed);
+    count.bytes = allocated_bytes.load(std::memory_order_relaxed);
+    return count;
+}
+
+}
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cstdint>
+#include <glog/logging.h>
+#include "path_optimizer/tools/arena.hpp"
+
+namespace PathOptimizationNS {
+
+namespace {
+thread_local Arena *current_arena = nullptr;
+}
+
+Arena::Arena(std::size_t initial_bytes) {
+    addBlock(std::max<std::size_t>(initial_bytes, 1));
+}
+
+Arena::~Arena() {
+    for (const auto &block : blocks_) ::operator delete(block.data);
+}
+
+void Arena::addBlock(std::size_t min_bytes) {
+    // Grow geometrically, so a cycle much larger than the first block needs few blocks.
+    const std::size_t size = std::max(min_bytes, blocks_.empty() ? 0 : 2 * blocks_.back().size);
+    if (!blocks_.empty()) used_before_ += offset_;
+    blocks_.push_back(Block{static_cast<char *>(::operator new(size)), size});
+    offset_ = 0;
+}
+
+void *Arena::allocate(std::size_t bytes, std::size_t alignment) {
+    DCHECK_EQ(alignment & (alignment - 1), 0u) << "alignment must be a power of two";
+    auto aligned_offset = [this, alignment]() {
+        const auto address = reinterpret_cast<std::uintptr_t>(blocks_.back().data) + offset_;
+        return offset_ + ((alignment - address % alignment) % alignment);
+    };
+    std::size_t begin = aligned_offset();
+    if (begin + bytes > blocks_.back().size) {
+        addBlock(bytes + alignment);
+        begin = aligned_offset();
+    }
+    offset_ = begin + bytes;
+    return blocks_.back().data + begin;
+}
+
+void Arena::reset() {
+    if (blocks_.size() > 1) {
+        const std::size_t total = capacity();
+        for (const auto &block : blocks_) ::operator delete(block.data);
+        blocks_.clear();
+        addBlock(total);
+    }
+    offset_ = 0;
+    used_before_ = 0;
+}
+
+std::size_t Arena::bytesUsed() const {
+    return used_before_ + offset_;
+}
+
+std::size_t Arena::capacity() const {
+    std::size_t total = 0;
+    for (const auto &block : blocks_) total += block.size;
+    return total;
+}
+
+Arena *Arena::current() {
+    return current_arena;
+}
+
+ScopedArena::ScopedArena(Arena *arena) :
+    previous_(current_arena) {
+    current_arena = arena;
+}
+
+ScopedArena::~ScopedArena() {
+    current_arena = previous_;
+}
+
+}
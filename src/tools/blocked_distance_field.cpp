@@ -0,0 +1,56 @@
+#include <glog/logging.h>
+#include "path_optimizer/tools/blocked_distance_field.hpp"
+
+namespace PathOptimizationNS {
+
+BlockedDistanceField::BlockedDistanceField(const grid_map::GridMap &grid_map, CellLayout layout) :
+    geometry_(grid_map),
+    indexer_(layout, geometry_.rows, geometry_.cols) {
+    if (!grid_map.exists("distance")) {
+        LOG(ERROR) << "grid map must contain 'distance' layer";
+        distance_.assign(indexer_.size(), 0);
+    } else {
+        copyLayer(grid_map, "distance", &distance_);
+    }
+    if (grid_map.exists("signed_distance")) copyLayer(grid_map, "signed_distance", &signed_distance_);
+}
+
+void BlockedDistanceField::copyLayer(const grid_map::GridMap &grid_map, const std::string &layer,
+                                     std::vector<float> *cells) const {
+    const auto &data = grid_map.get(layer);
+    const grid_map::Index &start = grid_map.getStartIndex();
+    const int rows = geometry_.rows, cols = geometry_.cols;
+    cells->assign(indexer_.size(), 0);
+    for (int c = 0; c != cols; ++c) {
+        const int data_col = (c + start(1)) % cols;
+        for (int r = 0; r != rows; ++r) {
+            (*cells)[indexer_.offset(r, c)] = data((r + start(0)) % rows, data_col);
+        }
+    }
+}
+
+bool BlockedDistanceField::isInside(const Eigen::Vector2d &pos) const {
+    return geometry_.isInside(pos);
+}
+
+double BlockedDistanceField::getObstacleDistance(const Eigen::Vector2d &pos) const {
+    return interpolateBilinear(geometry_, pos, [this](int row, int col) {
+        return distance_[indexer_.offset(row, col)];
+    });
+}
+
+bool BlockedDistanceField::hasSignedDistance() const {
+    return !signed_distance_.empty();
+}
+
+double BlockedDistanceField::getSignedDistance(const Eigen::Vector2d &pos) const {
+    return interpolateBilinear(geometry_, pos, [this](int row, int col) {
+        return signed_distance_[indexer_.offset(row, col)];
+    });
+}
+
+double BlockedDistanceField::getResolution() const {
+    return geometry_.resolution;
+}
+
+}
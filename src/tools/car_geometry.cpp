@@ -58,12 +58,19 @@ void CarGeometry::setCircles() {
 
 std::vector<Circle> CarGeometry::getCircles(const PathOptimizationNS::State &pos) const {
     std::vector<Circle> result;
+    getCircles(pos, &result);
+    return result;
+}
+
+void CarGeometry::getCircles(const PathOptimizationNS::State &pos, std::vector<Circle> *circles) const {
+    circles->clear();
+    // One sin / cos for all circles.
+    const auto tangent = getTangent(pos.z);
     for (const auto &circle : circles_) {
         State state(circle.x, circle.y);
-        auto global_state = local2Global(pos, state);
-        result.emplace_back(global_state.x, global_state.y, circle.r);
+        auto global_state = local2Global(pos, tangent, state);
+        circles->emplace_back(global_state.x, global_state.y, circle.r);
     }
-    return result;
 }
 
 Circle CarGeometry::getBoundingCircle(const State &pos) const {
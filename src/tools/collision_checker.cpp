@@ -7,30 +7,33 @@
 namespace PathOptimizationNS {
 
 CollisionChecker::CollisionChecker(const grid_map::GridMap &in_gm)
-    : map_(in_gm),
+    : CollisionChecker(Map(in_gm))
+{
+}
+
+CollisionChecker::CollisionChecker(const Map &map)
+    : map_(map),
       car_(FLAGS_car_width,
            FLAGS_car_length / 2.0 - FLAGS_rear_axle_to_center,
            FLAGS_car_length / 2.0 + FLAGS_rear_axle_to_center)
 {
 }
 
+void CollisionChecker::setMap(const Map &map) {
+    map_ = map;
+}
+
 bool CollisionChecker::isSingleStateCollisionFree(const State &current) {
     // get the footprint circles based on current vehicle state in global frame
-    std::vector<Circle> footprint =
-        this->car_.getCircles(current);
+    this->car_.getCircles(current, &footprint_);
     // footprint checking
-    for (auto &circle_itr : footprint) {
+    for (auto &circle_itr : footprint_) {
         grid_map::Position pos(circle_itr.x,
                                circle_itr.y);
-        // complete collision checking
-        if (map_.isInside(pos)) {
-            double clearance = this->map_.getObstacleDistance(pos);
-            if (clearance < circle_itr.r) {  // collision
-                // less than circle radius, collision
-                return false;
-            }
-        } else {
-            // beyond boundaries , collision
+        // complete collision checking; the distance is 0 beyond the boundaries, which is a collision too
+        double clearance = this->map_.getObstacleDistance(pos);
+        if (clearance < circle_itr.r) {  // collision
+            // less than circle radius, collision
             return false;
         }
     }
@@ -45,8 +48,7 @@ bool CollisionChecker::isSingleStateCollisionFreeImproved(const State &current)
     grid_map::Position pos(bounding_circle.x,
                            bounding_circle.y);
     if (map_.isInside(pos)) {
-        double clearance = this->map_.getObstacleDistance(pos);
-        if (clearance < bounding_circle.r) {
+        if (!this->map_.isClear(pos, bounding_circle.r)) {
             // the big circle is not collision-free, then do an exact
             // collision checking
             return (this->isSingleStateCollisionFree(current));
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <utility>
+#include "path_optimizer/tools/deadline.hpp"
+
+namespace PathOptimizationNS {
+
+namespace {
+thread_local const Deadline *current_deadline = nullptr;
+// Shortest solver time limit handed out, in seconds.
+const double kMinTimeLimit = 1e-4;
+}
+
+Deadline::Deadline() :
+    Deadline(Clock::time_point::max()) {}
+
+Deadline::Deadline(Clock::time_point time) :
+    Deadline(time, std::make_shared<std::atomic<bool>>(false)) {}
+
+Deadline::Deadline(Clock::time_point time, std::shared_ptr<std::atomic<bool>> cancelled) :
+    time_(time),
+    cancelled_(std::move(cancelled)) {}
+
+Deadline Deadline::after(double ms) {
+    return Deadline(Clock::now() + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::milli>(ms)));
+}
+
+const Deadline &Deadline::none() {
+    static const Deadline deadline(Clock::time_point::max(), nullptr);
+    return deadline;
+}
+
+Deadline Deadline::earlier(Clock::time_point time) const {
+    Deadline deadline(*this);
+    deadline.time_ = std::min(time_, time);
+    return deadline;
+}
+
+void Deadline::cancel() {
+    if (cancelled_) cancelled_->store(true, std::memory_order_relaxed);
+}
+
+bool Deadline::isCancellable() const {
+    return cancelled_ != nullptr;
+}
+
+bool Deadline::isCancelled() const {
+    return cancelled_ && cancelled_->load(std::memory_order_relaxed);
+}
+
+bool Deadline::hasTimeLimit() const {
+    return time_ != Clock::time_point::max();
+}
+
+Deadline::Clock::time_point Deadline::time() const {
+    return time_;
+}
+
+bool Deadline::expired() const {
+    return isCancelled() || (hasTimeLimit() && Clock::now() >= time_);
+}
+
+double Deadline::remainingSeconds(double limit) const {
+    if (isCancelled()) return 0;
+    if (!hasTimeLimit()) return limit;
+    const double remaining = std::chrono::duration<double>(time_ - Clock::now()).count();
+    return std::max(0.0, std::min(limit, remaining));
+}
+
+const Deadline *Deadline::current() {
+    return current_deadline;
+}
+
+bool Deadline::currentExpired() {
+    return current_deadline && current_deadline->expired();
+}
+
+double Deadline::currentTimeLimit(double limit) {
+    if (!current_deadline) return limit;
+    return std::max(kMinTimeLimit, current_deadline->remainingSeconds(limit));
+}
+
+ScopedDeadline::ScopedDeadline(const Deadline *deadline) :
+    previous_(current_deadline) {
+    current_deadline = deadline;
+}
+
+ScopedDeadline::~ScopedDeadline() {
+    current_deadline = previous_;
+}
+
+}
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <glog/logging.h>
+#include "path_optimizer/tools/distance_pyramid.hpp"
+
+namespace PathOptimizationNS {
+
+namespace {
+// Largest float not above value, so a cell stays a lower bound.
+float floatBelow(double value) {
+    const float rounded = static_cast<float>(value);
+    return rounded > value ? std::nextafter(rounded, -std::numeric_limits<float>::max()) : rounded;
+}
+}
+
+DistancePyramid::DistancePyramid(const GridGeometry &geometry, const MapBackend &backend, int levels, int factor) :
+    geometry_(geometry) {
+    CHECK_GE(levels, 0);
+    CHECK_GE(factor, 2);
+    const int rows = geometry_.rows, cols = geometry_.cols;
+    // Fine columns of the coarse column being built, with its ring.
+    std::vector<float> band;
+    for (int level = 1; level <= levels; ++level) {
+        Level coarse;
+        coarse.scale = level == 1 ? factor : levels_.back().scale * factor;
+        coarse.rows = (rows + coarse.scale - 1) / coarse.scale;
+        coarse.cols = (cols + coarse.scale - 1) / coarse.scale;
+        coarse.cells.assign(static_cast<size_t>(coarse.rows) * coarse.cols, std::numeric_limits<float>::max());
+        if (level == 1) {
+            // Block plus one fine cell on every side, clipped to the map.
+            for (int c = 0; c != coarse.cols; ++c) {
+                const int col_begin = std::max(0, c * factor - 1), col_end = std::min(cols, (c + 1) * factor + 1);
+                band.resize(static_cast<size_t>(col_end - col_begin) * rows);
+                for (int fine_col = col_begin; fine_col != col_end; ++fine_col) {
+                    const double y = geometry_.top_y - (fine_col + 0.5) * geometry_.resolution;
+                    for (int fine_row = 0; fine_row != rows; ++fine_row) {
+                        const double x = geometry_.top_x - (fine_row + 0.5) * geometry_.resolution;
+                        band[static_cast<size_t>(fine_col - col_begin) * rows + fine_row] =
+                            floatBelow(backend.getObstacleDistance(Eigen::Vector2d(x, y)));
+                    }
+                }
+                for (int r = 0; r != coarse.rows; ++r) {
+                    const int row_begin = std::max(0, r * factor - 1), row_end = std::min(rows, (r + 1) * factor + 1);
+                    float value = std::numeric_limits<float>::max();
+                    for (int fine_col = col_begin; fine_col != col_end; ++fine_col) {
+                        const float *column = &band[static_cast<size_t>(fine_col - col_begin) * rows];
+                        for (int fine_row = row_begin; fine_row != row_end; ++fine_row) {
+                            value = std::min(value, column[fine_row]);
+                        }
+                    }
+                    coarse.cells[static_cast<size_t>(c) * coarse.rows + r] = value;
+                }
+            }
+        } else {
+            // The cells of the finer level already include the ring.
+            const auto &fine = levels_.back();
+            for (int fine_col = 0; fine_col != fine.cols; ++fine_col) {
+                for (int fine_row = 0; fine_row != fine.rows; ++fine_row) {
+                    auto &value = coarse.cells[static_cast<size_t>(fine_col / factor) * coarse.rows + fine_row / factor];
+                    value = std::min(value, fine.cells[static_cast<size_t>(fine_col) * fine.rows + fine_row]);
+                }
+            }
+        }
+        levels_.emplace_back(std::move(coarse));
+    }
+}
+
+double DistancePyramid::getResolution(int level) const {
+    return level == 0 ? geometry_.resolution : geometry_.resolution * levels_[level - 1].scale;
+}
+
+double DistancePyramid::lowerBound(const Eigen::Vector2d &pos, int level) const {
+    int row, col;
+    double dr, dc;
+    // Locate on the fine grid, so a position is always in the coarse cell that contains its fine cell.
+    if (!geometry_.locate(pos, &row, &col, &dr, &dc)) return 0.0;
+    const auto &coarse = levels_[level - 1];
+    return coarse.cells[static_cast<size_t>(col / coarse.scale) * coarse.rows + row / coarse.scale];
+}
+
+}
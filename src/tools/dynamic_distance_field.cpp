@@ -0,0 +1,185 @@
+#include <cmath>
+#include <glog/logging.h>
+#include "path_optimizer/tools/dynamic_distance_field.hpp"
+
+namespace PathOptimizationNS {
+
+namespace {
+const float kOccupied = 0;
+const float kFree = 255;
+}
+
+DynamicDistanceField::DynamicDistanceField(grid_map::GridMap *grid_map,
+                                           const std::string &obstacle_layer,
+                                           const std::string &distance_layer,
+                                           double max_distance) :
+    grid_map_(grid_map),
+    obstacle_layer_(obstacle_layer),
+    distance_layer_(distance_layer) {
+    CHECK_NOTNULL(grid_map_);
+    CHECK(grid_map_->exists(obstacle_layer_)) << "grid map must contain '" << obstacle_layer_ << "' layer";
+    if (!grid_map_->isDefaultStartIndex()) grid_map_->convertToDefaultStartIndex();
+    if (!grid_map_->exists(distance_layer_)) grid_map_->add(distance_layer_);
+    rows_ = grid_map_->getSize()(0);
+    cols_ = grid_map_->getSize()(1);
+    resolution_ = grid_map_->getResolution();
+    const auto max_cells = static_cast<int>(std::ceil(max_distance / resolution_));
+    max_squared_distance_ = max_cells * max_cells;
+    max_distance_ = static_cast<float>(max_distance);
+
+    cells_.assign(static_cast<std::size_t>(rows_) * cols_, Cell());
+    for (auto &cell : cells_) cell.squared_distance = max_squared_distance_ + 1;
+    grid_map_->get(distance_layer_).setConstant(max_distance_);
+    bindLayers();
+    for (int i = 0; i != rows_ * cols_; ++i) {
+        if (obstacle_data_[i] == kOccupied) setObstacle(i);
+    }
+    update();
+}
+
+bool DynamicDistanceField::setObstacle(const grid_map::Position &position) {
+    grid_map::Index index;
+    if (!grid_map_->getIndex(position, index)) return false;
+    setObstacle(index);
+    return true;
+}
+
+bool DynamicDistanceField::removeObstacle(const grid_map::Position &position) {
+    grid_map::Index index;
+    if (!grid_map_->getIndex(position, index)) return false;
+    removeObstacle(index);
+    return true;
+}
+
+void DynamicDistanceField::setObstacle(const grid_map::Index &index) {
+    bindLayers();
+    setObstacle(toLinear(index));
+}
+
+void DynamicDistanceField::removeObstacle(const grid_map::Index &index) {
+    bindLayers();
+    removeObstacle(toLinear(index));
+}
+
+void DynamicDistanceField::bindLayers() {
+    obstacle_data_ = grid_map_->get(obstacle_layer_).data();
+    distance_data_ = grid_map_->get(distance_layer_).data();
+}
+
+void DynamicDistanceField::setObstacle(int linear) {
+    obstacle_data_[linear] = kOccupied;
+    if (isOccupied(linear)) return;
+    auto &cell = cells_[linear];
+    cell.obstacle = linear;
+    cell.squared_distance = 0;
+    cell.raise = false;
+    push(0, linear);
+    writeDistance(linear);
+}
+
+void DynamicDistanceField::removeObstacle(int linear) {
+    obstacle_data_[linear] = kFree;
+    if (!isOccupied(linear)) return;
+    auto &cell = cells_[linear];
+    cell.obstacle = -1;
+    cell.squared_distance = max_squared_distance_ + 1;
+    cell.raise = true;
+    push(0, linear);
+    cell.state = QueueState::RAISE_QUEUED;
+    writeDistance(linear);
+}
+
+std::size_t DynamicDistanceField::update() {
+    bindLayers();
+    std::size_t processed = 0;
+    while (!open_.empty()) {
+        const int linear = open_.top().second;
+        open_.pop();
+        auto &cell = cells_[linear];
+        if (cell.state == QueueState::PROCESSED) continue;
+        ++processed;
+        if (cell.raise) {
+            raise(linear);
+        } else if (cell.obstacle >= 0 && isOccupied(cell.obstacle)) {
+            cell.state = QueueState::PROCESSED;
+            lower(linear);
+        }
+    }
+    return processed;
+}
+
+int DynamicDistanceField::squaredDistance(int a, int b) const {
+    const int dr = a % rows_ - b % rows_;
+    const int dc = a / rows_ - b / rows_;
+    return dr * dr + dc * dc;
+}
+
+// Propagate the obstacle of a cell to its neighbors if it is closer than theirs.
+void DynamicDistanceField::lower(int linear) {
+    const auto &cell = cells_[linear];
+    const int row = linear % rows_, col = linear / rows_;
+    for (int dc = -1; dc <= 1; ++dc) {
+        for (int dr = -1; dr <= 1; ++dr) {
+            if ((dr == 0 && dc == 0) || row + dr < 0 || row + dr >= rows_ || col + dc < 0 || col + dc >= cols_) {
+                continue;
+            }
+            const int neighbor_linear = linear + dc * rows_ + dr;
+            auto &neighbor = cells_[neighbor_linear];
+            if (neighbor.raise) continue;
+            const int squared_distance = squaredDistance(neighbor_linear, cell.obstacle);
+            if (squared_distance > max_squared_distance_) continue;
+            bool overwrite = squared_distance < neighbor.squared_distance;
+            if (!overwrite && squared_distance == neighbor.squared_distance) {
+                overwrite = neighbor.obstacle < 0 || !isOccupied(neighbor.obstacle);
+            }
+            if (overwrite) {
+                neighbor.squared_distance = squared_distance;
+                neighbor.obstacle = cell.obstacle;
+                push(squared_distance, neighbor_linear);
+                writeDistance(neighbor_linear);
+            }
+        }
+    }
+}
+
+// Invalidate neighbors whose obstacle was removed, and requeue the others so they can refill the gap.
+void DynamicDistanceField::raise(int linear) {
+    const int row = linear % rows_, col = linear / rows_;
+    for (int dc = -1; dc <= 1; ++dc) {
+        for (int dr = -1; dr <= 1; ++dr) {
+            if ((dr == 0 && dc == 0) || row + dr < 0 || row + dr >= rows_ || col + dc < 0 || col + dc >= cols_) {
+                continue;
+            }
+            const int neighbor_linear = linear + dc * rows_ + dr;
+            auto &neighbor = cells_[neighbor_linear];
+            if (neighbor.obstacle < 0 || neighbor.raise) continue;
+            if (!isOccupied(neighbor.obstacle)) {
+                push(neighbor.squared_distance, neighbor_linear);
+                neighbor.raise = true;
+                neighbor.obstacle = -1;
+                neighbor.squared_distance = max_squared_distance_ + 1;
+                writeDistance(neighbor_linear);
+            } else if (neighbor.state != QueueState::QUEUED) {
+                push(neighbor.squared_distance, neighbor_linear);
+            }
+        }
+    }
+    auto &cell = cells_[linear];
+    cell.raise = false;
+    cell.state = QueueState::RAISE_PROCESSED;
+}
+
+void DynamicDistanceField::push(int squared_distance, int linear) {
+    open_.emplace(squared_distance, linear);
+    cells_[linear].state = QueueState::QUEUED;
+}
+
+void DynamicDistanceField::writeDistance(int linear) {
+    const auto &cell = cells_[linear];
+    distance_data_[linear] =
+        cell.squared_distance > max_squared_distance_
+        ? max_distance_
+        : std::min(max_distance_, static_cast<float>(std::sqrt(cell.squared_distance) * resolution_));
+}
+
+}
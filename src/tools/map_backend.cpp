@@ -0,0 +1,109 @@
+#include <glog/logging.h>
+#include "path_optimizer/tools/map_backend.hpp"
+#include "path_optimizer/tools/quantized_distance_field.hpp"
+#include "path_optimizer/tools/blocked_distance_field.hpp"
+#include "path_optimizer/config/planning_flags.hpp"
+
+namespace PathOptimizationNS {
+
+GridGeometry::GridGeometry(const grid_map::GridMap &grid_map) :
+    GridGeometry(grid_map.getSize()(0), grid_map.getSize()(1), grid_map.getResolution(),
+                 grid_map.getPosition().x(), grid_map.getPosition().y()) {}
+
+GridGeometry::GridGeometry(int rows, int cols, double resolution, double center_x, double center_y) :
+    rows(rows),
+    cols(cols),
+    resolution(resolution),
+    top_x(center_x + 0.5 * rows * resolution),
+    top_y(center_y + 0.5 * cols * resolution) {}
+
+bool GridGeometry::locate(const Eigen::Vector2d &pos, int *row, int *col,
+                          double *row_offset, double *col_offset) const {
+    const double r = (top_x - pos.x()) / resolution;
+    const double c = (top_y - pos.y()) / resolution;
+    if (r < 0 || c < 0 || r >= rows || c >= cols) return false;
+    *row = static_cast<int>(r);
+    *col = static_cast<int>(c);
+    *row_offset = r - *row - 0.5;
+    *col_offset = c - *col - 0.5;
+    return true;
+}
+
+bool GridGeometry::isInside(const Eigen::Vector2d &pos) const {
+    const double r = (top_x - pos.x()) / resolution;
+    const double c = (top_y - pos.y()) / resolution;
+    return r >= 0 && c >= 0 && r < rows && c < cols;
+}
+
+CellIndexer::CellIndexer(CellLayout layout, int rows, int cols) :
+    layout_(layout),
+    rows_(rows) {
+    switch (layout) {
+        case CellLayout::TILED:
+            tile_cols_ = (cols + 7) >> 3;
+            size_ = static_cast<std::size_t>((rows + 7) >> 3) * tile_cols_ << 6;
+            break;
+        case CellLayout::MORTON:
+            tile_cols_ = (cols + 63) >> 6;
+            size_ = static_cast<std::size_t>((rows + 63) >> 6) * tile_cols_ << 12;
+            break;
+        default:
+            size_ = static_cast<std::size_t>(rows) * cols;
+    }
+}
+
+bool parseCellLayout(const std::string &name, CellLayout *layout) {
+    if (name == "column_major") {
+        *layout = CellLayout::COLUMN_MAJOR;
+    } else if (name == "tiled") {
+        *layout = CellLayout::TILED;
+    } else if (name == "morton") {
+        *layout = CellLayout::MORTON;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+GridMapBackend::GridMapBackend(const grid_map::GridMap &grid_map) :
+    maps(grid_map),
+    has_signed_distance_(grid_map.exists("signed_distance")) {
+    if (!grid_map.exists("distance")) {
+        LOG(ERROR) << "grid map must contain 'distance' layer";
+    }
+}
+
+bool GridMapBackend::isInside(const Eigen::Vector2d &pos) const {
+    return maps.isInside(pos);
+}
+
+double GridMapBackend::getObstacleDistance(const Eigen::Vector2d &pos) const {
+    return maps.atPosition("distance", pos, grid_map::InterpolationMethods::INTER_LINEAR);
+}
+
+bool GridMapBackend::hasSignedDistance() const {
+    return has_signed_distance_;
+}
+
+double GridMapBackend::getSignedDistance(const Eigen::Vector2d &pos) const {
+    return maps.atPosition("signed_distance", pos, grid_map::InterpolationMethods::INTER_LINEAR);
+}
+
+double GridMapBackend::getResolution() const {
+    return maps.getResolution();
+}
+
+std::shared_ptr<const MapBackend> createMapBackend(const grid_map::GridMap &grid_map) {
+    CellLayout layout = CellLayout::COLUMN_MAJOR;
+    parseCellLayout(FLAGS_distance_layer_layout, &layout);
+    if (FLAGS_distance_layer_bits == 8) {
+        return std::make_shared<QuantizedDistanceField<uint8_t>>(grid_map, FLAGS_quantized_max_distance, layout);
+    } else if (FLAGS_distance_layer_bits == 16) {
+        return std::make_shared<QuantizedDistanceField<uint16_t>>(grid_map, FLAGS_quantized_max_distance, layout);
+    } else if (layout != CellLayout::COLUMN_MAJOR) {
+        return std::make_shared<BlockedDistanceField>(grid_map, layout);
+    }
+    return std::make_shared<GridMapBackend>(grid_map);
+}
+
+}
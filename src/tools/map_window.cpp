@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cmath>
+#include <glog/logging.h>
+#include "path_optimizer/tools/map_window.hpp"
+#include "path_optimizer/data_struct/data_struct.hpp"
+#include "path_optimizer/config/planning_flags.hpp"
+
+namespace PathOptimizationNS {
+
+MapWindow::MapWindow(const grid_map::GridMap &grid_map,
+                     const Eigen::Vector2d &min_corner,
+                     const Eigen::Vector2d &max_corner) :
+    geometry_(grid_map),
+    start_row_(grid_map.getStartIndex()(0)),
+    start_col_(grid_map.getStartIndex()(1)) {
+    if (!grid_map.exists("distance")) {
+        LOG(ERROR) << "grid map must contain 'distance' layer";
+        return;
+    }
+    distance_ = grid_map.get("distance").data();
+    if (grid_map.exists("signed_distance")) signed_distance_ = grid_map.get("signed_distance").data();
+    // Rows grow along -x and columns along -y.
+    const auto clip = [](double index, int size) {
+        return static_cast<int>(std::max(0.0, std::min<double>(size, index)));
+    };
+    row_begin_ = clip(std::floor((geometry_.top_x - max_corner.x()) / geometry_.resolution), geometry_.rows);
+    row_end_ = clip(std::floor((geometry_.top_x - min_corner.x()) / geometry_.resolution) + 1, geometry_.rows);
+    col_begin_ = clip(std::floor((geometry_.top_y - max_corner.y()) / geometry_.resolution), geometry_.cols);
+    col_end_ = clip(std::floor((geometry_.top_y - min_corner.y()) / geometry_.resolution) + 1, geometry_.cols);
+    row_end_ = std::max(row_begin_, row_end_);
+    col_end_ = std::max(col_begin_, col_end_);
+}
+
+std::shared_ptr<MapWindow> MapWindow::aroundRoute(const grid_map::GridMap &grid_map,
+                                                  const std::vector<State> &route,
+                                                  double margin) {
+    if (margin < 0) margin = FLAGS_search_lateral_range + 5.0;
+    // Bounding box of the corridor first, then its rows are narrowed.
+    Eigen::Vector2d min_corner(0, 0), max_corner(0, 0);
+    if (!route.empty()) {
+        min_corner << route.front().x, route.front().y;
+        max_corner = min_corner;
+        for (const auto &state : route) {
+            min_corner.x() = std::min(min_corner.x(), state.x);
+            min_corner.y() = std::min(min_corner.y(), state.y);
+            max_corner.x() = std::max(max_corner.x(), state.x);
+            max_corner.y() = std::max(max_corner.y(), state.y);
+        }
+        min_corner.array() -= margin;
+        max_corner.array() += margin;
+    } else {
+        LOG(WARNING) << "Empty route, the map window is empty.";
+        // Inverted box, no cells.
+        min_corner.setConstant(1);
+        max_corner.setConstant(-1);
+    }
+    auto window = std::make_shared<MapWindow>(grid_map, min_corner, max_corner);
+    if (!route.empty()) window->keepCorridor(route, margin);
+    return window;
+}
+
+void MapWindow::keepCorridor(const std::vector<State> &route, double margin) {
+    const int rows = row_end_ - row_begin_;
+    span_begin_.assign(static_cast<std::size_t>(rows), col_end_);
+    span_end_.assign(static_cast<std::size_t>(rows), col_begin_);
+    // Discs of this radius centered every cell along the route cover every point within margin of it.
+    const double radius = std::sqrt(margin * margin + 0.25 * geometry_.resolution * geometry_.resolution)
+        / geometry_.resolution;
+    const auto cover = [&](double x, double y) {
+        // Disc center in cells.
+        const double center_row = (geometry_.top_x - x) / geometry_.resolution;
+        const double center_col = (geometry_.top_y - y) / geometry_.resolution;
+        const int first_row = std::max(row_begin_, static_cast<int>(std::floor(center_row - radius)));
+        const int last_row = std::min(row_end_ - 1, static_cast<int>(std::floor(center_row + radius)));
+        for (int row = first_row; row <= last_row; ++row) {
+            // Widest chord of the disc in the band of the row.
+            const double row_distance = std::max(0.0, std::max(row - center_row, center_row - row - 1));
+            const double half_width = std::sqrt(std::max(0.0, radius * radius - row_distance * row_distance));
+            const int begin = std::max(col_begin_, static_cast<int>(std::floor(center_col - half_width)));
+            const int end = std::min(col_end_, static_cast<int>(std::floor(center_col + half_width)) + 1);
+            if (begin >= end) continue;
+            const auto i = static_cast<std::size_t>(row - row_begin_);
+            span_begin_[i] = std::min(span_begin_[i], begin);
+            span_end_[i] = std::max(span_end_[i], end);
+        }
+    };
+    cover(route.front().x, route.front().y);
+    for (size_t i = 1; i < route.size(); ++i) {
+        const double dx = route[i].x - route[i - 1].x;
+        const double dy = route[i].y - route[i - 1].y;
+        const auto steps = std::max(1, static_cast<int>(std::ceil(std::hypot(dx, dy) / geometry_.resolution)));
+        for (int step = 1; step <= steps; ++step) {
+            const double t = static_cast<double>(step) / steps;
+            cover(route[i - 1].x + t * dx, route[i - 1].y + t * dy);
+        }
+    }
+}
+
+float MapWindow::cell(const float *data, int row, int col) const {
+    row += start_row_;
+    if (row >= geometry_.rows) row -= geometry_.rows;
+    col += start_col_;
+    if (col >= geometry_.cols) col -= geometry_.cols;
+    return data[static_cast<std::size_t>(col) * geometry_.rows + row];
+}
+
+bool MapWindow::isInside(const Eigen::Vector2d &pos) const {
+    const double r = (geometry_.top_x - pos.x()) / geometry_.resolution;
+    const double c = (geometry_.top_y - pos.y()) / geometry_.resolution;
+    if (!(r >= row_begin_ && r < row_end_ && c >= col_begin_ && c < col_end_)) return false;
+    if (span_begin_.empty()) return true;
+    const auto i = static_cast<std::size_t>(static_cast<int>(r) - row_begin_);
+    return c >= span_begin_[i] && c < span_end_[i];
+}
+
+double MapWindow::getObstacleDistance(const Eigen::Vector2d &pos) const {
+    return interpolateBilinear(geometry_, pos, [this](int row, int col) { return cell(distance_, row, col); });
+}
+
+bool MapWindow::hasSignedDistance() const {
+    return signed_distance_ != nullptr;
+}
+
+double MapWindow::getSignedDistance(const Eigen::Vector2d &pos) const {
+    return interpolateBilinear(geometry_, pos, [this](int row, int col) { return cell(signed_distance_, row, col); });
+}
+
+double MapWindow::getResolution() const {
+    return geometry_.resolution;
+}
+
+std::size_t MapWindow::touchedBytes() const {
+    if (row_end_ == row_begin_ || col_end_ == col_begin_) return 0;
+    const std::size_t layers = (distance_ ? 1 : 0) + (signed_distance_ ? 1 : 0);
+    if (span_begin_.empty()) {
+        const auto rows =
+            static_cast<std::size_t>(std::min(row_end_ + 1, geometry_.rows) - std::max(row_begin_ - 1, 0));
+        const auto cols =
+            static_cast<std::size_t>(std::min(col_end_ + 1, geometry_.cols) - std::max(col_begin_ - 1, 0));
+        return rows * cols * sizeof(float) * layers;
+    }
+    // Every map row next to a window row: the columns of the neighboring spans, one more on each side.
+    std::size_t cells = 0;
+    for (int row = std::max(row_begin_ - 1, 0); row < std::min(row_end_ + 1, geometry_.rows); ++row) {
+        int begin = geometry_.cols, end = 0;
+        for (int neighbor = std::max(row - 1, row_begin_); neighbor <= std::min(row + 1, row_end_ - 1); ++neighbor) {
+            const auto i = static_cast<std::size_t>(neighbor - row_begin_);
+            if (span_begin_[i] >= span_end_[i]) continue;
+            begin = std::min(begin, std::max(span_begin_[i] - 1, 0));
+            end = std::max(end, std::min(span_end_[i] + 1, geometry_.cols));
+        }
+        if (begin < end) cells += static_cast<std::size_t>(end - begin);
+    }
+    return cells * sizeof(float) * layers;
+}
+
+}
@@ -0,0 +1,301 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <glog/logging.h>
+#include "path_optimizer/tools/metrics.hpp"
+#include "path_optimizer/config/planning_flags.hpp"
+
+namespace PathOptimizationNS {
+
+constexpr int Histogram::kSubBucketBits;
+constexpr int Histogram::kSubBuckets;
+constexpr int Histogram::kBucketCount;
+
+Histogram::Histogram() {
+    for (auto &bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+}
+
+int Histogram::bucketIndex(uint64_t value) {
+    if (value < 2 * kSubBuckets) return static_cast<int>(value);
+    const int magnitude = 63 - __builtin_clzll(value);
+    const int shift = magnitude - kSubBucketBits;
+    const auto top = static_cast<int>(value >> shift);
+    return (shift + 1) * kSubBuckets + top - kSubBuckets;
+}
+
+uint64_t Histogram::bucketLowest(int index) {
+    if (index < 2 * kSubBuckets) return static_cast<uint64_t>(index);
+    const int shift = index / kSubBuckets - 1;
+    const uint64_t top = index % kSubBuckets + kSubBuckets;
+    return top << shift;
+}
+
+uint64_t Histogram::bucketHighest(int index) {
+    if (index < 2 * kSubBuckets) return static_cast<uint64_t>(index);
+    const int shift = index / kSubBuckets - 1;
+    const uint64_t top = index % kSubBuckets + kSubBuckets;
+    return ((top + 1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t value) {
+    buckets_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    uint64_t current_max = max_.load(std::memory_order_relaxed);
+    while (value > current_max && !max_.compare_exchange_weak(current_max, value, std::memory_order_relaxed)) {}
+}
+
+uint64_t Histogram::count() const {
+    return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::sum() const {
+    return sum_.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::max() const {
+    return max_.load(std::memory_order_relaxed);
+}
+
+double Histogram::quantile(double q) const {
+    // Buckets may be updated concurrently, so rank against a total taken from the buckets themselves.
+    uint64_t total = 0;
+    for (const auto &bucket : buckets_) total += bucket.load(std::memory_order_relaxed);
+    if (total == 0) return 0;
+    q = std::min(std::max(q, 0.0), 1.0);
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * total)));
+    uint64_t cumulative = 0;
+    for (int i = 0; i != kBucketCount; ++i) {
+        cumulative += buckets_[i].load(std::memory_order_relaxed);
+        if (cumulative >= rank) {
+            const double mid = 0.5 * (static_cast<double>(bucketLowest(i)) + static_cast<double>(bucketHighest(i)));
+            return std::min(mid, static_cast<double>(max()));
+        }
+    }
+    return static_cast<double>(max());
+}
+
+void Histogram::reset() {
+    for (auto &bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+double ScopedLatency::stop() {
+    if (histogram_) {
+        auto elapsed = std::chrono::steady_clock::now() - begin_;
+        histogram_->record(static_cast<uint64_t>(
+                               std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+        elapsed_ms_ = std::chrono::duration<double, std::milli>(elapsed).count();
+        histogram_ = nullptr;
+    }
+    return elapsed_ms_;
+}
+
+MetricsRegistry &MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+Counter *MetricsRegistry::counter(const std::string &family, const std::string &labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &metric = counters_[family][labels];
+    if (!metric) metric.reset(new Counter);
+    return metric.get();
+}
+
+Histogram *MetricsRegistry::histogram(const std::string &family, const std::string &labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &metric = histograms_[family][labels];
+    if (!metric) metric.reset(new Histogram);
+    return metric.get();
+}
+
+const Counter *MetricsRegistry::findCounter(const std::string &family, const std::string &labels) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto family_iter = counters_.find(family);
+    if (family_iter == counters_.end()) return nullptr;
+    auto iter = family_iter->second.find(labels);
+    return iter == family_iter->second.end() ? nullptr : iter->second.get();
+}
+
+const Histogram *MetricsRegistry::findHistogram(const std::string &family, const std::string &labels) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto family_iter = histograms_.find(family);
+    if (family_iter == histograms_.end()) return nullptr;
+    auto iter = family_iter->second.find(labels);
+    return iter == family_iter->second.end() ? nullptr : iter->second.get();
+}
+
+namespace {
+std::string withLabels(const std::string &name, const std::string &labels, const std::string &extra = "") {
+    if (labels.empty() && extra.empty()) return name;
+    if (labels.empty()) return name + "{" + extra + "}";
+    if (extra.empty()) return name + "{" + labels + "}";
+    return name + "{" + labels + "," + extra + "}";
+}
+}
+
+std::string MetricsRegistry::toPrometheusText() const {
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    std::ostringstream out;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &family : counters_) {
+        out << "# TYPE " << family.first << " counter\n";
+        for (const auto &metric : family.second) {
+            out << withLabels(family.first, metric.first) << " " << metric.second->value() << "\n";
+        }
+    }
+    for (const auto &family : histograms_) {
+        out << "# TYPE " << family.first << " summary\n";
+        for (const auto &metric : family.second) {
+            for (double q : quantiles) {
+                std::ostringstream quantile_label;
+                quantile_label << "quantile=\"" << q << "\"";
+                out << withLabels(family.first, metric.first, quantile_label.str()) << " "
+                    << metric.second->quantile(q) << "\n";
+            }
+            out << withLabels(family.first + "_sum", metric.first) << " " << metric.second->sum() << "\n";
+            out << withLabels(family.first + "_count", metric.first) << " " << metric.second->count() << "\n";
+        }
+        out << "# TYPE " << family.first << "_max gauge\n";
+        for (const auto &metric : family.second) {
+            out << withLabels(family.first + "_max", metric.first) << " " << metric.second->max() << "\n";
+        }
+    }
+    return out.str();
+}
+
+bool MetricsRegistry::dumpPrometheus(const std::string &file) const {
+    const std::string tmp_file = file + ".tmp";
+    {
+        std::ofstream out(tmp_file);
+        if (!out) {
+            LOG(WARNING) << "Cannot open metrics file " << tmp_file;
+            return false;
+        }
+        out << toPrometheusText();
+        if (!out) return false;
+    }
+    if (std::rename(tmp_file.c_str(), file.c_str()) != 0) {
+        LOG(WARNING) << "Cannot rename " << tmp_file << " to " << file;
+        return false;
+    }
+    return true;
+}
+
+void MetricsRegistry::maybeDump() {
+    if (FLAGS_metrics_file.empty()) return;
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t last = last_dump_ns_.load(std::memory_order_relaxed);
+    if (last != 0 && now - last < static_cast<int64_t>(FLAGS_metrics_dump_interval * 1e9)) return;
+    // Only one thread dumps per interval.
+    if (!last_dump_ns_.compare_exchange_strong(last, now)) return;
+    dumpPrometheus(FLAGS_metrics_file);
+}
+
+void MetricsRegistry::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &family : counters_) {
+        for (auto &metric : family.second) metric.second->reset();
+    }
+    for (auto &family : histograms_) {
+        for (auto &metric : family.second) metric.second->reset();
+    }
+}
+
+const char *toString(PlanningStage stage) {
+    switch (stage) {
+        case PlanningStage::SOLVE: return "solve";
+        case PlanningStage::SOLVE_WITHOUT_SMOOTHING: return "solve_without_smoothing";
+        case PlanningStage::SMOOTHING: return "smoothing";
+        case PlanningStage::SEARCH: return "search";
+        case PlanningStage::SEGMENTATION: return "segmentation";
+        case PlanningStage::BOUNDS: return "bounds";
+        case PlanningStage::QP_BUILD: return "qp_build";
+        case PlanningStage::QP_SOLVE: return "qp_solve";
+        case PlanningStage::OUTPUT_CHECK: return "output_check";
+        default: return "unknown";
+    }
+}
+
+const char *toString(FailureReason reason) {
+    switch (reason) {
+        case FailureReason::EMPTY_INPUT: return "empty_input";
+        case FailureReason::SMOOTHING_FAILED: return "smoothing_failed";
+        case FailureReason::SEARCH_FAILED: return "search_failed";
+        case FailureReason::LARGE_HEADING_ERROR: return "heading_error";
+        case FailureReason::EMPTY_REFERENCE: return "empty_reference";
+        case FailureReason::PATH_BLOCKED: return "path_blocked";
+        case FailureReason::QP_FAILED: return "qp_failed";
+        case FailureReason::COLLISION: return "collision";
+        case FailureReason::DEADLINE: return "deadline";
+        default: return "unknown";
+    }
+}
+
+Histogram *stageLatency(PlanningStage stage) {
+    // Registered once; afterwards a lookup is an array access.
+    static Histogram *const *histograms = [] {
+        static Histogram *list[static_cast<int>(PlanningStage::NUM_STAGES)];
+        for (int i = 0; i != static_cast<int>(PlanningStage::NUM_STAGES); ++i) {
+            list[i] = MetricsRegistry::instance().histogram(
+                "path_optimizer_stage_latency_us",
+                std::string("stage=\"") + toString(static_cast<PlanningStage>(i)) + "\"");
+        }
+        return list;
+    }();
+    return histograms[static_cast<int>(stage)];
+}
+
+void countFailure(FailureReason reason) {
+    static Counter *const *counters = [] {
+        static Counter *list[static_cast<int>(FailureReason::NUM_REASONS)];
+        for (int i = 0; i != static_cast<int>(FailureReason::NUM_REASONS); ++i) {
+            list[i] = MetricsRegistry::instance().counter(
+                "path_optimizer_failures_total",
+                std::string("reason=\"") + toString(static_cast<FailureReason>(i)) + "\"");
+        }
+        return list;
+    }();
+    counters[static_cast<int>(reason)]->increment();
+}
+
+Histogram *collisionStation() {
+    static Histogram *histogram = MetricsRegistry::instance().histogram("path_optimizer_collision_station_cm");
+    return histogram;
+}
+
+Histogram *arenaBytes() {
+    static Histogram *histogram = MetricsRegistry::instance().histogram("path_optimizer_arena_bytes");
+    return histogram;
+}
+
+void countSolve(bool success) {
+    static Counter *succeeded = MetricsRegistry::instance().counter("path_optimizer_solves_total",
+                                                                    "result=\"success\"");
+    static Counter *failed = MetricsRegistry::instance().counter("path_optimizer_solves_total",
+                                                                 "result=\"failure\"");
+    (success ? succeeded : failed)->increment();
+}
+
+void countPortfolioResult(const std::string &solver, PortfolioResult result) {
+    const char *name = result == PortfolioResult::WON ? "won" :
+                       result == PortfolioResult::FEASIBLE ? "feasible" : "failed";
+    // A few solvers, looked up once per solve.
+    MetricsRegistry::instance().counter("path_optimizer_portfolio_results_total",
+                                        "solver=\"" + solver + "\",result=\"" + name + "\"")->increment();
+}
+
+void countQpSetup(bool reused) {
+    static Counter *reused_counter = MetricsRegistry::instance().counter("path_optimizer_qp_setups_total",
+                                                                         "result=\"reused\"");
+    static Counter *setup_counter = MetricsRegistry::instance().counter("path_optimizer_qp_setups_total",
+                                                                        "result=\"setup\"");
+    (reused ? reused_counter : setup_counter)->increment();
+}
+
+}
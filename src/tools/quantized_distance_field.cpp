@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <glog/logging.h>
+#include "path_optimizer/tools/quantized_distance_field.hpp"
+
+namespace PathOptimizationNS {
+
+namespace {
+const int kWeightBits = 12;
+const int64_t kWeightOne = 1 << kWeightBits;
+}
+
+template <typename T>
+QuantizedDistanceField<T>::QuantizedDistanceField(const grid_map::GridMap &grid_map, double max_distance,
+                                                  CellLayout layout) :
+    geometry_(grid_map),
+    indexer_(layout, geometry_.rows, geometry_.cols),
+    max_distance_(max_distance),
+    step_(max_distance / std::numeric_limits<T>::max()) {
+    CHECK_GT(max_distance, 0);
+    if (!grid_map.exists("distance")) {
+        LOG(ERROR) << "grid map must contain 'distance' layer";
+        distance_.assign(indexer_.size(), 0);
+    } else {
+        quantize(grid_map, "distance", false, &distance_);
+    }
+    if (grid_map.exists("signed_distance")) quantize(grid_map, "signed_distance", true, &signed_distance_);
+}
+
+template <typename T>
+void QuantizedDistanceField<T>::quantize(const grid_map::GridMap &grid_map, const std::string &layer,
+                                         bool is_signed, std::vector<T> *cells) const {
+    const auto &data = grid_map.get(layer);
+    const grid_map::Index &start = grid_map.getStartIndex();
+    const int rows = geometry_.rows, cols = geometry_.cols;
+    cells->assign(indexer_.size(), 0);
+    for (int c = 0; c != cols; ++c) {
+        const int data_col = (c + start(1)) % cols;
+        for (int r = 0; r != rows; ++r) {
+            const double value = data((r + start(0)) % rows, data_col);
+            const double units = is_signed
+                                 ? (std::max(-max_distance_, std::min(max_distance_, value)) + max_distance_)
+                                     / (2 * step_)
+                                 : std::max(0.0, std::min(max_distance_, value)) / step_;
+            (*cells)[indexer_.offset(r, c)] = static_cast<T>(std::lround(units));
+        }
+    }
+}
+
+template <typename T>
+double QuantizedDistanceField<T>::interpolate(const std::vector<T> &cells, const Eigen::Vector2d &pos) const {
+    int row, col;
+    double dr, dc;
+    geometry_.locate(pos, &row, &col, &dr, &dc);
+    const int other_row = dr < 0 ? row - 1 : row + 1;
+    const int other_col = dc < 0 ? col - 1 : col + 1;
+    if (other_row < 0 || other_row >= geometry_.rows || other_col < 0 || other_col >= geometry_.cols) {
+        return cells[indexer_.offset(row, col)];
+    }
+    const auto wr = static_cast<int64_t>(std::fabs(dr) * kWeightOne + 0.5);
+    const auto wc = static_cast<int64_t>(std::fabs(dc) * kWeightOne + 0.5);
+    const int64_t near_row = (kWeightOne - wc) * cells[indexer_.offset(row, col)]
+        + wc * cells[indexer_.offset(row, other_col)];
+    const int64_t far_row = (kWeightOne - wc) * cells[indexer_.offset(other_row, col)]
+        + wc * cells[indexer_.offset(other_row, other_col)];
+    const int64_t sum = (kWeightOne - wr) * near_row + wr * far_row;
+    return static_cast<double>(sum) / (kWeightOne * kWeightOne);
+}
+
+template <typename T>
+bool QuantizedDistanceField<T>::isInside(const Eigen::Vector2d &pos) const {
+    return geometry_.isInside(pos);
+}
+
+template <typename T>
+double QuantizedDistanceField<T>::getObstacleDistance(const Eigen::Vector2d &pos) const {
+    return std::max(0.0, interpolate(distance_, pos) * step_ - maxError());
+}
+
+template <typename T>
+bool QuantizedDistanceField<T>::hasSignedDistance() const {
+    return !signed_distance_.empty();
+}
+
+template <typename T>
+double QuantizedDistanceField<T>::getSignedDistance(const Eigen::Vector2d &pos) const {
+    // Less the error bound of signed distances.
+    const double max_error = step_ + geometry_.resolution / kWeightOne;
+    return interpolate(signed_distance_, pos) * 2 * step_ - max_distance_ - max_error;
+}
+
+template <typename T>
+double QuantizedDistanceField<T>::getResolution() const {
+    return geometry_.resolution;
+}
+
+template <typename T>
+double QuantizedDistanceField<T>::maxError() const {
+    return step_ / 2 + geometry_.resolution / kWeightOne;
+}
+
+template class QuantizedDistanceField<uint8_t>;
+template class QuantizedDistanceField<uint16_t>;
+
+}
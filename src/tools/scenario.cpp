@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <dirent.h>
+#include <glog/logging.h>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include "path_optimizer/tools/scenario.hpp"
+#include "path_optimizer/tools/scenario_generator.hpp"
+#include "path_optimizer/tools/Map.hpp"
+
+namespace PathOptimizationNS {
+
+namespace {
+std::string directoryOf(const std::string &file) {
+    auto pos = file.find_last_of('/');
+    return pos == std::string::npos ? "." : file.substr(0, pos);
+}
+
+std::string resolve(const std::string &dir, const std::string &file) {
+    return !file.empty() && file[0] == '/' ? file : dir + "/" + file;
+}
+
+std::string stem(const std::string &file) {
+    auto begin = file.find_last_of('/');
+    begin = begin == std::string::npos ? 0 : begin + 1;
+    auto end = file.find_last_of('.');
+    return file.substr(begin, end == std::string::npos || end < begin ? std::string::npos : end - begin);
+}
+
+bool endsWith(const std::string &str, const std::string &suffix) {
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool setSyntheticField(const std::string &name, std::istringstream *fields, SyntheticScenarioConfig *config) {
+    if (name == "seed") return static_cast<bool>(*fields >> config->seed);
+    if (name == "map_size") return static_cast<bool>(*fields >> config->map_size);
+    if (name == "resolution") return static_cast<bool>(*fields >> config->resolution);
+    if (name == "obstacle_density") return static_cast<bool>(*fields >> config->obstacle_density);
+    if (name == "corridor_width") return static_cast<bool>(*fields >> config->corridor_width);
+    if (name == "route_length") return static_cast<bool>(*fields >> config->route_length);
+    if (name == "max_curvature") return static_cast<bool>(*fields >> config->max_curvature);
+    if (name == "point_spacing") return static_cast<bool>(*fields >> config->point_spacing);
+    return false;
+}
+}
+
+void gridMapFromImage(const cv::Mat &image,
+                      double resolution,
+                      const grid_map::Position &origin,
+                      grid_map::GridMap *grid_map) {
+    CHECK_NOTNULL(grid_map);
+    // Same layout as GridMapCvConverter::initializeFromImage: image (row, col) is grid map index (row, col).
+    grid_map->setGeometry(grid_map::Length(image.rows * resolution, image.cols * resolution), resolution, origin);
+    grid_map->add("obstacle");
+    auto &obstacle_layer = grid_map->get("obstacle");
+    for (int r = 0; r != image.rows; ++r) {
+        const auto *image_row = image.ptr<unsigned char>(r);
+        for (int c = 0; c != image.cols; ++c) obstacle_layer(r, c) = image_row[c];
+    }
+    Map::buildSignedDistanceField(grid_map);
+    grid_map->setFrameId("/map");
+}
+
+bool loadScenario(const std::string &file, Scenario *scenario) {
+    CHECK_NOTNULL(scenario);
+    std::ifstream in(file);
+    if (!in) {
+        LOG(WARNING) << "Cannot open scenario " << file;
+        return false;
+    }
+    const auto dir = directoryOf(file);
+    scenario->name = stem(file);
+    scenario->reference_points.clear();
+    scenario->flags.clear();
+    double resolution = 0.2;
+    grid_map::Position origin = grid_map::Position::Zero();
+    std::string image_file, distance_file;
+    int rows = 0, cols = 0;
+    bool has_start = false, has_goal = false;
+    SyntheticScenarioConfig synthetic_config;
+    bool synthetic = false;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(in, line)) {
+        ++line_number;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string key;
+        if (!(fields >> key)) continue;
+        bool ok = true;
+        if (key == "map") {
+            ok = static_cast<bool>(fields >> image_file);
+        } else if (key == "distance_field") {
+            ok = static_cast<bool>(fields >> distance_file >> rows >> cols) && rows > 0 && cols > 0;
+        } else if (key == "resolution") {
+            ok = static_cast<bool>(fields >> resolution) && resolution > 0;
+        } else if (key == "origin") {
+            ok = static_cast<bool>(fields >> origin.x() >> origin.y());
+        } else if (key == "start") {
+            ok = has_start = static_cast<bool>(fields >> scenario->start.x >> scenario->start.y >> scenario->start.z);
+        } else if (key == "goal") {
+            ok = has_goal = static_cast<bool>(fields >> scenario->goal.x >> scenario->goal.y >> scenario->goal.z);
+        } else if (key == "point") {
+            State point;
+            ok = static_cast<bool>(fields >> point.x >> point.y);
+            scenario->reference_points.emplace_back(point);
+        } else if (key == "flag") {
+            std::string name, value;
+            ok = static_cast<bool>(fields >> name >> value);
+            scenario->flags.emplace_back(name, value);
+        } else if (key == "synthetic") {
+            std::string name;
+            ok = synthetic = static_cast<bool>(fields >> name) && setSyntheticField(name, &fields, &synthetic_config);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            LOG(WARNING) << file << ":" << line_number << ": cannot parse \"" << line << "\"";
+            return false;
+        }
+    }
+    if (synthetic) {
+        if (has_start || has_goal || !scenario->reference_points.empty() || !image_file.empty()
+            || !distance_file.empty()) {
+            LOG(WARNING) << file << ": a synthetic scenario takes no map, start, goal or reference points";
+            return false;
+        }
+        // generateScenario replaces the name and the flags.
+        const auto name = scenario->name;
+        const auto flags = scenario->flags;
+        if (!generateScenario(synthetic_config, scenario)) return false;
+        scenario->name = name;
+        scenario->flags = flags;
+        return true;
+    }
+    if (!has_start || !has_goal || scenario->reference_points.empty()) {
+        LOG(WARNING) << file << ": start, goal and reference points are required";
+        return false;
+    }
+
+    if (!image_file.empty()) {
+        cv::Mat image = cv::imread(resolve(dir, image_file), cv::IMREAD_GRAYSCALE);
+        if (image.empty()) {
+            LOG(WARNING) << "Cannot read map image " << resolve(dir, image_file);
+            return false;
+        }
+        gridMapFromImage(image, resolution, origin, &scenario->map);
+    } else if (!distance_file.empty()) {
+        std::ifstream raw(resolve(dir, distance_file), std::ios::binary);
+        std::vector<float> values(static_cast<size_t>(rows) * cols);
+        if (!raw.read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(float))) {
+            LOG(WARNING) << "Cannot read " << rows << "x" << cols << " distance field "
+                         << resolve(dir, distance_file);
+            return false;
+        }
+        scenario->map.setGeometry(grid_map::Length(rows * resolution, cols * resolution), resolution, origin);
+        scenario->map.add("distance");
+        auto &distance_layer = scenario->map.get("distance");
+        for (int r = 0; r != rows; ++r) {
+            for (int c = 0; c != cols; ++c) distance_layer(r, c) = values[static_cast<size_t>(r) * cols + c];
+        }
+        scenario->map.setFrameId("/map");
+    } else {
+        LOG(WARNING) << file << ": either map or distance_field is required";
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::string> listScenarioFiles(const std::string &dir) {
+    std::vector<std::string> files;
+    DIR *handle = opendir(dir.c_str());
+    if (!handle) {
+        LOG(WARNING) << "Cannot open scenario directory " << dir;
+        return files;
+    }
+    while (auto entry = readdir(handle)) {
+        std::string name = entry->d_name;
+        if (endsWith(name, ".scenario")) files.emplace_back(dir + "/" + name);
+    }
+    closedir(handle);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+}
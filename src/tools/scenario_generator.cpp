@@ -0,0 +1,115 @@
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <glog/logging.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "path_optimizer/tools/scenario_generator.hpp"
+#include "path_optimizer/tools/tools.hpp"
+
+namespace PathOptimizationNS {
+
+namespace {
+// std::uniform_real_distribution differs between standard libraries, this does not.
+double uniform(std::mt19937 *generator, double lower, double upper) {
+    return lower + (upper - lower) * ((*generator)() / 4294967296.0);
+}
+
+// Pixel of a position, with the layout of gridMapFromImage for a map covering [0, extent] x [0, extent].
+cv::Point toPixel(double x, double y, double extent, double resolution) {
+    return cv::Point(static_cast<int>((extent - y) / resolution), static_cast<int>((extent - x) / resolution));
+}
+}
+
+bool generateScenario(const SyntheticScenarioConfig &config, Scenario *scenario) {
+    CHECK_NOTNULL(scenario);
+    if (config.map_size <= 0 || config.resolution <= 0 || config.point_spacing <= 0
+        || config.map_size < 2 * config.corridor_width) {
+        LOG(WARNING) << "Invalid synthetic scenario config.";
+        return false;
+    }
+    std::mt19937 generator(config.seed);
+    const double size = config.map_size;
+    const auto pixels = static_cast<int>(std::ceil(size / config.resolution));
+    const double extent = pixels * config.resolution;
+
+    // Reference line: curvature ramps towards a random target on every segment, and turns fully
+    // towards the map center when the route gets close to the border heading outwards.
+    const double margin = std::min(config.corridor_width + 10, size / 4);
+    const double step = std::min(0.1, config.point_spacing);
+    double x = uniform(&generator, margin, size - margin);
+    double y = uniform(&generator, margin, size - margin);
+    double heading = atan2(size / 2 - y, size / 2 - x) + uniform(&generator, -M_PI / 4, M_PI / 4);
+    double curvature = 0;
+    double target_curvature = 0;
+    double segment_left = 0;
+    double s = 0;
+    double next_point_s = 0;
+    scenario->reference_points.clear();
+    while (s <= config.route_length) {
+        if (s >= next_point_s) {
+            scenario->reference_points.emplace_back(x, y, heading, curvature, s);
+            next_point_s += config.point_spacing;
+        }
+        if (segment_left <= 0) {
+            segment_left = uniform(&generator, 10, 40);
+            target_curvature = uniform(&generator, -config.max_curvature, config.max_curvature);
+        }
+        const double to_center_x = size / 2 - x, to_center_y = size / 2 - y;
+        const bool near_border = x < margin || y < margin || x > size - margin || y > size - margin;
+        if (near_border && cos(heading) * to_center_x + sin(heading) * to_center_y < 0) {
+            curvature = cos(heading) * to_center_y - sin(heading) * to_center_x > 0 ? config.max_curvature
+                                                                                     : -config.max_curvature;
+        } else {
+            curvature += (target_curvature - curvature) * std::min(1.0, step / segment_left);
+        }
+        heading = constraintAngle(heading + curvature * step);
+        x += step * cos(heading);
+        y += step * sin(heading);
+        s += step;
+        segment_left -= step;
+        if (x < 0 || y < 0 || x > size || y > size) break;
+    }
+    if (scenario->reference_points.size() < 2) {
+        LOG(WARNING) << "Synthetic route is too short.";
+        return false;
+    }
+
+    // Obstacles, then the corridor is cleared along the route.
+    cv::Mat image(pixels, pixels, CV_8UC1, cv::Scalar(255));
+    const double mean_obstacle_area = 11.8;  // Mean of the circles and boxes below, in m^2.
+    const auto obstacle_num = static_cast<int>(config.obstacle_density * size * size / mean_obstacle_area);
+    for (int i = 0; i != obstacle_num; ++i) {
+        const auto center = toPixel(uniform(&generator, 0, size), uniform(&generator, 0, size), extent,
+                                    config.resolution);
+        if (generator() % 2) {
+            const auto radius = static_cast<int>(uniform(&generator, 0.5, 3) / config.resolution);
+            cv::circle(image, center, radius, cv::Scalar(0), cv::FILLED);
+        } else {
+            const auto half_rows = static_cast<int>(uniform(&generator, 0.5, 3) / config.resolution);
+            const auto half_cols = static_cast<int>(uniform(&generator, 0.5, 3) / config.resolution);
+            cv::rectangle(image,
+                          cv::Point(center.x - half_cols, center.y - half_rows),
+                          cv::Point(center.x + half_cols, center.y + half_rows),
+                          cv::Scalar(0), cv::FILLED);
+        }
+    }
+    const auto corridor_pixels = std::max(1, static_cast<int>(config.corridor_width / config.resolution));
+    const auto &points = scenario->reference_points;
+    for (size_t i = 1; i != points.size(); ++i) {
+        cv::line(image,
+                 toPixel(points[i - 1].x, points[i - 1].y, extent, config.resolution),
+                 toPixel(points[i].x, points[i].y, extent, config.resolution),
+                 cv::Scalar(255), corridor_pixels);
+    }
+
+    gridMapFromImage(image, config.resolution, grid_map::Position(extent / 2, extent / 2), &scenario->map);
+    scenario->start = points.front();
+    scenario->goal = points.back();
+    scenario->flags.clear();
+    std::ostringstream name;
+    name << "synthetic_" << config.seed << "_" << config.map_size << "m_" << static_cast<int>(points.back().s) << "m";
+    scenario->name = name.str();
+    return true;
+}
+
+}
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glog/logging.h>
+#include "path_optimizer/tools/tiled_distance_field.hpp"
+
+namespace PathOptimizationNS {
+
+namespace {
+const char kMagic[8] = {'P', 'O', 'D', 'T', 'I', 'L', 'E', '1'};
+const uint32_t kVersion = 1;
+const int kTileShift = 6;
+const int kTileSize = 1 << kTileShift;
+const int kTileMask = kTileSize - 1;
+// Tiles start on a page boundary.
+const std::size_t kHeaderBytes = 4096;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t tile_size;
+    uint32_t encoding;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t tile_rows;
+    uint32_t tile_cols;
+    uint32_t reserved;
+    double resolution;
+    double center_x;
+    double center_y;
+    double scale;
+};
+
+std::size_t bytesPerCell(TiledDistanceField::Encoding encoding) {
+    return encoding == TiledDistanceField::Encoding::UINT16 ? sizeof(uint16_t) : sizeof(float);
+}
+}
+
+std::unique_ptr<TiledDistanceField> TiledDistanceField::open(const std::string &file) {
+    const int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG(WARNING) << "Cannot open tiled distance field " << file;
+        return nullptr;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<std::size_t>(file_stat.st_size) < kHeaderBytes) {
+        LOG(WARNING) << file << " is not a tiled distance field.";
+        ::close(fd);
+        return nullptr;
+    }
+    const auto size = static_cast<std::size_t>(file_stat.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file referenced.
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        LOG(WARNING) << "Cannot map " << file;
+        return nullptr;
+    }
+    // Queries jump around the map, read-ahead would only load tiles nobody asked for.
+    madvise(mapping, size, MADV_RANDOM);
+
+    std::unique_ptr<TiledDistanceField> field(new TiledDistanceField);
+    field->mapping_ = mapping;
+    field->mapping_size_ = size;
+    Header header;
+    std::memcpy(&header, mapping, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion
+        || header.tile_size != kTileSize || header.encoding > static_cast<uint32_t>(Encoding::UINT16)
+        || header.rows == 0 || header.cols == 0 || header.resolution <= 0
+        || header.tile_rows != (header.rows + kTileSize - 1) / kTileSize
+        || header.tile_cols != (header.cols + kTileSize - 1) / kTileSize) {
+        LOG(WARNING) << file << " has an invalid tiled distance field header.";
+        return nullptr;
+    }
+    field->encoding_ = static_cast<Encoding>(header.encoding);
+    field->tile_bytes_ = kTileSize * kTileSize * bytesPerCell(field->encoding_);
+    if (size < kHeaderBytes + static_cast<std::size_t>(header.tile_rows) * header.tile_cols * field->tile_bytes_) {
+        LOG(WARNING) << file << " is truncated.";
+        return nullptr;
+    }
+    field->tiles_ = static_cast<const unsigned char *>(mapping) + kHeaderBytes;
+    field->geometry_ = GridGeometry(static_cast<int>(header.rows), static_cast<int>(header.cols),
+                                    header.resolution, header.center_x, header.center_y);
+    field->tile_cols_ = static_cast<int>(header.tile_cols);
+    field->scale_ = header.scale;
+    return field;
+}
+
+bool TiledDistanceField::write(const grid_map::GridMap &grid_map,
+                               const std::string &layer,
+                               const std::string &file,
+                               Encoding encoding,
+                               double max_distance) {
+    if (!grid_map.exists(layer)) {
+        LOG(WARNING) << "grid map has no '" << layer << "' layer.";
+        return false;
+    }
+    const auto &data = grid_map.get(layer);
+    const int rows = grid_map.getSize()(0);
+    const int cols = grid_map.getSize()(1);
+    const grid_map::Index &start = grid_map.getStartIndex();
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.tile_size = kTileSize;
+    header.encoding = static_cast<uint32_t>(encoding);
+    header.rows = static_cast<uint32_t>(rows);
+    header.cols = static_cast<uint32_t>(cols);
+    header.tile_rows = static_cast<uint32_t>((rows + kTileSize - 1) / kTileSize);
+    header.tile_cols = static_cast<uint32_t>((cols + kTileSize - 1) / kTileSize);
+    header.resolution = grid_map.getResolution();
+    header.center_x = grid_map.getPosition().x();
+    header.center_y = grid_map.getPosition().y();
+    header.scale = encoding == Encoding::UINT16 ? max_distance / 65535 : 1.0;
+
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        LOG(WARNING) << "Cannot write " << file;
+        return false;
+    }
+    std::vector<char> padding(kHeaderBytes - sizeof(header), 0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(padding.data(), padding.size());
+    std::vector<float> float_tile(kTileSize * kTileSize);
+    std::vector<uint16_t> uint16_tile(kTileSize * kTileSize);
+    for (uint32_t tile_row = 0; tile_row != header.tile_rows; ++tile_row) {
+        for (uint32_t tile_col = 0; tile_col != header.tile_cols; ++tile_col) {
+            std::fill(float_tile.begin(), float_tile.end(), 0.0f);
+            for (int r = 0; r != kTileSize; ++r) {
+                const int row = static_cast<int>(tile_row) * kTileSize + r;
+                if (row >= rows) break;
+                for (int c = 0; c != kTileSize; ++c) {
+                    const int col = static_cast<int>(tile_col) * kTileSize + c;
+                    if (col >= cols) break;
+                    // Undo the circular buffer of the grid map.
+                    float_tile[r * kTileSize + c] = data((row + start(0)) % rows, (col + start(1)) % cols);
+                }
+            }
+            if (encoding == Encoding::UINT16) {
+                for (int i = 0; i != kTileSize * kTileSize; ++i) {
+                    const double clamped = std::max(0.0, std::min<double>(max_distance, float_tile[i]));
+                    uint16_tile[i] = static_cast<uint16_t>(std::lround(clamped / header.scale));
+                }
+                out.write(reinterpret_cast<const char *>(uint16_tile.data()), uint16_tile.size() * sizeof(uint16_t));
+            } else {
+                out.write(reinterpret_cast<const char *>(float_tile.data()), float_tile.size() * sizeof(float));
+            }
+        }
+    }
+    if (!out) {
+        LOG(WARNING) << "Failed writing " << file;
+        return false;
+    }
+    return true;
+}
+
+TiledDistanceField::~TiledDistanceField() {
+    if (mapping_) munmap(mapping_, mapping_size_);
+}
+
+double TiledDistanceField::cell(int row, int col) const {
+    const std::size_t tile = static_cast<std::size_t>(row >> kTileShift) * tile_cols_ + (col >> kTileShift);
+    const std::size_t offset = ((row & kTileMask) << kTileShift) | (col & kTileMask);
+    const unsigned char *tile_data = tiles_ + tile * tile_bytes_;
+    if (encoding_ == Encoding::UINT16) {
+        return reinterpret_cast<const uint16_t *>(tile_data)[offset] * scale_;
+    }
+    return reinterpret_cast<const float *>(tile_data)[offset];
+}
+
+bool TiledDistanceField::isInside(const Eigen::Vector2d &pos) const {
+    return geometry_.isInside(pos);
+}
+
+double TiledDistanceField::getObstacleDistance(const Eigen::Vector2d &pos) const {
+    return interpolateBilinear(geometry_, pos, [this](int row, int col) { return cell(row, col); });
+}
+
+double TiledDistanceField::getResolution() const {
+    return geometry_.resolution;
+}
+
+}
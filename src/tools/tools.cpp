@@ -25,6 +25,18 @@ void time_ms_out(const clock_t &begin, const clock_t &end, const std::string &te
     std::cout << text << " time cost: " << time_ms(begin, end) << " ms." << std::endl;
 }
 
+double time_s(const TimePoint &begin, const TimePoint &end) {
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+double time_ms(const TimePoint &begin, const TimePoint &end) {
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+void time_ms_out(const TimePoint &begin, const TimePoint &end, const std::string &text) {
+    std::cout << text << " time cost: " << time_ms(begin, end) << " ms." << std::endl;
+}
+
 bool isEqual(double a, double b) {
     return fabs(a - b) < FLAGS_epsilon;
 }
@@ -43,13 +55,29 @@ double getCurvature(const tk::spline &xs, const tk::spline &ys, double tmp_s) {
     return (x_d1 * y_d2 - y_d1 * x_d2) / pow(pow(x_d1, 2) + pow(y_d1, 2), 1.5);
 }
 
+Tangent getTangent(const tk::spline &xs, const tk::spline &ys, double s) {
+    const double x_d1 = xs.deriv(1, s);
+    const double y_d1 = ys.deriv(1, s);
+    const double norm = sqrt(x_d1 * x_d1 + y_d1 * y_d1);
+    if (norm < DBL_EPSILON) return {};
+    return {x_d1 / norm, y_d1 / norm};
+}
+
+Tangent getTangent(double heading) {
+    return {cos(heading), sin(heading)};
+}
+
 double distance(const State &p1, const State &p2) {
     return sqrt(pow(p1.x - p2.x, 2) + pow(p1.y - p2.y, 2));
 }
 
 State local2Global(const State &reference, const State &target) {
-    double x = target.x * cos(reference.z) - target.y * sin(reference.z) + reference.x;
-    double y = target.x * sin(reference.z) + target.y * cos(reference.z) + reference.y;
+    return local2Global(reference, getTangent(reference.z), target);
+}
+
+State local2Global(const State &reference, const Tangent &tangent, const State &target) {
+    double x = target.x * tangent.x - target.y * tangent.y + reference.x;
+    double y = target.x * tangent.y + target.y * tangent.x + reference.y;
     double z = reference.z + target.z;
     return {x, y, z, target.k, target.s};
 }
@@ -57,8 +85,9 @@ State local2Global(const State &reference, const State &target) {
 State global2Local(const State &reference, const State &target) {
     double dx = target.x - reference.x;
     double dy = target.y - reference.y;
-    double x = dx * cos(reference.z) + dy * sin(reference.z);
-    double y = -dx * sin(reference.z) + dy * cos(reference.z);
+    const auto tangent = getTangent(reference.z);
+    double x = dx * tangent.x + dy * tangent.y;
+    double y = -dx * tangent.y + dy * tangent.x;
     double z = target.z - reference.z;;
     return {x, y, z, target.k, 0};
 }
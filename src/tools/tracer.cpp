@@ -0,0 +1,67 @@
+#include <atomic>
+#include <fstream>
+#include <unistd.h>
+#include <glog/logging.h>
+#include "path_optimizer/tools/tracer.hpp"
+
+namespace PathOptimizationNS {
+
+Tracer &Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+int Tracer::threadId() {
+    static std::atomic<int> next_id{0};
+    thread_local int id = next_id++;
+    return id;
+}
+
+void Tracer::record(const char *name, const char *category, int64_t begin_ns, int64_t end_ns) {
+    const int tid = threadId();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (events_.size() >= static_cast<std::size_t>(FLAGS_trace_max_events)) {
+        ++dropped_;
+        return;
+    }
+    events_.push_back(Event{name, category, begin_ns, end_ns, tid});
+}
+
+bool Tracer::dumpChromeTrace(const std::string &file) const {
+    std::ofstream out(file);
+    if (!out) {
+        LOG(WARNING) << "Cannot open trace file " << file;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int pid = static_cast<int>(getpid());
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    out.precision(3);
+    out << std::fixed;
+    for (std::size_t i = 0; i != events_.size(); ++i) {
+        const auto &e = events_[i];
+        // Complete events ("ph":"X"), timestamps in microseconds.
+        out << (i == 0 ? "\n" : ",\n")
+            << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\""
+            << ",\"ts\":" << e.begin_ns * 1e-3
+            << ",\"dur\":" << (e.end_ns - e.begin_ns) * 1e-3
+            << ",\"pid\":" << pid << ",\"tid\":" << e.tid << "}";
+    }
+    out << "\n]}\n";
+    if (dropped_ > 0) LOG(WARNING) << dropped_ << " spans were dropped, increase trace_max_events.";
+    LOG(INFO) << "Wrote " << events_.size() << " spans to " << file;
+    return static_cast<bool>(out);
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.clear();
+    dropped_ = 0;
+}
+
+std::size_t Tracer::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_.size();
+}
+
+}